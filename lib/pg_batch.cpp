@@ -0,0 +1,389 @@
+#include <stdlib.h>
+#include <string.h>
+#include "pg_internal.h"
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+/*
+ * Batches of big integers in one arena, structure of arrays
+ * - The candidates, the Montgomery constants of the ones that reach the
+ *   exponentiation and the results share one allocation made at create
+ *   time; nothing is allocated per number and reset only empties it
+ * - Word i of number j is limbs[i * stride + j]: the same word of
+ *   neighbouring numbers is contiguous, and every row starts on a 64-byte
+ *   line. Arenas of 2 MB or more are mapped and offered to transparent
+ *   huge pages (Linux)
+ * - pg_big_batch_test: numbers below 2^64 go to pg_is_prime_u64; the rest
+ *   get trial division and the survivors are packed into the work rows.
+ *   The strong base-2 test then runs on LANES numbers at a time in
+ *   Montgomery form (CIOS), the lane loop innermost so the compiler can
+ *   keep the lanes in vector registers. With base 2, a set exponent bit
+ *   costs a doubling rather than a multiplication, so the lanes take the
+ *   same steps whatever their exponents; each lane's check against 1 and
+ *   n - 1 is read off at its own bit position
+ * - Numbers that pass go on to pg_strong_lucas_big and 'rounds' random
+ *   bases one at a time, as pg_is_probable_prime_bpsw_big; with no known
+ *   Baillie-PSW pseudoprime almost all of them are primes
+ */
+
+#define LANES 8
+#define ARENA_ALIGN 64
+#define HUGE_PAGE_SIZE (2u << 20)
+
+struct pg_big_batch {
+    void *arena;
+    size_t arena_size;
+    int mapped;
+    int bits;
+    int words;          /* words per number, ceil(bits / 32) */
+    uint32_t capacity;
+    uint32_t stride;    /* capacity rounded up to 16: one 64-byte line per row */
+    uint32_t size;
+    uint32_t *limbs;    /* words rows of stride: the numbers added */
+    uint32_t *work;     /* words rows: the numbers past trial division, packed */
+    uint32_t *one;      /* words rows: R mod n of each work number, R = 2^(32 words) */
+    uint32_t *n0inv;    /* -n^-1 mod 2^32 of each work number */
+    uint32_t *item;     /* index in the batch of each work number */
+    uint8_t *result;
+};
+
+static size_t round_up(size_t n, size_t align) {
+    return (n + align - 1) / align * align;
+}
+
+static void *arena_alloc(size_t size, int *mapped) {
+    void *p;
+    *mapped = 0;
+#if !defined(_WIN32) && defined(MAP_ANONYMOUS)
+    if (size >= HUGE_PAGE_SIZE) {
+        p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p != MAP_FAILED) {
+#ifdef MADV_HUGEPAGE
+            madvise(p, size, MADV_HUGEPAGE);
+#endif
+            *mapped = 1;
+            return p;
+        }
+    }
+#endif
+    /* size is a multiple of the alignment, as aligned_alloc wants */
+#ifdef _WIN32
+    p = _aligned_malloc(size, ARENA_ALIGN);
+#else
+    p = aligned_alloc(ARENA_ALIGN, size);
+#endif
+    return p;
+}
+
+static void arena_free(void *p, size_t size, int mapped) {
+#if !defined(_WIN32) && defined(MAP_ANONYMOUS)
+    if (mapped) {
+        munmap(p, size);
+        return;
+    }
+#else
+    (void)size;
+    (void)mapped;
+#endif
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
+
+int pg_big_batch_create(uint32_t capacity, int bits, pg_big_batch **out) {
+    pg_big_batch *b;
+    size_t rows, row_bytes, size;
+    uint8_t *p;
+    int mapped;
+
+    if (out == NULL) return PG_ERR_INVALID_ARG;
+    *out = NULL;
+    if (capacity == 0 || capacity > (1u << 24) || bits < 1 || bits > PG_BIGINT_BITS) return PG_ERR_INVALID_ARG;
+    b = (pg_big_batch *)calloc(1, sizeof(pg_big_batch));
+    if (b == NULL) return PG_ERR_NOMEM;
+    b->bits = bits;
+    b->words = (bits + 31) / 32;
+    b->capacity = capacity;
+    b->stride = (uint32_t)round_up(capacity, 16);
+
+    /* limbs, work and one rows, then n0inv, item and result */
+    rows = 3 * (size_t)b->words + 2;
+    row_bytes = (size_t)b->stride * sizeof(uint32_t);
+    size = round_up(rows * row_bytes + b->stride, ARENA_ALIGN);
+    if (size >= HUGE_PAGE_SIZE) size = round_up(size, HUGE_PAGE_SIZE);
+    b->arena = arena_alloc(size, &mapped);
+    if (b->arena == NULL) {
+        free(b);
+        return PG_ERR_NOMEM;
+    }
+    b->arena_size = size;
+    b->mapped = mapped;
+    p = (uint8_t *)b->arena;
+    b->limbs = (uint32_t *)p;
+    b->work = (uint32_t *)(p + (size_t)b->words * row_bytes);
+    b->one = (uint32_t *)(p + 2 * (size_t)b->words * row_bytes);
+    b->n0inv = (uint32_t *)(p + 3 * (size_t)b->words * row_bytes);
+    b->item = (uint32_t *)(p + (3 * (size_t)b->words + 1) * row_bytes);
+    b->result = p + rows * row_bytes;
+    *out = b;
+    return PG_OK;
+}
+
+void pg_big_batch_destroy(pg_big_batch *batch) {
+    if (batch == NULL) return;
+    arena_free(batch->arena, batch->arena_size, batch->mapped);
+    free(batch);
+}
+
+void pg_big_batch_reset(pg_big_batch *batch) {
+    batch->size = 0;
+}
+
+uint32_t pg_big_batch_size(const pg_big_batch *batch) {
+    return batch->size;
+}
+
+int pg_big_batch_add(pg_big_batch *batch, const pg_bigint *n) {
+    uint32_t j = batch->size;
+    int i;
+    if (pg_bigint_bit_length(n) > batch->bits) return PG_ERR_OVERFLOW;
+    if (j == batch->capacity) return PG_ERR_BUFFER_TOO_SMALL;
+    for (i = 0; i < batch->words; i++) batch->limbs[(size_t)i * batch->stride + j] = n->words[i];
+    batch->result[j] = 0;
+    batch->size = j + 1;
+    return (int)j;
+}
+
+int pg_big_batch_get(const pg_big_batch *batch, uint32_t index, pg_bigint *n) {
+    int i;
+    if (index >= batch->size) return PG_ERR_INVALID_ARG;
+    bigint_zero(n);
+    for (i = 0; i < batch->words; i++) n->words[i] = batch->limbs[(size_t)i * batch->stride + index];
+    return PG_OK;
+}
+
+const uint8_t *pg_big_batch_results(const pg_big_batch *batch) {
+    return batch->result;
+}
+
+/* r = t - n for the lanes where t >= n or the top word is set, otherwise t;
+ * arrays are [word][lane] */
+static void reduce_lanes(uint32_t *r, const uint32_t *t, const uint32_t *top, const uint32_t *n, int words) {
+    uint32_t d[PG_BIGINT_WORDS * LANES], borrow[LANES], keep[LANES];
+    int j, l;
+    for (l = 0; l < LANES; l++) borrow[l] = 0;
+    for (j = 0; j < words; j++) {
+        for (l = 0; l < LANES; l++) {
+            uint64_t v = (uint64_t)t[j * LANES + l] - n[j * LANES + l] - borrow[l];
+            d[j * LANES + l] = (uint32_t)v;
+            borrow[l] = (uint32_t)(v >> 32) & 1;
+        }
+    }
+    for (l = 0; l < LANES; l++) keep[l] = top[l] == 0 && borrow[l] ? 0xFFFFFFFFu : 0;
+    for (j = 0; j < words; j++) {
+        for (l = 0; l < LANES; l++) {
+            r[j * LANES + l] = (t[j * LANES + l] & keep[l]) | (d[j * LANES + l] & ~keep[l]);
+        }
+    }
+}
+
+/* r = a b R^-1 mod n on every lane; r may alias a or b */
+static void mont_mul_lanes(uint32_t *r, const uint32_t *a, const uint32_t *b, const uint32_t *n,
+                           const uint32_t *n0inv, int words) {
+    uint32_t t[(PG_BIGINT_WORDS + 2) * LANES], m[LANES];
+    uint64_t c[LANES];
+    uint32_t *ts = t + words * LANES, *tc = ts + LANES;
+    int i, j, l;
+
+    memset(t, 0, sizeof(uint32_t) * (size_t)(words + 2) * LANES);
+    for (i = 0; i < words; i++) {
+        const uint32_t *bi = b + i * LANES;
+        for (l = 0; l < LANES; l++) c[l] = 0;
+        for (j = 0; j < words; j++) {
+            for (l = 0; l < LANES; l++) {
+                uint64_t v = (uint64_t)a[j * LANES + l] * bi[l] + t[j * LANES + l] + c[l];
+                t[j * LANES + l] = (uint32_t)v;
+                c[l] = v >> 32;
+            }
+        }
+        for (l = 0; l < LANES; l++) {
+            uint64_t v = (uint64_t)ts[l] + c[l];
+            ts[l] = (uint32_t)v;
+            tc[l] = (uint32_t)(v >> 32);
+            m[l] = t[l] * n0inv[l];
+            c[l] = ((uint64_t)m[l] * n[l] + t[l]) >> 32;
+        }
+        /* add m n and shift down one word */
+        for (j = 1; j < words; j++) {
+            for (l = 0; l < LANES; l++) {
+                uint64_t v = (uint64_t)m[l] * n[j * LANES + l] + t[j * LANES + l] + c[l];
+                t[(j - 1) * LANES + l] = (uint32_t)v;
+                c[l] = v >> 32;
+            }
+        }
+        for (l = 0; l < LANES; l++) {
+            uint64_t v = (uint64_t)ts[l] + c[l];
+            t[(words - 1) * LANES + l] = (uint32_t)v;
+            ts[l] = tc[l] + (uint32_t)(v >> 32);
+        }
+    }
+    reduce_lanes(r, t, ts, n, words);
+}
+
+/* x = 2 x mod n on the lanes in 'mask' */
+static void double_lanes(uint32_t *x, const uint32_t *n, uint32_t mask, int words) {
+    uint32_t t[PG_BIGINT_WORDS * LANES], carry[LANES];
+    int j, l;
+    for (l = 0; l < LANES; l++) carry[l] = 0;
+    for (j = 0; j < words; j++) {
+        for (l = 0; l < LANES; l++) {
+            uint32_t w = x[j * LANES + l];
+            t[j * LANES + l] = w << 1 | carry[l];
+            carry[l] = w >> 31;
+        }
+    }
+    reduce_lanes(t, t, carry, n, words);
+    for (j = 0; j < words; j++) {
+        for (l = 0; l < LANES; l++) {
+            if ((mask >> l) & 1) x[j * LANES + l] = t[j * LANES + l];
+        }
+    }
+}
+
+/* Lanes where x equals v, as a bit mask */
+static uint32_t equal_lanes(const uint32_t *x, const uint32_t *v, int words) {
+    uint32_t diff[LANES], mask = 0;
+    int j, l;
+    for (l = 0; l < LANES; l++) diff[l] = 0;
+    for (j = 0; j < words; j++) {
+        for (l = 0; l < LANES; l++) diff[l] |= x[j * LANES + l] ^ v[j * LANES + l];
+    }
+    for (l = 0; l < LANES; l++) mask |= (uint32_t)(diff[l] == 0) << l;
+    return mask;
+}
+
+/* Strong base-2 test of the work numbers first .. first + LANES - 1 (odd, above 2^64);
+ * returns the lanes that pass */
+static uint32_t sprp2_lanes(const pg_big_batch *b, uint32_t first) {
+    uint32_t n[PG_BIGINT_WORDS * LANES], one[PG_BIGINT_WORDS * LANES], minus_one[PG_BIGINT_WORDS * LANES];
+    uint32_t x[PG_BIGINT_WORDS * LANES], n0inv[LANES], borrow[LANES], pass = 0;
+    int s[LANES], words = b->words, top = 0, pos, j, l;
+
+    for (l = 0; l < LANES; l++) borrow[l] = 0;
+    for (j = 0; j < words; j++) {
+        for (l = 0; l < LANES; l++) {
+            size_t at = (size_t)j * b->stride + first + l;
+            uint64_t v;
+            n[j * LANES + l] = b->work[at];
+            one[j * LANES + l] = b->one[at];
+            x[j * LANES + l] = b->one[at];
+            v = (uint64_t)b->work[at] - b->one[at] - borrow[l];
+            minus_one[j * LANES + l] = (uint32_t)v;
+            borrow[l] = (uint32_t)(v >> 32) & 1;
+        }
+    }
+    for (l = 0; l < LANES; l++) {
+        n0inv[l] = b->n0inv[first + l];
+        /* n - 1 = d 2^s; n is odd so its bits above bit 0 are those of n - 1 */
+        for (s[l] = 1; !((n[(s[l] / 32) * LANES + l] >> (s[l] % 32)) & 1); s[l]++) {
+        }
+    }
+    for (j = words - 1; j >= 0 && top == 0; j--) {
+        for (l = 0; l < LANES; l++) {
+            uint32_t w = n[j * LANES + l];
+            int k = 32 * j + 31;
+            while (w != 0 && !(w >> 31)) {
+                w <<= 1;
+                k--;
+            }
+            if (w != 0 && k + 1 > top) top = k + 1;
+        }
+    }
+
+    /* Left to right over n - 1: square, double where the bit is set. After bit
+     * s the lane holds 2^d; below it, 2^(d 2^r) for r = 1 .. s - 1 */
+    for (pos = top - 1; pos >= 1; pos--) {
+        uint32_t bit = 0;
+        mont_mul_lanes(x, x, x, n, n0inv, words);
+        for (l = 0; l < LANES; l++) bit |= ((n[(pos / 32) * LANES + l] >> (pos % 32)) & 1) << l;
+        if (bit) double_lanes(x, n, bit, words);
+        {
+            uint32_t at_s = 0, below_s = 0;
+            for (l = 0; l < LANES; l++) {
+                at_s |= (uint32_t)(pos == s[l]) << l;
+                below_s |= (uint32_t)(pos < s[l]) << l;
+            }
+            if (at_s) pass |= at_s & equal_lanes(x, one, words);
+            if (at_s | below_s) pass |= (at_s | below_s) & equal_lanes(x, minus_one, words);
+        }
+    }
+    return pass;
+}
+
+int pg_big_batch_test(pg_ctx *ctx, pg_big_batch *batch, int rounds) {
+    uint32_t stride = batch->stride, count = 0, packed = 0, j, k;
+    uint32_t r_words[PG_BIGINT_WORDS + 1];
+    int words = batch->words, i;
+    pg_bigint n, one;
+
+    if (rounds < 0) return PG_ERR_INVALID_ARG;
+
+    /* Narrow and even numbers, then trial division; survivors go to the work rows */
+    for (j = 0; j < batch->size; j++) {
+        int bits;
+        pg_big_batch_get(batch, j, &n);
+        batch->result[j] = 0;
+        bits = pg_bigint_bit_length(&n);
+        if (bits <= 64) {
+            batch->result[j] = (uint8_t)pg_is_prime_u64((uint64_t)n.words[1] << 32 | n.words[0]);
+            continue;
+        }
+        /* n > 2^64 is larger than any table prime */
+        if (bigint_is_even(&n) || pg_small_prime_divisor_big(&n) != 0) continue;
+        for (i = 0; i < words; i++) batch->work[(size_t)i * stride + packed] = n.words[i];
+        /* R mod n from the words of R = 2^(32 words) */
+        memset(r_words, 0, sizeof(r_words));
+        r_words[words] = 1;
+        pg_bigint_mod_words(&one, r_words, words + 1, &n);
+        for (i = 0; i < words; i++) batch->one[(size_t)i * stride + packed] = one.words[i];
+        {
+            uint32_t inv = n.words[0];
+            for (i = 0; i < 4; i++) inv *= 2 - n.words[0] * inv;
+            batch->n0inv[packed] = 0 - inv;
+        }
+        batch->item[packed++] = j;
+    }
+    /* Fill the last group with copies of the last number; stride is a multiple of LANES */
+    for (k = packed; packed > 0 && k % LANES != 0; k++) {
+        for (i = 0; i < words; i++) {
+            batch->work[(size_t)i * stride + k] = batch->work[(size_t)i * stride + packed - 1];
+            batch->one[(size_t)i * stride + k] = batch->one[(size_t)i * stride + packed - 1];
+        }
+        batch->n0inv[k] = batch->n0inv[packed - 1];
+    }
+
+    for (k = 0; k < packed; k += LANES) {
+        uint32_t pass = sprp2_lanes(batch, k);
+        int l;
+        for (l = 0; l < LANES && k + l < packed; l++) {
+            ctx->stats.mr_rounds++;
+            batch->result[batch->item[k + l]] = (uint8_t)((pass >> l) & 1);
+        }
+    }
+
+    /* Lucas and the random bases, one number at a time */
+    for (k = 0; k < packed; k++) {
+        j = batch->item[k];
+        if (!batch->result[j]) continue;
+        pg_big_batch_get(batch, j, &n);
+        if (!pg_strong_lucas_big(&n) || (rounds > 0 && !pg_mr_rounds_big(ctx, &ctx->rng, &n, rounds))) {
+            batch->result[j] = 0;
+        }
+    }
+    for (j = 0; j < batch->size; j++) count += batch->result[j];
+    return (int)count;
+}
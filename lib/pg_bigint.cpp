@@ -0,0 +1,384 @@
+#include <string.h>
+#include "pg_internal.h"
+
+/*
+ * Fixed-width 1024-bit integer arithmetic
+ * - Outputs may alias inputs (pg_bigint_mul's wide product excepted):
+ *   each kernel reads what it needs before it writes, or works in the
+ *   thread's pg_bigint_ws, so no operand is copied to protect it
+ * - Products and divisions only run over the words the operands use
+ */
+
+/* Add two big integers: c = a + b, returns carry */
+uint32_t pg_bigint_add(pg_bigint *c, const pg_bigint *a, const pg_bigint *b) {
+    unsigned long long sum = 0;
+    int i;
+    for (i = 0; i < PG_BIGINT_WORDS; i++) {
+        sum = sum + (unsigned long long)a->words[i] + (unsigned long long)b->words[i];
+        c->words[i] = (unsigned int)sum;
+        sum = sum >> 32;
+    }
+    return (unsigned int)sum;
+}
+
+/* Subtract: c = a - b, assumes a >= b */
+void pg_bigint_sub(pg_bigint *c, const pg_bigint *a, const pg_bigint *b) {
+    unsigned long long borrow = 0;
+    int i;
+    for (i = 0; i < PG_BIGINT_WORDS; i++) {
+        unsigned long long diff = (unsigned long long)a->words[i] - (unsigned long long)b->words[i] - borrow;
+        c->words[i] = (unsigned int)diff;
+        borrow = (diff >> 32) & 1;
+    }
+}
+
+/* Words below the top nonzero one */
+static int words_used(const uint32_t *w, int count) {
+    while (count > 0 && w[count - 1] == 0) count--;
+    return count;
+}
+
+/* Scratch of the calling thread */
+pg_bigint_ws *pg_bigint_ws_get(void) {
+    static thread_local pg_bigint_ws ws;
+    return &ws;
+}
+
+/* Multiply: c = a * b (schoolbook over the words a and b use, full 2048-bit product) */
+void pg_bigint_mul(pg_bigint_wide *c, const pg_bigint *a, const pg_bigint *b) {
+    int alen = words_used(a->words, PG_BIGINT_WORDS);
+    int blen = words_used(b->words, PG_BIGINT_WORDS);
+    int i, j;
+
+    /* each row adds into the words the previous rows wrote and starts word i + blen afresh */
+    for (j = 0; j < blen; j++) c->words[j] = 0;
+    for (i = 0; i < alen; i++) {
+        unsigned long long carry = 0;
+        for (j = 0; j < blen; j++) {
+            carry += (unsigned long long)a->words[i] * b->words[j] + c->words[i + j];
+            c->words[i + j] = (uint32_t)carry;
+            carry >>= 32;
+        }
+        c->words[i + blen] = (uint32_t)carry;
+    }
+    for (i = alen + blen; i < PG_BIGINT_WORDS * 2; i++) c->words[i] = 0;
+}
+
+/* Normalize n into ws->vn so that the top divisor word has its high bit set */
+static void divisor_prepare(pg_bigint_ws *ws, const pg_bigint *n) {
+    int nlen = words_used(n->words, PG_BIGINT_WORDS);
+    int shift = 0, i;
+    uint32_t top;
+
+    ws->nlen = nlen;
+    ws->shift = 0;
+    if (nlen <= 1) {
+        ws->vn[0] = n->words[0];
+        return;
+    }
+    top = n->words[nlen-1];
+    while ((top & 0x80000000U) == 0) {
+        top <<= 1;
+        shift++;
+    }
+    for (i = nlen - 1; i > 0; i--) {
+        ws->vn[i] = (n->words[i] << shift) | (shift ? n->words[i-1] >> (32 - shift) : 0);
+    }
+    ws->vn[0] = n->words[0] << shift;
+    ws->shift = shift;
+}
+
+/* Divide a multi-word number by the divisor in ws: q = num / n, r = num mod n
+ * (word-level long division, Knuth TAOCP 4.3.1 Algorithm D). num is read
+ * into ws->un before q or r is written, so either may alias it */
+static void divmod_prepared(pg_bigint *q, pg_bigint *r, const uint32_t *num, int num_words, pg_bigint_ws *ws) {
+    const uint32_t *vn = ws->vn;
+    uint32_t *un = ws->un;
+    int nlen = ws->nlen, shift = ws->shift;
+    int i, j;
+
+    num_words = words_used(num, num_words);
+
+    /* num < n: nothing to do */
+    if (num_words < nlen) {
+        for (i = 0; i < num_words; i++) r->words[i] = num[i];
+        for (; i < PG_BIGINT_WORDS; i++) r->words[i] = 0;
+        if (q) bigint_zero(q);
+        return;
+    }
+
+    /* Single-word divisor: Horner's method, top word first, so q may overwrite num behind it */
+    if (nlen == 1) {
+        unsigned long long rem = 0;
+        if (q) {
+            for (i = num_words; i < PG_BIGINT_WORDS; i++) q->words[i] = 0;
+        }
+        for (i = num_words - 1; i >= 0; i--) {
+            unsigned long long cur = (rem << 32) | num[i];
+            if (q && i < PG_BIGINT_WORDS) q->words[i] = (unsigned int)(cur / vn[0]);
+            rem = cur % vn[0];
+        }
+        r->words[0] = (unsigned int)rem;
+        for (i = 1; i < PG_BIGINT_WORDS; i++) r->words[i] = 0;
+        return;
+    }
+
+    un[num_words] = shift ? num[num_words-1] >> (32 - shift) : 0;
+    for (i = num_words - 1; i > 0; i--) {
+        un[i] = (num[i] << shift) | (shift ? num[i-1] >> (32 - shift) : 0);
+    }
+    un[0] = num[0] << shift;
+    if (q) bigint_zero(q);
+
+    for (j = num_words - nlen; j >= 0; j--) {
+        /* Estimate quotient digit from the top two words */
+        unsigned long long top2 = ((unsigned long long)un[j+nlen] << 32) | un[j+nlen-1];
+        unsigned long long qhat = top2 / vn[nlen-1];
+        unsigned long long rhat = top2 % vn[nlen-1];
+        while (qhat > 0xFFFFFFFFULL || qhat * vn[nlen-2] > ((rhat << 32) | un[j+nlen-2])) {
+            qhat--;
+            rhat += vn[nlen-1];
+            if (rhat > 0xFFFFFFFFULL) break;
+        }
+
+        /* Multiply and subtract qhat * vn from un[j .. j+nlen] */
+        long long k = 0;
+        long long t;
+        for (i = 0; i < nlen; i++) {
+            unsigned long long p = qhat * vn[i];
+            t = (long long)un[i+j] - k - (long long)(p & 0xFFFFFFFFULL);
+            un[i+j] = (unsigned int)t;
+            k = (long long)(p >> 32) - (t >> 32);
+        }
+        t = (long long)un[j+nlen] - k;
+        un[j+nlen] = (unsigned int)t;
+
+        /* Estimate was one too large: add the divisor back */
+        if (t < 0) {
+            unsigned long long carry = 0;
+            for (i = 0; i < nlen; i++) {
+                carry = (unsigned long long)un[i+j] + vn[i] + carry;
+                un[i+j] = (unsigned int)carry;
+                carry >>= 32;
+            }
+            un[j+nlen] += (unsigned int)carry;
+            qhat--;
+        }
+        if (q && j < PG_BIGINT_WORDS) q->words[j] = (unsigned int)qhat;
+    }
+
+    /* Denormalize the remainder */
+    for (i = 0; i < nlen; i++) {
+        r->words[i] = (un[i] >> shift) | (shift ? un[i+1] << (32 - shift) : 0);
+    }
+    for (; i < PG_BIGINT_WORDS; i++) r->words[i] = 0;
+}
+
+void pg_bigint_divmod_words(pg_bigint *q, pg_bigint *r, const uint32_t *num, int num_words, const pg_bigint *n) {
+    pg_bigint_ws *ws = pg_bigint_ws_get();
+    divisor_prepare(ws, n);
+    divmod_prepared(q, r, num, num_words, ws);
+}
+
+void pg_bigint_mod_words(pg_bigint *r, const uint32_t *num, int num_words, const pg_bigint *n) {
+    pg_bigint_divmod_words(NULL, r, num, num_words, n);
+}
+
+/* Binary gcd: subtract the smaller from the larger and drop factors of 2 */
+void pg_bigint_gcd_odd(pg_bigint *g, const pg_bigint *a, const pg_bigint *b) {
+    pg_bigint x, y, *u = &x, *v = &y, *t;
+    bigint_copy(u, b);
+    bigint_copy(v, a);
+    while (!bigint_is_zero(v)) {
+        while (bigint_is_even(v)) bigint_shr_one(v);
+        if (bigint_compare(u, v) > 0) {
+            t = u;
+            u = v;
+            v = t;
+        }
+        pg_bigint_sub(v, v, u);
+    }
+    bigint_copy(g, u);
+}
+
+/* Digit-by-digit square root, two bits of n per step */
+int pg_bigint_isqrt(pg_bigint *root, const pg_bigint *n) {
+    pg_bigint rem, bit, t;
+    int top = pg_bigint_bit_length(n);
+    bigint_copy(&rem, n);
+    bigint_zero(root);
+    bigint_zero(&bit);
+    if (top == 0) return 1;
+    top = (top - 1) & ~1;
+    bit.words[top / 32] = 1U << (top % 32);
+    while (!bigint_is_zero(&bit)) {
+        pg_bigint_add(&t, root, &bit);
+        bigint_shr_one(root);
+        if (bigint_compare(&rem, &t) >= 0) {
+            pg_bigint_sub(&rem, &rem, &t);
+            pg_bigint_add(root, root, &bit);
+        }
+        bigint_shr_one(&bit);
+        bigint_shr_one(&bit);
+    }
+    return bigint_is_zero(&rem);
+}
+
+/* Modular multiplication: c = (a * b) mod n; the product goes to ws->prod, so c may alias a, b or n */
+void pg_bigint_mod_mul_ws(pg_bigint *c, const pg_bigint *a, const pg_bigint *b, const pg_bigint *n, pg_bigint_ws *ws) {
+    pg_bigint_mul(&ws->prod, a, b);
+    divisor_prepare(ws, n);
+    divmod_prepared(NULL, c, ws->prod.words, PG_BIGINT_WORDS * 2, ws);
+}
+
+void pg_bigint_mod_mul(pg_bigint *c, const pg_bigint *a, const pg_bigint *b, const pg_bigint *n) {
+    pg_bigint_mod_mul_ws(c, a, b, n, pg_bigint_ws_get());
+}
+
+/* Modular exponentiation: c = (base^exp) mod mod, left to right over the bits of exp
+ * with mod normalized once. The result builds up in c itself unless c aliases an
+ * input; only then does it go through ws->acc and one copy at the end */
+void pg_bigint_mod_exp_ws(pg_bigint *c, const pg_bigint *base, const pg_bigint *exp, const pg_bigint *mod,
+                          pg_bigint_ws *ws) {
+    pg_bigint *r = c == base || c == exp || c == mod ? &ws->acc : c;
+    int bit = pg_bigint_bit_length(exp) - 1;
+
+    if (bit < 0) {
+        bigint_set_u32(c, 1);
+        return;
+    }
+    divisor_prepare(ws, mod);
+    /* top bit: r = base mod n */
+    divmod_prepared(NULL, r, base->words, PG_BIGINT_WORDS, ws);
+    for (bit--; bit >= 0; bit--) {
+        pg_bigint_mul(&ws->prod, r, r);
+        divmod_prepared(NULL, r, ws->prod.words, PG_BIGINT_WORDS * 2, ws);
+        if ((exp->words[bit / 32] >> (bit % 32)) & 1) {
+            pg_bigint_mul(&ws->prod, r, base);
+            divmod_prepared(NULL, r, ws->prod.words, PG_BIGINT_WORDS * 2, ws);
+        }
+    }
+    if (r != c) bigint_copy(c, r);
+}
+
+void pg_bigint_mod_exp(pg_bigint *c, const pg_bigint *base, const pg_bigint *exp, const pg_bigint *mod) {
+    pg_bigint_mod_exp_ws(c, base, exp, mod, pg_bigint_ws_get());
+}
+
+/* Remainder of a modulo a small p, Horner's method */
+uint32_t pg_bigint_mod_u32(const pg_bigint *a, uint32_t p) {
+    unsigned long long rem = 0;
+    int i;
+    for (i = PG_BIGINT_WORDS - 1; i >= 0; i--) {
+        rem = ((rem << 32) | a->words[i]) % p;
+    }
+    return (uint32_t)rem;
+}
+
+void pg_bigint_set_u64(pg_bigint *a, uint64_t v) {
+    bigint_zero(a);
+    a->words[0] = (uint32_t)v;
+    a->words[1] = (uint32_t)(v >> 32);
+}
+
+int pg_bigint_cmp(const pg_bigint *a, const pg_bigint *b) {
+    return bigint_compare(a, b);
+}
+
+int pg_bigint_bit_length(const pg_bigint *a) {
+    int i;
+    for (i = PG_BIGINT_WORDS - 1; i >= 0; i--) {
+        if (a->words[i] != 0) {
+            int bits = 32 * i;
+            uint32_t w = a->words[i];
+            while (w) {
+                bits++;
+                w >>= 1;
+            }
+            return bits;
+        }
+    }
+    return 0;
+}
+
+/* Parse hex digits (optional 0x prefix, surrounding whitespace allowed) */
+int pg_bigint_from_hex(pg_bigint *a, const char *hex) {
+    const char *end;
+    int digits = 0;
+    int i;
+    
+    while (*hex == ' ' || *hex == '\t' || *hex == '\n' || *hex == '\r') hex++;
+    if (hex[0] == '0' && (hex[1] == 'x' || hex[1] == 'X')) hex += 2;
+    end = hex;
+    while ((*end >= '0' && *end <= '9') || (*end >= 'a' && *end <= 'f') || (*end >= 'A' && *end <= 'F')) end++;
+    for (i = 0; end[i] == ' ' || end[i] == '\t' || end[i] == '\n' || end[i] == '\r'; i++) {
+    }
+    if (end == hex || end[i] != '\0') return PG_ERR_PARSE;
+    
+    /* skip leading zeros so only significant digits count against the width */
+    while (hex < end - 1 && *hex == '0') hex++;
+    if (end - hex > PG_BIGINT_BITS / 4) return PG_ERR_OVERFLOW;
+    
+    bigint_zero(a);
+    for (const char *c = end - 1; c >= hex; c--, digits++) {
+        uint32_t v = (*c <= '9') ? (uint32_t)(*c - '0') : (uint32_t)((*c | 0x20) - 'a' + 10);
+        a->words[digits / 8] |= v << (4 * (digits % 8));
+    }
+    return PG_OK;
+}
+
+int pg_bigint_from_text(pg_bigint *a, const char *text) {
+    const char *end;
+    int i;
+
+    while (*text == ' ' || *text == '\t' || *text == '\n' || *text == '\r') text++;
+    if (text[0] == '0' && (text[1] == 'x' || text[1] == 'X')) return pg_bigint_from_hex(a, text);
+    end = text;
+    while (*end >= '0' && *end <= '9') end++;
+    for (i = 0; end[i] == ' ' || end[i] == '\t' || end[i] == '\n' || end[i] == '\r'; i++) {
+    }
+    if (end == text || end[i] != '\0') return PG_ERR_PARSE;
+
+    /* a = a * 10 + digit, failing as soon as a word would carry out of the top */
+    bigint_zero(a);
+    for (; text < end; text++) {
+        unsigned long long carry = (unsigned long long)(*text - '0');
+        for (i = 0; i < PG_BIGINT_WORDS; i++) {
+            carry += (unsigned long long)a->words[i] * 10;
+            a->words[i] = (uint32_t)carry;
+            carry >>= 32;
+        }
+        if (carry) return PG_ERR_OVERFLOW;
+    }
+    return PG_OK;
+}
+
+/* Convert bigint to hex string */
+int pg_bigint_to_hex(const pg_bigint *a, char *buf, size_t size) {
+    static const char digits[] = "0123456789abcdef";
+    int bits = pg_bigint_bit_length(a);
+    int n = bits ? (bits + 3) / 4 : 1;
+    int i;
+    
+    if (size < (size_t)n + 1) return PG_ERR_BUFFER_TOO_SMALL;
+    for (i = 0; i < n; i++) {
+        int d = n - 1 - i;
+        buf[i] = digits[(a->words[d / 8] >> (4 * (d % 8))) & 0xF];
+    }
+    buf[n] = '\0';
+    return PG_OK;
+}
+
+/* Generate random number of exactly 'bits' bits */
+int pg_bigint_random(pg_ctx *ctx, pg_bigint *a, int bits) {
+    int i;
+    if (bits < 1 || bits > PG_BIGINT_BITS) return PG_ERR_INVALID_ARG;
+    for (i = 0; i < PG_BIGINT_WORDS; i++) {
+        a->words[i] = i < (bits + 31) / 32 ? rng_next32(&ctx->rng) : 0;
+    }
+    if (bits % 32) {
+        a->words[bits / 32] &= (1U << (bits % 32)) - 1;
+    }
+    a->words[(bits - 1) / 32] |= 1U << ((bits - 1) % 32);
+    return PG_OK;
+}
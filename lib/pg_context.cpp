@@ -0,0 +1,82 @@
+#include <stdlib.h>
+#include <string.h>
+#include "pg_internal.h"
+
+/*
+ * Context lifecycle, counters, progress and perf instrumentation
+ */
+
+int pg_api_version(void) {
+    return PG_API_VERSION;
+}
+
+const char *pg_strerror(int status) {
+    switch (status) {
+    case PG_OK: return "success";
+    case PG_ERR_INVALID_ARG: return "invalid argument";
+    case PG_ERR_NOMEM: return "out of memory";
+    case PG_ERR_BUFFER_TOO_SMALL: return "buffer too small";
+    case PG_ERR_PARSE: return "malformed number";
+    case PG_ERR_OVERFLOW: return "number too large";
+    case PG_ERR_CANCELLED: return "cancelled";
+    case PG_ERR_IO: return "file missing, unwritable or malformed";
+    default: return "unknown error";
+    }
+}
+
+uint64_t pg_default_seed(void) {
+    return rng_default_seed();
+}
+
+pg_ctx *pg_ctx_create(uint64_t seed, uint64_t stream) {
+    pg_ctx *ctx = (pg_ctx *)calloc(1, sizeof(pg_ctx));
+    if (ctx == NULL) return NULL;
+    rng_init(&ctx->rng, seed, stream);
+    ctx->progress_every = 1;
+    return ctx;
+}
+
+void pg_ctx_destroy(pg_ctx *ctx) {
+    if (ctx == NULL) return;
+    if (ctx->perf_enabled) perf_close(&ctx->perf);
+    free(ctx);
+}
+
+void pg_ctx_set_stream(pg_ctx *ctx, uint64_t seed, uint64_t stream) {
+    rng_init(&ctx->rng, seed, stream);
+}
+
+void pg_ctx_get_stats(const pg_ctx *ctx, pg_stats *out) {
+    *out = ctx->stats;
+}
+
+void pg_ctx_reset_stats(pg_ctx *ctx) {
+    memset(&ctx->stats, 0, sizeof(ctx->stats));
+}
+
+void pg_ctx_set_progress(pg_ctx *ctx, pg_progress_fn fn, void *user, uint64_t every) {
+    ctx->progress = fn;
+    ctx->progress_user = user;
+    ctx->progress_every = every ? every : 1;
+}
+
+void pg_ctx_set_cancel(pg_ctx *ctx, pg_cancel_fn fn, void *user) {
+    ctx->cancel = fn;
+    ctx->cancel_user = user;
+}
+
+int pg_ctx_enable_perf(pg_ctx *ctx) {
+    if (ctx->perf_enabled) return ctx->perf.nopen;
+    int n = perf_open(&ctx->perf);
+    ctx->perf_enabled = n > 0;
+    return n;
+}
+
+void pg_ctx_get_perf(pg_ctx *ctx, pg_perf_report *out) {
+    if (!ctx->perf_enabled) {
+        memset(out, 0, sizeof(*out));
+        return;
+    }
+    perf_charge(&ctx->perf);
+    perf_report(&ctx->perf, out);
+}
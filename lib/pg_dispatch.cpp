@@ -0,0 +1,167 @@
+#include "pg_internal.h"
+
+/*
+ * Width dispatch: primality of a pg_bigint on the narrowest engine that
+ * holds it
+ * - Below 2^32: trial division, then the strong test to bases 2, 7 and 61
+ *   (exact below 4759123141, Jaeschke) in 32-bit Montgomery form with the
+ *   three bases interleaved; single-word products and a cheaper setup
+ *   than the 7 bases of the 64-bit engine
+ * - Below 2^64: pg_is_prime_u64
+ * - Below 2^128: Baillie-PSW, then 'rounds' random bases, in 128-bit
+ *   Montgomery form on two 64-bit words; the same test as
+ *   pg_is_probable_prime_bpsw_big without its 32-word arithmetic
+ * - Wider, or without unsigned __int128: pg_is_probable_prime_bpsw_big
+ */
+
+/* Bases that make the strong probable-prime test exact below 4759123141 */
+static const uint32_t bases_u32[3] = { 2, 7, 61 };
+
+static uint32_t mont32_mul(uint32_t a, uint32_t b, uint32_t n, uint32_t ninv) {
+    uint64_t t = (uint64_t)a * b;
+    uint64_t u = (uint64_t)((uint32_t)t * ninv) * n;
+    uint32_t thi = (uint32_t)(t >> 32), uhi = (uint32_t)(u >> 32);
+    return thi >= uhi ? thi - uhi : thi - uhi + n;
+}
+
+/* Exact for n < 2^32 */
+static int is_prime_u32(uint32_t n) {
+    uint32_t ninv = n, one, r2, minus_one, x[3], d = n - 1, p;
+    int s = 0, l, i, pass = 0;
+
+    if (n < 2) return 0;
+    p = pg_small_prime_divisor_u64(n);
+    if (p != 0) return p == n;
+    for (i = 0; i < 4; i++) ninv *= 2 - n * ninv;
+    one = (uint32_t)((1ULL << 32) % n);
+    r2 = (uint32_t)((uint64_t)one * one % n);
+    minus_one = n - one;
+    while ((d & 1) == 0) {
+        d >>= 1;
+        s++;
+    }
+    /* x = a^d, the bases side by side; a base that is a multiple of n passes */
+    for (l = 0; l < 3; l++) x[l] = one;
+    for (i = 31; i >= 0 && !((d >> i) & 1); i--) {
+    }
+    {
+        uint32_t b[3];
+        for (l = 0; l < 3; l++) b[l] = mont32_mul(bases_u32[l] % n, r2, n, ninv);
+        for (; i >= 0; i--) {
+            for (l = 0; l < 3; l++) x[l] = mont32_mul(x[l], x[l], n, ninv);
+            if ((d >> i) & 1) {
+                for (l = 0; l < 3; l++) x[l] = mont32_mul(x[l], b[l], n, ninv);
+            }
+        }
+        for (l = 0; l < 3; l++) {
+            if (b[l] == 0 || x[l] == one || x[l] == minus_one) pass |= 1 << l;
+        }
+    }
+    for (i = 1; i < s && pass != 7; i++) {
+        for (l = 0; l < 3; l++) {
+            if (pass & (1 << l)) continue;
+            x[l] = mont32_mul(x[l], x[l], n, ninv);
+            if (x[l] == minus_one) pass |= 1 << l;
+        }
+    }
+    return pass == 7;
+}
+
+#if defined(PG_HAVE_U128)
+static pg_u128 bigint_to_u128(const pg_bigint *n) {
+    pg_u128 v = 0;
+    int i;
+    for (i = 3; i >= 0; i--) v = v << 32 | n->words[i];
+    return v;
+}
+
+/* Smallest table prime up to the big-integer trial bound dividing n, 0 if none;
+ * as pg_small_prime_divisor_big, on the four words n actually has */
+static uint32_t small_prime_divisor_u128(const pg_bigint *n, int bits) {
+    int count = pg_trial_count_big[bits], i, w;
+    for (i = 0; i < count; i++) {
+        uint64_t r = 0, p = pg_small_primes[i];
+        for (w = 3; w >= 0; w--) r = (r << 32 | n->words[w]) % p;
+        if (r == 0) return (uint32_t)p;
+    }
+    return 0;
+}
+
+/* Strong probable-prime test of odd n > 3 to base a (Montgomery form, nonzero) */
+static int mr_witness_u128(const pg_mont128 *m, pg_u128 a) {
+    pg_u128 d = m->n - 1, x = m->one, minus_one = m->n - m->one;
+    int s = 0, i;
+    while ((d & 1) == 0) {
+        d >>= 1;
+        s++;
+    }
+    for (i = 127; !((d >> i) & 1); i--) {
+    }
+    for (; i >= 0; i--) {
+        x = pg_mont128_mul(m, x, x);
+        if ((d >> i) & 1) x = pg_mont128_mul(m, x, a);
+    }
+    if (x == m->one || x == minus_one) return 1;
+    for (i = 1; i < s; i++) {
+        x = pg_mont128_mul(m, x, x);
+        if (x == minus_one) return 1;
+    }
+    return 0;
+}
+
+/* Uniform value in [0, max), max > 0, by rejection */
+static pg_u128 rng_uniform_u128(prime_rng *rng, pg_u128 max) {
+    pg_u128 mask = max - 1, v;
+    int shift;
+    for (shift = 1; shift < 128; shift *= 2) mask |= mask >> shift;
+    do {
+        v = (pg_u128)rng_next64(rng) << 64;
+        v = (v | rng_next64(rng)) & mask;
+    } while (v >= max);
+    return v;
+}
+
+/* Baillie-PSW, then 'rounds' random-base rounds; n odd, 2^64 <= n < 2^128 */
+static int bpsw_u128(pg_ctx *ctx, pg_u128 n, int bits, int rounds) {
+    pg_mont128 m;
+    int i;
+    pg_mont128_init(&m, n);
+    ctx->stats.mr_rounds++;
+    TRACE_MR_ROUND_START(bits, 0);
+    int pass = mr_witness_u128(&m, pg_mont128_to(&m, 2));
+    TRACE_MR_ROUND_END(bits, 0, pass);
+    if (!pass || !pg_strong_lucas_u128(&m)) return 0;
+    for (i = 0; i < rounds; i++) {
+        pg_u128 a = 2 + rng_uniform_u128(&ctx->rng, n - 3);
+        ctx->stats.mr_rounds++;
+        TRACE_MR_ROUND_START(bits, i);
+        pass = mr_witness_u128(&m, pg_mont128_to(&m, a));
+        TRACE_MR_ROUND_END(bits, i, pass);
+        if (!pass) return 0;
+    }
+    return 1;
+}
+#endif
+
+int pg_is_prime_auto(pg_ctx *ctx, const pg_bigint *n, int rounds, int *width) {
+    int bits = pg_bigint_bit_length(n);
+    if (rounds < 0) return PG_ERR_INVALID_ARG;
+    if (bits <= 32) {
+        if (width) *width = PG_WIDTH_32;
+        return is_prime_u32(n->words[0]);
+    }
+    if (bits <= 64) {
+        if (width) *width = PG_WIDTH_64;
+        return pg_is_prime_u64((uint64_t)n->words[1] << 32 | n->words[0]);
+    }
+#if defined(PG_HAVE_U128)
+    if (bits <= 128) {
+        if (width) *width = PG_WIDTH_128;
+        /* n > 2^64 is larger than any table prime */
+        if (small_prime_divisor_u128(n, bits) != 0) return 0;
+        return bpsw_u128(ctx, bigint_to_u128(n), bits, rounds);
+    }
+#endif
+    if (width) *width = PG_WIDTH_BIG;
+    return pg_is_probable_prime_bpsw_big(ctx, n, rounds);
+}
@@ -0,0 +1,307 @@
+#include <atomic>
+#include <mutex>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "pg_internal.h"
+
+/*
+ * Elliptic curve method (Lenstra) for finding factors of big integers
+ * - Montgomery curves B y^2 = x^3 + A x^2 + x in X:Z coordinates with
+ *   Suyama's parametrization, so no inversion is ever needed: (A + 2) / 4
+ *   is carried as a fraction and a factor shows up as gcd(Z, n)
+ * - Stage 1 multiplies the starting point by every prime power up to B1
+ *   with the Montgomery ladder
+ * - Stage 2 is baby-step giant-step: for each prime q = mD +- j in
+ *   (B1, B2] it multiplies the accumulator by X_mD Z_j - X_j Z_mD, which is
+ *   0 mod p when q Q is the identity mod p; one gcd at the end
+ * - Curves run on a pool of threads; the first factor found stops them all
+ */
+
+#define ECM_D 2310   /* 2 * 3 * 5 * 7 * 11: 240 baby steps cover every q coprime to D */
+
+typedef struct {
+    pg_bigint x, z;
+} ecm_point;
+
+typedef struct {
+    const pg_bigint *n;
+    pg_bigint a24n, a24d;   /* (A + 2) / 4 = a24n / a24d */
+} ecm_curve;
+
+/* Shared by the workers of one pg_ecm_big call */
+typedef struct {
+    const pg_bigint *n;
+    uint32_t b1;
+    uint64_t b2;
+    const uint8_t *odd_primes;       /* bit i: 2i + 1 is prime, up to max(b1, b2) + ECM_D */
+    const uint32_t *sigmas;
+    uint32_t curves;
+    std::atomic<uint32_t> next;      /* next curve to start */
+    std::atomic<uint32_t> done;      /* curves completed */
+    std::atomic<int> stop;           /* set by the finder or on cancel */
+    pg_cancel_fn cancel;
+    void *cancel_user;
+    std::mutex lock;                 /* guards result */
+    pg_ecm_result *result;
+    int found;
+} ecm_job;
+
+/* r = 2p */
+static void xdbl(ecm_point *r, const ecm_point *p, const ecm_curve *c) {
+    pg_bigint s, d, t, w;
+    bigint_mod_add(&s, &p->x, &p->z, c->n);
+    bigint_mod_sub(&d, &p->x, &p->z, c->n);
+    pg_bigint_mod_mul(&s, &s, &s, c->n);
+    pg_bigint_mod_mul(&d, &d, &d, c->n);
+    bigint_mod_sub(&t, &s, &d, c->n);          /* 4 x z */
+    pg_bigint_mod_mul(&w, &d, &c->a24d, c->n);
+    pg_bigint_mod_mul(&r->x, &s, &w, c->n);
+    pg_bigint_mod_mul(&s, &t, &c->a24n, c->n);
+    bigint_mod_add(&s, &s, &w, c->n);
+    pg_bigint_mod_mul(&r->z, &t, &s, c->n);
+}
+
+/* r = p + q, given diff = p - q; r may alias p or q but not diff */
+static void xadd(ecm_point *r, const ecm_point *p, const ecm_point *q, const ecm_point *diff, const pg_bigint *n) {
+    pg_bigint a, b, u, v;
+    bigint_mod_sub(&a, &p->x, &p->z, n);
+    bigint_mod_add(&b, &q->x, &q->z, n);
+    pg_bigint_mod_mul(&u, &a, &b, n);
+    bigint_mod_add(&a, &p->x, &p->z, n);
+    bigint_mod_sub(&b, &q->x, &q->z, n);
+    pg_bigint_mod_mul(&v, &a, &b, n);
+    bigint_mod_add(&a, &u, &v, n);
+    bigint_mod_sub(&b, &u, &v, n);
+    pg_bigint_mod_mul(&a, &a, &a, n);
+    pg_bigint_mod_mul(&b, &b, &b, n);
+    pg_bigint_mod_mul(&r->x, &diff->z, &a, n);
+    pg_bigint_mod_mul(&r->z, &diff->x, &b, n);
+}
+
+/* r = k p, k >= 1, Montgomery ladder; r may alias p */
+static void ladder(ecm_point *r, const ecm_point *p, uint64_t k, const ecm_curve *c) {
+    ecm_point base = *p, r0 = *p, r1;
+    int bit = 63;
+    xdbl(&r1, p, c);
+    while (bit >= 0 && !((k >> bit) & 1)) bit--;
+    for (bit--; bit >= 0; bit--) {
+        if ((k >> bit) & 1) {
+            xadd(&r0, &r0, &r1, &base, c->n);
+            xdbl(&r1, &r1, c);
+        } else {
+            xadd(&r1, &r0, &r1, &base, c->n);
+            xdbl(&r0, &r0, c);
+        }
+    }
+    *r = r0;
+}
+
+/* x mod n for a small x */
+static void set_small(pg_bigint *x, uint64_t v, const pg_bigint *n) {
+    pg_bigint t;
+    pg_bigint_set_u64(&t, v);
+    pg_bigint_mod_words(x, t.words, PG_BIGINT_WORDS, n);
+}
+
+/* 1 and the factor in g if 1 < gcd(x, n) < n */
+static int split(pg_bigint *g, const pg_bigint *x, const pg_bigint *n) {
+    pg_bigint_gcd_odd(g, x, n);
+    return !bigint_is_one(g) && bigint_compare(g, n) != 0;
+}
+
+/* Run one curve; returns the stage (1 or 2) that found a factor, 0 if none, -1 if stopped */
+static int run_curve(ecm_job *job, uint32_t sigma, pg_bigint *factor) {
+    const pg_bigint *n = job->n;
+    ecm_curve c;
+    ecm_point q, g0, g1, step;
+    pg_bigint u, v, t, acc;
+    uint64_t p, m, m_end;
+    std::vector<ecm_point> baby(ECM_D / 2);
+    std::vector<uint32_t> baby_j;
+
+    /* Suyama: u = s^2 - 5, v = 4s, Q = (u^3 : v^3), (A + 2) / 4 = (v - u)^3 (3u + v) / (16 u^3 v) */
+    c.n = n;
+    set_small(&t, sigma, n);
+    pg_bigint_mod_mul(&u, &t, &t, n);
+    set_small(&acc, 5, n);
+    bigint_mod_sub(&u, &u, &acc, n);
+    set_small(&acc, 4, n);
+    pg_bigint_mod_mul(&v, &t, &acc, n);
+    pg_bigint_mod_mul(&q.x, &u, &u, n);
+    pg_bigint_mod_mul(&q.x, &q.x, &u, n);
+    pg_bigint_mod_mul(&q.z, &v, &v, n);
+    pg_bigint_mod_mul(&q.z, &q.z, &v, n);
+    bigint_mod_sub(&t, &v, &u, n);
+    pg_bigint_mod_mul(&c.a24n, &t, &t, n);
+    pg_bigint_mod_mul(&c.a24n, &c.a24n, &t, n);
+    bigint_mod_add(&t, &u, &u, n);
+    bigint_mod_add(&t, &t, &u, n);
+    bigint_mod_add(&t, &t, &v, n);
+    pg_bigint_mod_mul(&c.a24n, &c.a24n, &t, n);
+    set_small(&t, 16, n);
+    pg_bigint_mod_mul(&c.a24d, &q.x, &v, n);
+    pg_bigint_mod_mul(&c.a24d, &c.a24d, &t, n);
+    /* a degenerate curve can already expose a factor */
+    if (split(factor, &c.a24d, n)) return 1;
+    if (bigint_is_zero(&c.a24d) || bigint_is_zero(&q.z)) return 0;
+
+    /* Stage 1: every prime power up to B1 */
+    for (p = 2; p <= job->b1; p = p == 2 ? 3 : p + 2) {
+        uint64_t pe = p;
+        if (p > 2 && !pg_odd_prime_bit(job->odd_primes, p)) continue;
+        while (pe <= job->b1 / p) pe *= p;
+        ladder(&q, &q, pe, &c);
+        if ((p & 255) == 1 && job->stop.load(std::memory_order_relaxed)) return -1;
+    }
+    if (split(factor, &q.z, n)) return 1;
+    if (bigint_is_zero(&q.z) || job->b2 <= job->b1) return 0;
+
+    /* Stage 2 baby steps: j Q for odd j < D / 2 coprime to D */
+    ecm_point q2, prev, cur;
+    xdbl(&q2, &q, &c);
+    prev = q;          /* (j - 2) Q */
+    cur = q;           /* j Q, j = 1 */
+    for (uint32_t j = 1; j < ECM_D / 2; j += 2) {
+        if (j > 1) {
+            ecm_point next;
+            xadd(&next, &cur, &q2, &prev, n);
+            prev = cur;
+            cur = next;
+        }
+        if (j % 3 && j % 5 && j % 7 && j % 11) {
+            baby[baby_j.size()] = cur;
+            baby_j.push_back(j);
+        }
+    }
+
+    /* Giant step m = 0 covers q < D / 2: q Q is the identity mod p when its Z is,
+     * read off the baby steps, or from a ladder for the primes dividing D */
+    bigint_set_u32(&acc, 1);
+    if (job->b1 < ECM_D / 2) {
+        static const uint32_t d_primes[4] = { 3, 5, 7, 11 };
+        for (size_t k = 0; k < baby_j.size(); k++) {
+            uint32_t j = baby_j[k];
+            if (j > job->b1 && j <= job->b2 && pg_odd_prime_bit(job->odd_primes, j)) {
+                pg_bigint_mod_mul(&acc, &acc, &baby[k].z, n);
+            }
+        }
+        for (int k = 0; k < 4; k++) {
+            if (d_primes[k] <= job->b1 || d_primes[k] > job->b2) continue;
+            ladder(&g0, &q, d_primes[k], &c);
+            pg_bigint_mod_mul(&acc, &acc, &g0.z, n);
+        }
+    }
+
+    /* Giant steps m D from just below B1 to B2 */
+    m = job->b1 / ECM_D;
+    if (m == 0) m = 1;
+    m_end = job->b2 / ECM_D + 1;
+    ladder(&step, &q, ECM_D, &c);
+    ladder(&g0, &q, m * ECM_D, &c);
+    ladder(&g1, &q, (m + 1) * ECM_D, &c);
+    for (; m <= m_end; m++) {
+        uint64_t center = m * ECM_D;
+        for (size_t k = 0; k < baby_j.size(); k++) {
+            uint64_t lo = center - baby_j[k], hi = center + baby_j[k];
+            int use = (lo > job->b1 && lo <= job->b2 && pg_odd_prime_bit(job->odd_primes, lo)) ||
+                      (hi > job->b1 && hi <= job->b2 && pg_odd_prime_bit(job->odd_primes, hi));
+            if (!use) continue;
+            pg_bigint_mod_mul(&u, &g0.x, &baby[k].z, n);
+            pg_bigint_mod_mul(&v, &baby[k].x, &g0.z, n);
+            bigint_mod_sub(&t, &u, &v, n);
+            pg_bigint_mod_mul(&acc, &acc, &t, n);
+        }
+        if (job->stop.load(std::memory_order_relaxed)) return -1;
+        /* (m + 2) D Q = (m + 1) D Q + D Q, difference m D Q */
+        ecm_point g2;
+        xadd(&g2, &g1, &step, &g0, n);
+        g0 = g1;
+        g1 = g2;
+    }
+    if (split(factor, &acc, n)) return 2;
+    return 0;
+}
+
+/* One pool task; curves are handed out one at a time, so tasks that start late just find fewer */
+static void ecm_worker(void *arg, uint32_t index) {
+    ecm_job *job = (ecm_job *)arg;
+    (void)index;
+    for (;;) {
+        pg_bigint factor;
+        uint32_t i = job->next.fetch_add(1);
+        if (i >= job->curves || job->stop.load()) return;
+        if (job->cancel && job->cancel(job->cancel_user)) {
+            job->stop.store(1);
+            return;
+        }
+        int stage = run_curve(job, job->sigmas[i], &factor);
+        if (stage < 0) return;
+        job->done.fetch_add(1);
+        if (stage > 0) {
+            std::lock_guard<std::mutex> guard(job->lock);
+            if (!job->found) {
+                job->found = 1;
+                bigint_copy(&job->result->factor, &factor);
+                job->result->stage = stage;
+                job->result->sigma = job->sigmas[i];
+            }
+            job->stop.store(1);
+            return;
+        }
+    }
+}
+
+int pg_ecm_big(pg_ctx *ctx, const pg_bigint *n, const pg_ecm_params *params, pg_ecm_result *result) {
+    pg_bigint small;
+    uint32_t p, i, threads;
+    uint64_t b2;
+    int cancelled;
+
+    if (params->b1 < 2 || params->curves < 1) return PG_ERR_INVALID_ARG;
+    b2 = params->b2 ? params->b2 : 100ULL * params->b1;
+    if (b2 > PG_ECM_MAX_B2) return PG_ERR_INVALID_ARG;
+    memset(result, 0, sizeof(*result));
+    bigint_set_u32(&small, 4);
+    if (bigint_compare(n, &small) < 0) return 0;
+
+    /* stage 0: trial division, and primes have no factor to find */
+    p = bigint_is_even(n) ? 2 : pg_small_prime_divisor_big(n);
+    bigint_set_u32(&small, p);
+    if (p != 0 && bigint_compare(n, &small) != 0) {
+        bigint_copy(&result->factor, &small);
+        return 1;
+    }
+    if (p != 0 || pg_is_probable_prime_bpsw_big(ctx, n, 0)) return 0;
+
+    ecm_job job;
+    std::vector<uint32_t> sigmas(params->curves);
+    for (i = 0; i < params->curves; i++) {
+        sigmas[i] = 6 + rng_next32(&ctx->rng) % 0xFFFFFF00U;
+    }
+    job.n = n;
+    job.b1 = params->b1;
+    job.b2 = b2;
+    /* stage 1 reads the bitmap up to b1, which may exceed b2 */
+    job.odd_primes = pg_sieve_odd_primes((b2 > params->b1 ? b2 : params->b1) + ECM_D + 1);
+    if (job.odd_primes == NULL) return PG_ERR_NOMEM;
+    job.sigmas = sigmas.data();
+    job.curves = params->curves;
+    job.next = 0;
+    job.done = 0;
+    job.stop = 0;
+    job.cancel = ctx->cancel;
+    job.cancel_user = ctx->cancel_user;
+    job.result = result;
+    job.found = 0;
+
+    threads = params->threads ? params->threads : pg_pool_size();
+    if (threads > params->curves) threads = params->curves;
+    pg_pool_run(threads, ecm_worker, &job);
+    free((void *)job.odd_primes);
+
+    result->curves = job.done.load();
+    cancelled = !job.found && job.stop.load();
+    if (cancelled) return PG_ERR_CANCELLED;
+    return job.found;
+}
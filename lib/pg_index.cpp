@@ -0,0 +1,321 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pg_internal.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/*
+ * Prime bitmap file with a rank/select index, for pi(x) and nth-prime
+ * lookups below 2^32
+ * - Bit i of the bitmap is set when 2i + 1 is prime; 2 is implied
+ * - Rank: the odd primes before every block of 8 words (512 bits), so
+ *   pi(x) is one table entry plus at most 8 popcounts
+ * - Select: the block holding every SELECT_EVERY-th odd prime. The k-th
+ *   prime lies between two samples; a binary search of the rank entries
+ *   there (about 200 blocks near 2^32) finds its block, popcounts its word
+ *   and the word is scanned bit by bit
+ * - The file is the header, the bitmap, the rank and the select tables, each
+ *   8-byte aligned, in host byte order. For 2^32 it is about 285 MB. It is
+ *   memory-mapped read-only (read into memory where mmap is missing), so
+ *   processes share the pages and queries from many threads need no lock
+ */
+
+#define INDEX_MAGIC "PGPRIMES"
+#define INDEX_VERSION 1
+#define BLOCK_WORDS 8
+#define SELECT_EVERY 8192
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t block_words;
+    uint64_t limit;          /* numbers below limit are covered */
+    uint64_t words;          /* bitmap words, a multiple of BLOCK_WORDS */
+    uint64_t odd_primes;
+    uint32_t select_every;
+    uint32_t select_count;
+} index_header;
+
+struct pg_prime_index {
+    void *base;
+    size_t size;
+    int mapped;
+    const index_header *h;
+    const uint64_t *bits;
+    const uint32_t *rank;      /* words / BLOCK_WORDS + 1 entries */
+    const uint32_t *select;    /* select_count entries */
+};
+
+static int popcount64(uint64_t x) {
+#if defined(__GNUC__)
+    return __builtin_popcountll(x);
+#else
+    int n = 0;
+    for (; x; x &= x - 1) n++;
+    return n;
+#endif
+}
+
+static int ctz64(uint64_t x) {
+#if defined(__GNUC__)
+    return __builtin_ctzll(x);
+#else
+    int n = 0;
+    for (; !(x & 1); x >>= 1) n++;
+    return n;
+#endif
+}
+
+static uint64_t align8(uint64_t n) {
+    return (n + 7) & ~7ULL;
+}
+
+/* Byte offsets of the tables after the header; the total size in *size */
+static void index_layout(const index_header *h, uint64_t *rank_at, uint64_t *select_at, uint64_t *size) {
+    uint64_t bits_at = align8(sizeof(index_header));
+    *rank_at = bits_at + h->words * 8;
+    *select_at = *rank_at + align8((h->words / BLOCK_WORDS + 1) * 4);
+    *size = *select_at + align8((uint64_t)h->select_count * 4);
+}
+
+static void set_prime_bit(void *user, uint64_t p) {
+    uint64_t *bits = (uint64_t *)user;
+    uint64_t i = p / 2;
+    bits[i / 64] |= 1ULL << (i % 64);
+}
+
+int pg_prime_index_build(pg_ctx *ctx, const char *path, uint64_t limit) {
+    index_header h;
+    uint64_t *bits;
+    uint32_t *rank, *select;
+    uint64_t rank_at, select_at, size, blocks, b, found = 0;
+    uint32_t samples = 0;
+    FILE *f;
+    int status;
+
+    if (path == NULL || limit < 3 || limit > (1ULL << 32)) return PG_ERR_INVALID_ARG;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, INDEX_MAGIC, 8);
+    h.version = INDEX_VERSION;
+    h.block_words = BLOCK_WORDS;
+    h.limit = limit;
+    blocks = (limit / 2 + 64 * BLOCK_WORDS - 1) / (64 * BLOCK_WORDS);
+    h.words = blocks * BLOCK_WORDS;
+    h.select_every = SELECT_EVERY;
+
+    bits = (uint64_t *)calloc(h.words, 8);
+    rank = (uint32_t *)malloc((blocks + 1) * 4);
+    select = (uint32_t *)malloc((limit / 2 / SELECT_EVERY + 1) * 4);
+    if (bits == NULL || rank == NULL || select == NULL) {
+        status = PG_ERR_NOMEM;
+        goto done;
+    }
+    status = limit > 3 ? pg_sieve_range_u64(ctx, 3, limit - 1, PG_RANGE_BUCKET, set_prime_bit, bits, NULL) : PG_OK;
+    if (status != PG_OK) goto done;
+
+    for (b = 0; b < blocks; b++) {
+        uint64_t in_block = 0;
+        int w;
+        rank[b] = (uint32_t)found;
+        for (w = 0; w < BLOCK_WORDS; w++) in_block += (uint64_t)popcount64(bits[b * BLOCK_WORDS + w]);
+        /* samples falling in this block */
+        while ((uint64_t)samples * SELECT_EVERY < found + in_block) select[samples++] = (uint32_t)b;
+        found += in_block;
+    }
+    rank[blocks] = (uint32_t)found;
+    h.odd_primes = found;
+    h.select_count = samples;
+
+    index_layout(&h, &rank_at, &select_at, &size);
+    f = fopen(path, "wb");
+    if (f == NULL) {
+        status = PG_ERR_IO;
+        goto done;
+    }
+    {
+        static const uint8_t zero[8] = { 0 };
+        int ok = fwrite(&h, sizeof(h), 1, f) == 1 &&
+                 fwrite(zero, 1, (size_t)(align8(sizeof(h)) - sizeof(h)), f) == align8(sizeof(h)) - sizeof(h) &&
+                 fwrite(bits, 8, (size_t)h.words, f) == h.words &&
+                 fwrite(rank, 4, (size_t)(blocks + 1), f) == blocks + 1 &&
+                 fwrite(zero, 1, (size_t)(select_at - rank_at - (blocks + 1) * 4), f) ==
+                     select_at - rank_at - (blocks + 1) * 4 &&
+                 fwrite(select, 4, samples, f) == samples &&
+                 fwrite(zero, 1, (size_t)(size - select_at - (uint64_t)samples * 4), f) ==
+                     size - select_at - (uint64_t)samples * 4;
+        if (fclose(f) != 0) ok = 0;
+        if (!ok) {
+            remove(path);
+            status = PG_ERR_IO;
+        }
+    }
+done:
+    free(bits);
+    free(rank);
+    free(select);
+    return status;
+}
+
+/* Checks the header against the file size and points the tables into it */
+static int index_attach(pg_prime_index *idx) {
+    const index_header *h = (const index_header *)idx->base;
+    uint64_t rank_at, select_at, size, blocks, j;
+    if (idx->size < sizeof(index_header) || memcmp(h->magic, INDEX_MAGIC, 8) != 0 ||
+        h->version != INDEX_VERSION || h->block_words != BLOCK_WORDS || h->select_every != SELECT_EVERY ||
+        h->limit < 3 || h->limit > (1ULL << 32) || h->words % BLOCK_WORDS != 0 ||
+        h->words * 64 < h->limit / 2 || h->words > (1ULL << 26)) {
+        return PG_ERR_IO;
+    }
+    index_layout(h, &rank_at, &select_at, &size);
+    if (size != idx->size) return PG_ERR_IO;
+    idx->h = h;
+    idx->bits = (const uint64_t *)((const char *)idx->base + align8(sizeof(index_header)));
+    idx->rank = (const uint32_t *)((const char *)idx->base + rank_at);
+    idx->select = (const uint32_t *)((const char *)idx->base + select_at);
+    /* lookups index by these, so a damaged file must not send them out of bounds */
+    blocks = h->words / BLOCK_WORDS;
+    if (idx->rank[blocks] != h->odd_primes ||
+        h->select_count != (h->odd_primes + SELECT_EVERY - 1) / SELECT_EVERY) {
+        return PG_ERR_IO;
+    }
+    for (j = 0; j < h->select_count; j++) {
+        if (idx->select[j] >= blocks) return PG_ERR_IO;
+    }
+    return PG_OK;
+}
+
+int pg_prime_index_open(const char *path, pg_prime_index **out) {
+    pg_prime_index *idx;
+    int status;
+
+    if (path == NULL || out == NULL) return PG_ERR_INVALID_ARG;
+    *out = NULL;
+    idx = (pg_prime_index *)calloc(1, sizeof(pg_prime_index));
+    if (idx == NULL) return PG_ERR_NOMEM;
+#ifndef _WIN32
+    {
+        struct stat st;
+        int fd = open(path, O_RDONLY);
+        if (fd < 0 || fstat(fd, &st) != 0 || st.st_size <= 0) {
+            if (fd >= 0) close(fd);
+            free(idx);
+            return PG_ERR_IO;
+        }
+        idx->size = (size_t)st.st_size;
+        idx->base = mmap(NULL, idx->size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (idx->base == MAP_FAILED) {
+            free(idx);
+            return PG_ERR_IO;
+        }
+        idx->mapped = 1;
+    }
+#else
+    {
+        FILE *f = fopen(path, "rb");
+        long n;
+        if (f == NULL || fseek(f, 0, SEEK_END) != 0 || (n = ftell(f)) <= 0 || fseek(f, 0, SEEK_SET) != 0) {
+            if (f != NULL) fclose(f);
+            free(idx);
+            return PG_ERR_IO;
+        }
+        idx->size = (size_t)n;
+        idx->base = malloc(idx->size);
+        if (idx->base == NULL || fread(idx->base, 1, idx->size, f) != idx->size) {
+            status = idx->base == NULL ? PG_ERR_NOMEM : PG_ERR_IO;
+            fclose(f);
+            free(idx->base);
+            free(idx);
+            return status;
+        }
+        fclose(f);
+    }
+#endif
+    status = index_attach(idx);
+    if (status != PG_OK) {
+        pg_prime_index_close(idx);
+        return status;
+    }
+    *out = idx;
+    return PG_OK;
+}
+
+void pg_prime_index_close(pg_prime_index *idx) {
+    if (idx == NULL) return;
+#ifndef _WIN32
+    if (idx->mapped) munmap(idx->base, idx->size);
+#endif
+    if (!idx->mapped) free(idx->base);
+    free(idx);
+}
+
+uint64_t pg_prime_index_limit(const pg_prime_index *idx) {
+    return idx->h->limit;
+}
+
+int pg_prime_index_is_prime(const pg_prime_index *idx, uint64_t n, int *prime) {
+    if (idx == NULL || prime == NULL) return PG_ERR_INVALID_ARG;
+    if (n >= idx->h->limit) return PG_ERR_OVERFLOW;
+    *prime = n == 2 || ((n & 1) && ((idx->bits[n / 128] >> (n / 2 % 64)) & 1));
+    return PG_OK;
+}
+
+int pg_prime_pi(const pg_prime_index *idx, uint64_t x, uint64_t *count) {
+    uint64_t i, w, b;
+    uint64_t n;
+    if (idx == NULL || count == NULL) return PG_ERR_INVALID_ARG;
+    if (x >= idx->h->limit) return PG_ERR_OVERFLOW;
+    if (x < 2) {
+        *count = 0;
+        return PG_OK;
+    }
+    /* odd primes among bits 0..i, plus 2 */
+    i = (x - 1) / 2;
+    b = i / (64 * BLOCK_WORDS);
+    n = idx->rank[b];
+    for (w = b * BLOCK_WORDS; w < i / 64; w++) n += (uint64_t)popcount64(idx->bits[w]);
+    n += (uint64_t)popcount64(idx->bits[i / 64] & (~0ULL >> (63 - i % 64)));
+    *count = n + 1;
+    return PG_OK;
+}
+
+int pg_nth_prime(const pg_prime_index *idx, uint64_t k, uint64_t *p) {
+    uint64_t lo, hi, w, r;
+    uint64_t word;
+    const index_header *h;
+    if (idx == NULL || p == NULL || k == 0) return PG_ERR_INVALID_ARG;
+    h = idx->h;
+    if (k == 1) {
+        *p = 2;
+        return PG_OK;
+    }
+    /* r-th odd prime, counting from 0 */
+    r = k - 2;
+    if (r >= h->odd_primes) return PG_ERR_OVERFLOW;
+    /* last block whose rank is at most r, between the samples around r */
+    lo = idx->select[r / SELECT_EVERY];
+    hi = r / SELECT_EVERY + 1 < h->select_count ? idx->select[r / SELECT_EVERY + 1] : h->words / BLOCK_WORDS - 1;
+    while (lo < hi) {
+        uint64_t mid = lo + (hi - lo + 1) / 2;
+        if (idx->rank[mid] <= r) lo = mid;
+        else hi = mid - 1;
+    }
+    r -= idx->rank[lo];
+    for (w = lo * BLOCK_WORDS;; w++) {
+        uint64_t c;
+        if (w == h->words) return PG_ERR_IO;   /* rank table disagrees with the bitmap */
+        c = (uint64_t)popcount64(idx->bits[w]);
+        if (r < c) break;
+        r -= c;
+    }
+    word = idx->bits[w];
+    for (; r > 0; r--) word &= word - 1;
+    *p = 2 * (64 * w + (uint64_t)ctz64(word)) + 1;
+    return PG_OK;
+}
@@ -0,0 +1,325 @@
+#ifndef PG_INTERNAL_H
+#define PG_INTERNAL_H
+
+#include <time.h>
+#include "primegen.h"
+#include "prime_rng.h"
+#include "prime_perf.h"
+#include "prime_trace.h"
+
+/*
+ * Declarations shared by the library's translation units; not installed
+ */
+
+/* Online cost model of the windowed sieve (pg_sieve.cpp). Costs are running
+ * averages in nanoseconds, 0 until the first measurement, kept per unit of
+ * candidate size so that measurements at one size carry over to the next */
+typedef struct {
+    int bits;            /* candidate size of the last selection */
+    int primes;          /* table primes sieved with */
+    int window;          /* odd positions per sieve window */
+    double residue_ns;   /* residue of the window base modulo one prime, per word */
+    double op_ns;        /* one sieve step: a prime per window or a crossed-off position */
+    double mr_ns;        /* Miller-Rabin on a composite that survived the sieve, per bits * words^2 */
+} pg_sieve_tuning;
+
+struct pg_ctx {
+    prime_rng rng;
+    pg_stats stats;
+    pg_sieve_tuning tune;
+    pg_progress_fn progress;
+    void *progress_user;
+    unsigned long long progress_every;
+    pg_cancel_fn cancel;
+    void *cancel_user;
+    perf_stages perf;
+    int perf_enabled;
+};
+
+/* Small primes for quick filtering, and how many of them to divide by
+ * per candidate bit length (pg_sieve.cpp, computed at compile time) */
+extern const unsigned int *const pg_small_primes;
+extern const int pg_small_primes_count;
+extern const int *const pg_trial_count_u64;    /* 65 entries */
+extern const int *const pg_trial_count_big;    /* PG_BIGINT_BITS + 1 entries */
+
+#define PG_TRIAL_MAX_PRIMES 6542    /* primes below 2^16 */
+#define PG_SIEVE_MAX_WINDOW 16384
+
+/* Bitmap of the odd primes below 'limit' from malloc (free() it), NULL when out of memory;
+ * query it with pg_odd_prime_bit */
+uint8_t *pg_sieve_odd_primes(uint64_t limit);
+static inline int pg_odd_prime_bit(const uint8_t *bits, uint64_t q) {
+    return (q & 1) && ((bits[q >> 4] >> ((q >> 1) & 7)) & 1);
+}
+
+/* Worker pool shared by the parallel modes (pg_pool.cpp). pg_pool_run calls fn(arg, i) for
+ * 0 <= i < tasks on the pinned workers and returns when all calls have; tasks must not wait for
+ * each other. pg_pool_size is the worker count, the default for threads == 0. */
+typedef void (*pg_task_fn)(void *arg, uint32_t index);
+void pg_pool_run(uint32_t tasks, pg_task_fn fn, void *arg);
+uint32_t pg_pool_size(void);
+
+/* Choose primes/window for 'bits'-bit candidates from the costs measured at any size */
+void pg_tune_select(pg_sieve_tuning *t, int bits);
+/* Size units the residue and Miller-Rabin costs are measured in */
+static inline double pg_tune_words(int bits) {
+    return (double)((bits + 31) / 32);
+}
+static inline double pg_tune_mr_units(int bits) {
+    double words = pg_tune_words(bits);
+    return bits * words * words;
+}
+/* Fold one measurement into a running average */
+static inline void pg_tune_observe(double *avg, double sample) {
+    *avg = *avg > 0 ? *avg + (sample - *avg) / 8 : sample;
+}
+
+/* Wall-clock time in nanoseconds for the cost model */
+static inline double pg_now_ns(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+/* Big-integer helpers */
+static inline void bigint_zero(pg_bigint *a) {
+    int i;
+    for (i = 0; i < PG_BIGINT_WORDS; i++) {
+        a->words[i] = 0;
+    }
+}
+
+static inline void bigint_set_u32(pg_bigint *a, unsigned int val) {
+    bigint_zero(a);
+    a->words[0] = val;
+}
+
+static inline int bigint_is_zero(const pg_bigint *a) {
+    int i;
+    for (i = 0; i < PG_BIGINT_WORDS; i++) {
+        if (a->words[i] != 0) return 0;
+    }
+    return 1;
+}
+
+static inline int bigint_is_one(const pg_bigint *a) {
+    int i;
+    if (a->words[0] != 1) return 0;
+    for (i = 1; i < PG_BIGINT_WORDS; i++) {
+        if (a->words[i] != 0) return 0;
+    }
+    return 1;
+}
+
+static inline int bigint_is_even(const pg_bigint *a) {
+    return (a->words[0] & 1) == 0;
+}
+
+static inline void bigint_copy(pg_bigint *dst, const pg_bigint *src) {
+    int i;
+    for (i = 0; i < PG_BIGINT_WORDS; i++) {
+        dst->words[i] = src->words[i];
+    }
+}
+
+/* Compare two big integers: return 1 if a > b, 0 if a == b, -1 if a < b */
+static inline int bigint_compare(const pg_bigint *a, const pg_bigint *b) {
+    int i;
+    for (i = PG_BIGINT_WORDS - 1; i >= 0; i--) {
+        if (a->words[i] > b->words[i]) return 1;
+        if (a->words[i] < b->words[i]) return -1;
+    }
+    return 0;
+}
+
+/* Right shift by 1 bit */
+static inline void bigint_shr_one(pg_bigint *a) {
+    unsigned int carry = 0;
+    int i;
+    for (i = PG_BIGINT_WORDS - 1; i >= 0; i--) {
+        unsigned int next_carry = a->words[i] & 1;
+        a->words[i] = (a->words[i] >> 1) | (carry << 31);
+        carry = next_carry;
+    }
+}
+
+/* c = a >> bits for 0 <= bits < 1024; c may alias a */
+static inline void bigint_shr(pg_bigint *c, const pg_bigint *a, int bits) {
+    int w = bits / 32, b = bits % 32, i;
+    for (i = 0; i < PG_BIGINT_WORDS; i++) {
+        uint32_t lo = i + w < PG_BIGINT_WORDS ? a->words[i + w] : 0;
+        uint32_t hi = i + w + 1 < PG_BIGINT_WORDS ? a->words[i + w + 1] : 0;
+        c->words[i] = b ? (lo >> b) | (hi << (32 - b)) : lo;
+    }
+}
+
+/* Scratch space of the big-integer kernels: the product before reduction,
+ * the normalized dividend and divisor of Algorithm D, and the accumulator
+ * of an exponentiation whose output aliases an input. One per thread
+ * (pg_bigint_ws_get); a hot loop fetches it once and passes it to the _ws
+ * kernels. A kernel owns all of it for the duration of the call, so
+ * nothing may be kept in it across calls */
+typedef struct {
+    pg_bigint_wide prod;
+    uint32_t un[PG_BIGINT_WORDS * 2 + 1];
+    uint32_t vn[PG_BIGINT_WORDS];
+    int nlen;       /* words of the divisor in vn */
+    int shift;      /* bits vn is shifted left by */
+    pg_bigint acc;
+} pg_bigint_ws;
+
+pg_bigint_ws *pg_bigint_ws_get(void);
+
+/* Big-integer algorithms used inside the library (pg_bigint.cpp) */
+/* q = num / n (if q is not NULL) and r = num mod n, n != 0; q or r may alias num, not each other */
+void pg_bigint_divmod_words(pg_bigint *q, pg_bigint *r, const uint32_t *num, int num_words, const pg_bigint *n);
+/* pg_bigint_mod_mul and pg_bigint_mod_exp on the caller's workspace; c may alias any input */
+void pg_bigint_mod_mul_ws(pg_bigint *c, const pg_bigint *a, const pg_bigint *b, const pg_bigint *n, pg_bigint_ws *ws);
+void pg_bigint_mod_exp_ws(pg_bigint *c, const pg_bigint *base, const pg_bigint *exp, const pg_bigint *mod,
+                          pg_bigint_ws *ws);
+/* g = gcd(a, b) for odd b */
+void pg_bigint_gcd_odd(pg_bigint *g, const pg_bigint *a, const pg_bigint *b);
+/* root = floor(sqrt(n)); returns 1 if n is a perfect square */
+int pg_bigint_isqrt(pg_bigint *root, const pg_bigint *n);
+/* Miller-Rabin rounds with random bases from rng; n odd and past trial division (pg_prime_big.cpp) */
+int pg_mr_rounds_big(pg_ctx *ctx, prime_rng *rng, const pg_bigint *n, int rounds);
+
+/* c = (a + b) mod n for a, b < n; the sum may carry past 1024 bits */
+static inline void bigint_mod_add(pg_bigint *c, const pg_bigint *a, const pg_bigint *b, const pg_bigint *n) {
+    uint32_t carry = pg_bigint_add(c, a, b);
+    if (carry || bigint_compare(c, n) >= 0) pg_bigint_sub(c, c, n);
+}
+
+/* c = (a - b) mod n for a, b < n */
+static inline void bigint_mod_sub(pg_bigint *c, const pg_bigint *a, const pg_bigint *b, const pg_bigint *n) {
+    int borrow = bigint_compare(a, b) < 0;
+    pg_bigint_sub(c, a, b);
+    if (borrow) pg_bigint_add(c, c, n);
+}
+
+/* 64x64 -> 128-bit multiply: returns the low half, *hi gets the high half */
+static inline uint64_t pg_mul64(uint64_t a, uint64_t b, uint64_t *hi) {
+#if defined(__SIZEOF_INT128__)
+    unsigned __int128 p = (unsigned __int128)a * b;
+    *hi = (uint64_t)(p >> 64);
+    return (uint64_t)p;
+#else
+    uint64_t a0 = (uint32_t)a, a1 = a >> 32, b0 = (uint32_t)b, b1 = b >> 32;
+    uint64_t p00 = a0 * b0, p01 = a0 * b1, p10 = a1 * b0, p11 = a1 * b1;
+    uint64_t mid = (p00 >> 32) + (uint32_t)p01 + (uint32_t)p10;
+    *hi = p11 + (p01 >> 32) + (p10 >> 32) + (mid >> 32);
+    return (mid << 32) | (uint32_t)p00;
+#endif
+}
+
+/* Montgomery form modulo an odd n < 2^64, R = 2^64.
+ * Values stay fully reduced in [0, n). */
+typedef struct {
+    uint64_t n;
+    uint64_t ninv;   /* n^-1 mod 2^64 */
+    uint64_t one;    /* R mod n */
+    uint64_t r2;     /* R^2 mod n */
+} pg_mont64;
+
+/* a * b * R^-1 mod n */
+static inline uint64_t pg_mont_mul(uint64_t a, uint64_t b, uint64_t n, uint64_t ninv) {
+    uint64_t thi, uhi;
+    uint64_t tlo = pg_mul64(a, b, &thi);
+    pg_mul64(tlo * ninv, n, &uhi);
+    return thi >= uhi ? thi - uhi : thi - uhi + n;
+}
+
+static inline void pg_mont_init(pg_mont64 *m, uint64_t n) {
+    uint64_t x = n;   /* correct to 3 bits: n * n = 1 mod 8 */
+    int i;
+    for (i = 0; i < 5; i++) x *= 2 - n * x;
+    m->n = n;
+    m->ninv = x;
+    m->one = (0 - n) % n;
+    m->r2 = pg_mulmod_u64(m->one, m->one, n);
+}
+
+static inline uint64_t pg_mont_to(const pg_mont64 *m, uint64_t a) {
+    return pg_mont_mul(a % m->n, m->r2, m->n, m->ninv);
+}
+
+static inline uint64_t pg_mont_from(const pg_mont64 *m, uint64_t a) {
+    return pg_mont_mul(a, 1, m->n, m->ninv);
+}
+
+#if defined(__SIZEOF_INT128__)
+#define PG_HAVE_U128 1
+__extension__ typedef unsigned __int128 pg_u128;
+
+/* 128x128 -> 256-bit multiply: returns the low half, *hi gets the high half */
+static inline pg_u128 pg_mul128(pg_u128 a, pg_u128 b, pg_u128 *hi) {
+    pg_u128 a0 = (uint64_t)a, a1 = a >> 64, b0 = (uint64_t)b, b1 = b >> 64;
+    pg_u128 p00 = a0 * b0, p01 = a0 * b1, p10 = a1 * b0, p11 = a1 * b1;
+    pg_u128 mid = (p00 >> 64) + (uint64_t)p01 + (uint64_t)p10;
+    *hi = p11 + (p01 >> 64) + (p10 >> 64) + (mid >> 64);
+    return (mid << 64) | (uint64_t)p00;
+}
+
+/* Montgomery form modulo an odd n < 2^128, R = 2^128, the same scheme as pg_mont64 */
+typedef struct {
+    pg_u128 n;
+    pg_u128 ninv;    /* n^-1 mod 2^128 */
+    pg_u128 one;     /* R mod n */
+    pg_u128 r2;      /* R^2 mod n */
+} pg_mont128;
+
+static inline pg_u128 pg_mont128_mul(const pg_mont128 *m, pg_u128 a, pg_u128 b) {
+    pg_u128 thi, uhi;
+    pg_u128 tlo = pg_mul128(a, b, &thi);
+    pg_mul128(tlo * m->ninv, m->n, &uhi);
+    return thi >= uhi ? thi - uhi : thi - uhi + m->n;
+}
+
+static inline pg_u128 pg_mont128_add(const pg_mont128 *m, pg_u128 a, pg_u128 b) {
+    pg_u128 s = a + b;
+    return s < a || s >= m->n ? s - m->n : s;
+}
+
+static inline pg_u128 pg_mont128_sub(const pg_mont128 *m, pg_u128 a, pg_u128 b) {
+    return a >= b ? a - b : a - b + m->n;
+}
+
+static inline void pg_mont128_init(pg_mont128 *m, pg_u128 n) {
+    pg_u128 x = n;   /* correct to 3 bits: n * n = 1 mod 8 */
+    int i;
+    for (i = 0; i < 6; i++) x *= 2 - n * x;
+    m->n = n;
+    m->ninv = x;
+    m->one = (0 - n) % n;
+    m->r2 = m->one;
+    /* R^2 = R * 2^128: 128 doublings of R mod n */
+    for (i = 0; i < 128; i++) m->r2 = pg_mont128_add(m, m->r2, m->r2);
+}
+
+static inline pg_u128 pg_mont128_to(const pg_mont128 *m, pg_u128 a) {
+    return pg_mont128_mul(m, a % m->n, m->r2);
+}
+
+/* Strong Lucas probable-prime test (Selfridge's parameters) of an odd n > 3
+ * with no small factor, in Montgomery form (pg_lucas.cpp) */
+int pg_strong_lucas_u128(const pg_mont128 *m);
+#endif
+
+/* Perf counters of the context, NULL when instrumentation is off */
+static inline perf_stages *ctx_perf(pg_ctx *ctx) {
+    return ctx->perf_enabled ? &ctx->perf : 0;
+}
+
+/* Count one candidate and report progress every progress_every candidates.
+ * Returns nonzero if the cancel hook asks generation to stop. */
+static inline int ctx_count_candidate(pg_ctx *ctx) {
+    if (ctx->cancel && ctx->cancel(ctx->cancel_user)) return 1;
+    ctx->stats.candidates++;
+    if (ctx->progress && ctx->stats.candidates % ctx->progress_every == 0) {
+        ctx->progress(ctx->progress_user, &ctx->stats);
+    }
+    return 0;
+}
+
+#endif
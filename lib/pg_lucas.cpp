@@ -0,0 +1,229 @@
+#include "pg_internal.h"
+
+/*
+ * Strong Lucas probable-prime test for big integers, the second half of
+ * Baillie-PSW
+ * - Selfridge's parameters: D is the first of 5, -7, 9, -11, ... with
+ *   Jacobi symbol (D/n) = -1, P = 1, Q = (1 - D) / 4
+ * - n + 1 = d 2^s; n passes if U_d = 0 or V_(d 2^r) = 0 for some r < s
+ * - U_k, V_k and Q^k are built from the top bit of d down with the
+ *   doubling formulas U_2k = U_k V_k, V_2k = V_k^2 - 2 Q^k and the step
+ *   U_k+1 = (P U_k + V_k) / 2, V_k+1 = (D U_k + P V_k) / 2: three modular
+ *   multiplications per bit of n
+ */
+
+/* Jacobi symbol (a/m) for odd m, both small */
+static int jacobi_u32(uint32_t a, uint32_t m) {
+    int j = 1;
+    a %= m;
+    while (a != 0) {
+        while ((a & 1) == 0) {
+            a >>= 1;
+            if ((m & 7) == 3 || (m & 7) == 5) j = -j;
+        }
+        uint32_t t = a;
+        a = m;
+        m = t;
+        if ((a & 3) == 3 && (m & 3) == 3) j = -j;
+        a %= m;
+    }
+    return m == 1 ? j : 0;
+}
+
+/* Jacobi symbol (d/n) for a small odd d (either sign) and odd n > |d| */
+static int jacobi_small(long d, const pg_bigint *n) {
+    uint32_t a = (uint32_t)(d < 0 ? -d : d);
+    uint32_t n8 = n->words[0] & 7;
+    int j = 1;
+    /* (-1/n) = -1 for n = 3 mod 4 */
+    if (d < 0 && (n8 & 3) == 3) j = -j;
+    /* reciprocity: (a/n) = (n/a), negated when a and n are both 3 mod 4 */
+    if ((a & 3) == 3 && (n8 & 3) == 3) j = -j;
+    return j * jacobi_u32(pg_bigint_mod_u32(n, a), a);
+}
+
+/* c = a / 2 mod n for odd n; c may alias a */
+static void mod_half(pg_bigint *c, const pg_bigint *a, const pg_bigint *n) {
+    uint32_t carry = 0;
+    if (a->words[0] & 1) {
+        carry = pg_bigint_add(c, a, n);
+        a = c;
+    }
+    bigint_shr(c, a, 1);
+    c->words[PG_BIGINT_WORDS - 1] |= carry << 31;
+}
+
+/* c = a * m mod n for a small signed m */
+static void mod_mul_small(pg_bigint *c, const pg_bigint *a, long m, const pg_bigint *n) {
+    uint32_t prod[PG_BIGINT_WORDS + 1];
+    unsigned long long carry = 0;
+    uint32_t mag = (uint32_t)(m < 0 ? -m : m);
+    int i;
+    for (i = 0; i < PG_BIGINT_WORDS; i++) {
+        carry += (unsigned long long)a->words[i] * mag;
+        prod[i] = (uint32_t)carry;
+        carry >>= 32;
+    }
+    prod[PG_BIGINT_WORDS] = (uint32_t)carry;
+    pg_bigint_mod_words(c, prod, PG_BIGINT_WORDS + 1, n);
+    if (m < 0 && !bigint_is_zero(c)) pg_bigint_sub(c, n, c);
+}
+
+int pg_strong_lucas_big(const pg_bigint *n) {
+    pg_bigint_ws *ws = pg_bigint_ws_get();
+    pg_bigint d, u, v, qk, t, one;
+    long D = 5, Q;
+    int s = 0, bit, r;
+
+    if (bigint_is_even(n)) {
+        pg_bigint two;
+        bigint_set_u32(&two, 2);
+        return bigint_compare(n, &two) == 0;
+    }
+    bigint_set_u32(&one, 1);
+    if (bigint_compare(n, &one) <= 0) return 0;
+
+    /* Selfridge's D; a square n would never give (D/n) = -1 */
+    for (;;) {
+        pg_bigint abs_d;
+        bigint_set_u32(&abs_d, (uint32_t)(D < 0 ? -D : D));
+        if (bigint_compare(n, &abs_d) <= 0) {
+            /* n this small can run out of D; it fits one word, decide it directly */
+            return pg_is_prime_u64(n->words[0]);
+        }
+        int j = jacobi_small(D, n);
+        if (j == -1) break;
+        if (j == 0) return 0;   /* |D| is a proper factor of n */
+        if (D == 13 && pg_bigint_isqrt(&t, n)) return 0;
+        D = D > 0 ? -(D + 2) : -D + 2;
+    }
+    Q = (1 - D) / 4;
+
+    /* n + 1 = d 2^s; n = 2^1024 - 1 carries out */
+    if (pg_bigint_add(&d, n, &one)) {
+        bigint_set_u32(&d, 1);
+        s = PG_BIGINT_BITS;
+    }
+    while (bigint_is_even(&d)) {
+        bigint_shr_one(&d);
+        s++;
+    }
+
+    /* U_1 = 1, V_1 = P = 1, Q^1 */
+    bigint_set_u32(&u, 1);
+    bigint_set_u32(&v, 1);
+    mod_mul_small(&qk, &one, Q, n);
+    for (bit = pg_bigint_bit_length(&d) - 2; bit >= 0; bit--) {
+        /* k -> 2k */
+        pg_bigint_mod_mul_ws(&u, &u, &v, n, ws);
+        pg_bigint_mod_mul_ws(&v, &v, &v, n, ws);
+        bigint_mod_sub(&v, &v, &qk, n);
+        bigint_mod_sub(&v, &v, &qk, n);
+        pg_bigint_mod_mul_ws(&qk, &qk, &qk, n, ws);
+        if ((d.words[bit / 32] >> (bit % 32)) & 1) {
+            /* k -> k + 1 with P = 1: U' = (U + V) / 2, V' = (D U + V) / 2 */
+            mod_mul_small(&t, &u, D, n);
+            bigint_mod_add(&u, &u, &v, n);
+            mod_half(&u, &u, n);
+            bigint_mod_add(&v, &t, &v, n);
+            mod_half(&v, &v, n);
+            mod_mul_small(&qk, &qk, Q, n);
+        }
+    }
+    if (bigint_is_zero(&u) || bigint_is_zero(&v)) return 1;
+    for (r = 1; r < s; r++) {
+        pg_bigint_mod_mul_ws(&v, &v, &v, n, ws);
+        bigint_mod_sub(&v, &v, &qk, n);
+        bigint_mod_sub(&v, &v, &qk, n);
+        if (bigint_is_zero(&v)) return 1;
+        pg_bigint_mod_mul_ws(&qk, &qk, &qk, n, ws);
+    }
+    return 0;
+}
+
+#if defined(PG_HAVE_U128)
+/* x / 2 mod n for odd n; x and n both odd makes (x + n) / 2 = x/2 + n/2 + 1 without overflow */
+static pg_u128 half_u128(pg_u128 x, pg_u128 n) {
+    return x & 1 ? (x >> 1) + (n >> 1) + 1 : x >> 1;
+}
+
+static int is_square_u128(pg_u128 n) {
+    pg_u128 r = 0, bit = (pg_u128)1 << 126;
+    while (bit > n) bit >>= 2;
+    while (bit) {
+        if (n >= r + bit) {
+            n -= r + bit;
+            r = (r >> 1) + bit;
+        } else {
+            r >>= 1;
+        }
+        bit >>= 2;
+    }
+    return n == 0;
+}
+
+/* A small signed value in Montgomery form */
+static pg_u128 mont128_small(const pg_mont128 *m, long v) {
+    pg_u128 a = pg_mont128_to(m, (pg_u128)(v < 0 ? -v : v));
+    return v < 0 ? pg_mont128_sub(m, 0, a) : a;
+}
+
+/* The same test as pg_strong_lucas_big on a 128-bit modulus */
+int pg_strong_lucas_u128(const pg_mont128 *m) {
+    pg_u128 n = m->n, d = n + 1, u, v, qk, dm, qm;
+    long D = 5, Q;
+    int s = 0, bit, r;
+
+    for (;;) {
+        uint32_t a = (uint32_t)(D < 0 ? -D : D);
+        int j = 1;
+        if (D < 0 && (n & 3) == 3) j = -j;
+        if ((a & 3) == 3 && (n & 3) == 3) j = -j;
+        j *= jacobi_u32((uint32_t)(n % a), a);
+        if (j == -1) break;
+        if (j == 0) return n == a;
+        if (D == 13 && is_square_u128(n)) return 0;
+        D = D > 0 ? -(D + 2) : -D + 2;
+    }
+    Q = (1 - D) / 4;
+
+    /* n + 1 = d 2^s; n = 2^128 - 1 carries out */
+    if (d == 0) {
+        d = 1;
+        s = 128;
+    }
+    while ((d & 1) == 0) {
+        d >>= 1;
+        s++;
+    }
+
+    dm = mont128_small(m, D);
+    qm = mont128_small(m, Q);
+    u = v = m->one;
+    qk = qm;
+    for (bit = 127; bit >= 0 && !((d >> bit) & 1); bit--) {
+    }
+    for (bit--; bit >= 0; bit--) {
+        u = pg_mont128_mul(m, u, v);
+        v = pg_mont128_mul(m, v, v);
+        v = pg_mont128_sub(m, v, qk);
+        v = pg_mont128_sub(m, v, qk);
+        qk = pg_mont128_mul(m, qk, qk);
+        if ((d >> bit) & 1) {
+            pg_u128 t = pg_mont128_mul(m, u, dm);
+            u = half_u128(pg_mont128_add(m, u, v), n);
+            v = half_u128(pg_mont128_add(m, t, v), n);
+            qk = pg_mont128_mul(m, qk, qm);
+        }
+    }
+    if (u == 0 || v == 0) return 1;
+    for (r = 1; r < s; r++) {
+        v = pg_mont128_mul(m, v, v);
+        v = pg_mont128_sub(m, v, qk);
+        v = pg_mont128_sub(m, v, qk);
+        if (v == 0) return 1;
+        qk = pg_mont128_mul(m, qk, qk);
+    }
+    return 0;
+}
+#endif
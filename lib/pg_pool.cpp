@@ -0,0 +1,226 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "pg_internal.h"
+
+#ifdef __linux__
+#include <dirent.h>
+#include <sched.h>
+#endif
+
+/*
+ * Worker pool shared by the parallel modes (ECM curves, SIQS sieving, the
+ * factor sieve)
+ * - One thread per CPU the process may run on, started on first use and
+ *   pinned to that CPU (Linux). CPUs are grouped by NUMA node from
+ *   /sys/devices/system/node; elsewhere, or without that directory, all
+ *   of them form one node
+ * - Each node has its own task queue. pg_pool_run deals the tasks of a
+ *   call to the nodes in turn; a worker takes from the front of its own
+ *   queue and, once that is empty, steals from the back of another's
+ * - Tasks allocate their buffers themselves after they start, so under
+ *   Linux's first-touch policy the pages land on the node of the CPU that
+ *   uses them, with no libnuma
+ * - Tasks are whole workers (a share of curves, polynomials or a part of a
+ *   range) that run for a long time, so one lock guards all queues
+ * - Tasks of one call must not wait for each other: with more tasks than
+ *   CPUs some start only after others finish. A call from inside a task
+ *   runs its tasks inline rather than queue behind itself
+ */
+
+typedef struct pool_batch {
+    std::mutex lock;
+    std::condition_variable done;
+    uint32_t pending;
+} pool_batch;
+
+typedef struct {
+    pg_task_fn fn;
+    void *arg;
+    uint32_t index;
+    pool_batch *batch;
+} pool_task;
+
+typedef struct {
+    std::mutex lock;
+    std::condition_variable ready;
+    std::vector<std::deque<pool_task> > queues;   /* one per node */
+    std::vector<int> cpus;                        /* -1 where pinning is unavailable */
+    std::vector<uint32_t> cpu_node;
+    uint32_t nodes;
+    uint32_t next_node;
+    uint32_t workers;                             /* threads that started */
+} worker_pool;
+
+static thread_local int in_pool_worker = 0;
+
+#ifdef __linux__
+/* CPUs of a cpulist such as "0-3,8-11" that are in 'allowed' */
+static void parse_cpulist(const char *text, const cpu_set_t *allowed, std::vector<int> &out) {
+    const char *s = text;
+    while (*s >= '0' && *s <= '9') {
+        char *end;
+        long a = strtol(s, &end, 10), b = a, c;
+        if (*end == '-') b = strtol(end + 1, &end, 10);
+        for (c = a; c <= b && c < CPU_SETSIZE; c++) {
+            if (CPU_ISSET((int)c, allowed)) out.push_back((int)c);
+        }
+        s = *end == ',' ? end + 1 : end;
+    }
+}
+
+/* Allowed CPUs grouped by node; false when the topology cannot be read */
+static bool read_topology(worker_pool *pool) {
+    cpu_set_t allowed;
+    DIR *dir;
+    struct dirent *ent;
+    std::vector<std::pair<int, std::vector<int> > > nodes;
+
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) return false;
+    dir = opendir("/sys/devices/system/node");
+    if (dir == NULL) return false;
+    while ((ent = readdir(dir)) != NULL) {
+        char path[320], text[4096];
+        int id;
+        FILE *f;
+        if (sscanf(ent->d_name, "node%d", &id) != 1) continue;
+        snprintf(path, sizeof(path), "/sys/devices/system/node/%s/cpulist", ent->d_name);
+        f = fopen(path, "r");
+        if (f == NULL) continue;
+        if (fgets(text, sizeof(text), f) != NULL) {
+            std::vector<int> cpus;
+            parse_cpulist(text, &allowed, cpus);
+            if (!cpus.empty()) nodes.push_back(std::make_pair(id, cpus));
+        }
+        fclose(f);
+    }
+    closedir(dir);
+    if (nodes.empty()) return false;
+    std::sort(nodes.begin(), nodes.end());
+    for (size_t n = 0; n < nodes.size(); n++) {
+        for (int cpu : nodes[n].second) {
+            pool->cpus.push_back(cpu);
+            pool->cpu_node.push_back((uint32_t)n);
+        }
+    }
+    pool->nodes = (uint32_t)nodes.size();
+    return true;
+}
+#endif
+
+static void pool_worker(worker_pool *pool, uint32_t slot) {
+    uint32_t node = pool->cpu_node[slot], n;
+#ifdef __linux__
+    if (pool->cpus[slot] >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(pool->cpus[slot], &set);
+        sched_setaffinity(0, sizeof(set), &set);
+    }
+#endif
+    in_pool_worker = 1;
+    std::unique_lock<std::mutex> guard(pool->lock);
+    for (;;) {
+        pool_task task;
+        if (!pool->queues[node].empty()) {
+            task = pool->queues[node].front();
+            pool->queues[node].pop_front();
+        } else {
+            /* steal from the back of the next node with work */
+            for (n = 1; n < pool->nodes && pool->queues[(node + n) % pool->nodes].empty(); n++) {
+            }
+            if (n == pool->nodes) {
+                pool->ready.wait(guard);
+                continue;
+            }
+            task = pool->queues[(node + n) % pool->nodes].back();
+            pool->queues[(node + n) % pool->nodes].pop_back();
+        }
+        guard.unlock();
+        task.fn(task.arg, task.index);
+        {
+            std::lock_guard<std::mutex> done(task.batch->lock);
+            if (--task.batch->pending == 0) task.batch->done.notify_all();
+        }
+        guard.lock();
+    }
+}
+
+/* The pool, started on first use; it lives until the process exits */
+static worker_pool *pool_get(void) {
+    static worker_pool *pool = NULL;
+    static std::once_flag started;
+    std::call_once(started, [] {
+        worker_pool *p = new worker_pool();
+        uint32_t i, count;
+#ifdef __linux__
+        if (!read_topology(p)) {
+            p->cpus.clear();
+            p->cpu_node.clear();
+        }
+#endif
+        if (p->cpus.empty()) {
+            count = std::thread::hardware_concurrency();
+            if (count == 0) count = 1;
+            p->cpus.assign(count, -1);
+            p->cpu_node.assign(count, 0);
+            p->nodes = 1;
+        }
+        p->queues.resize(p->nodes);
+        p->next_node = 0;
+        p->workers = 0;
+        /* a node whose threads failed to start is served by stealing */
+        try {
+            for (i = 0; i < p->cpus.size(); i++) {
+                std::thread(pool_worker, p, i).detach();
+                p->workers++;
+            }
+        } catch (const std::system_error &) {
+        }
+        pool = p;
+    });
+    return pool;
+}
+
+uint32_t pg_pool_size(void) {
+    uint32_t workers = pool_get()->workers;
+    return workers ? workers : 1;
+}
+
+void pg_pool_run(uint32_t tasks, pg_task_fn fn, void *arg) {
+    worker_pool *pool;
+    pool_batch batch;
+    uint32_t i;
+
+    pool = tasks > 1 && !in_pool_worker ? pool_get() : NULL;
+    if (pool == NULL || pool->workers == 0) {
+        for (i = 0; i < tasks; i++) fn(arg, i);
+        return;
+    }
+    batch.pending = tasks;
+    {
+        std::lock_guard<std::mutex> guard(pool->lock);
+        for (i = 0; i < tasks; i++) {
+            pool_task task = { fn, arg, i, &batch };
+            pool->queues[pool->next_node].push_back(task);
+            pool->next_node = (pool->next_node + 1) % pool->nodes;
+        }
+    }
+    pool->ready.notify_all();
+    std::unique_lock<std::mutex> wait(batch.lock);
+    batch.done.wait(wait, [&batch] { return batch.pending == 0; });
+}
+
+void pg_pool_topology(uint32_t *workers, uint32_t *nodes) {
+    worker_pool *pool = pool_get();
+    if (workers != NULL) *workers = pg_pool_size();
+    if (nodes != NULL) *nodes = pool->nodes;
+}
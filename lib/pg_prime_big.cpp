@@ -0,0 +1,399 @@
+#include <string.h>
+#include "pg_internal.h"
+
+/*
+ * Big-integer Miller-Rabin testing and prime generation
+ */
+
+/* Miller-Rabin witness test; a is used in place unless it needs reducing, and
+ * d = (n - 1) / 2^s comes from n - 1 in one shift */
+int pg_mr_witness_big(const pg_bigint *n, const pg_bigint *a) {
+    pg_bigint_ws *ws = pg_bigint_ws_get();
+    pg_bigint reduced, d, n_minus_1, x, one;
+    const pg_bigint *base = a;
+    int s = 0, r;
+
+    /* Reduce a >= n first */
+    if (bigint_compare(a, n) >= 0) {
+        pg_bigint_divmod_words(NULL, &reduced, a->words, PG_BIGINT_WORDS, n);
+        if (bigint_is_zero(&reduced)) return 1;
+        base = &reduced;
+    }
+
+    /* Write n-1 = d * 2^s */
+    bigint_set_u32(&one, 1);
+    pg_bigint_sub(&n_minus_1, n, &one);
+    while (s < PG_BIGINT_BITS && ((n_minus_1.words[s / 32] >> (s % 32)) & 1) == 0) s++;
+    if (s == PG_BIGINT_BITS) return 0;   /* n = 1 */
+    bigint_shr(&d, &n_minus_1, s);
+
+    /* Compute x = a^d mod n */
+    pg_bigint_mod_exp_ws(&x, base, &d, n, ws);
+
+    if (bigint_is_one(&x) || bigint_compare(&x, &n_minus_1) == 0) {
+        return 1;
+    }
+
+    for (r = 1; r < s; r++) {
+        pg_bigint_mod_mul_ws(&x, &x, &x, n, ws);
+        if (bigint_compare(&x, &n_minus_1) == 0) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/* Generate random a in [2, n-2], n > 3 */
+static void bigint_rand_range(prime_rng *rng, pg_bigint *a, const pg_bigint *n) {
+    pg_bigint n_minus_3;
+    pg_bigint three;
+    bigint_set_u32(&three, 3);
+    pg_bigint_sub(&n_minus_3, n, &three);
+
+    /* Generate random number */
+    int i;
+    for (i = 0; i < PG_BIGINT_WORDS; i++) {
+        a->words[i] = rng_next32(rng);
+    }
+
+    /* Reduce modulo (n-3) */
+    pg_bigint temp;
+    pg_bigint_mod_words(&temp, a->words, PG_BIGINT_WORDS, &n_minus_3);
+
+    /* Add 2 to get range [2, n-2] */
+    pg_bigint two;
+    bigint_set_u32(&two, 2);
+    pg_bigint_add(a, &temp, &two);
+}
+
+/* Miller-Rabin rounds with random bases from rng; n odd and past trial division */
+int pg_mr_rounds_big(pg_ctx *ctx, prime_rng *rng, const pg_bigint *n, int rounds) {
+    int bits = pg_bigint_bit_length(n);
+    pg_bigint a;
+    int i;
+    for (i = 0; i < rounds; i++) {
+        bigint_rand_range(rng, &a, n);
+        ctx->stats.mr_rounds++;
+
+        TRACE_MR_ROUND_START(bits, i);
+        int pass = pg_mr_witness_big(n, &a);
+        TRACE_MR_ROUND_END(bits, i, pass);
+        if (!pass) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* Check if number is probably prime using Miller-Rabin */
+int pg_is_probable_prime_big(pg_ctx *ctx, const pg_bigint *n, int rounds) {
+    if (rounds < 1) return PG_ERR_INVALID_ARG;
+
+    pg_bigint two;
+    bigint_set_u32(&two, 2);
+    if (bigint_compare(n, &two) < 0) return 0;
+
+    /* Small prime check */
+    uint32_t p = pg_small_prime_divisor_big(n);
+    if (p != 0) {
+        /* Check if n equals the small prime */
+        pg_bigint p_val;
+        bigint_set_u32(&p_val, p);
+        return bigint_compare(n, &p_val) == 0;
+    }
+
+    /* n is odd and above 3 here, so n - 3 > 0 */
+    return pg_mr_rounds_big(ctx, &ctx->rng, n, rounds);
+}
+
+/* Baillie-PSW, then 'rounds' random-base rounds on top */
+int pg_is_probable_prime_bpsw_big(pg_ctx *ctx, const pg_bigint *n, int rounds) {
+    if (rounds < 0) return PG_ERR_INVALID_ARG;
+
+    pg_bigint two;
+    bigint_set_u32(&two, 2);
+    if (bigint_compare(n, &two) < 0) return 0;
+
+    uint32_t p = pg_small_prime_divisor_big(n);
+    if (p != 0) {
+        pg_bigint p_val;
+        bigint_set_u32(&p_val, p);
+        return bigint_compare(n, &p_val) == 0;
+    }
+
+    int bits = pg_bigint_bit_length(n);
+    ctx->stats.mr_rounds++;
+    TRACE_MR_ROUND_START(bits, 0);
+    int pass = pg_mr_witness_big(n, &two);
+    TRACE_MR_ROUND_END(bits, 0, pass);
+    if (!pass || !pg_strong_lucas_big(n)) return 0;
+    return rounds > 0 ? pg_mr_rounds_big(ctx, &ctx->rng, n, rounds) : 1;
+}
+
+/* c = a + v; returns the carry out of the top word */
+static uint32_t bigint_add_u64(pg_bigint *c, const pg_bigint *a, uint64_t v) {
+    unsigned long long sum = 0;
+    int i;
+    for (i = 0; i < PG_BIGINT_WORDS; i++) {
+        sum = sum + a->words[i] + (i < 2 ? (uint32_t)(v >> (32 * i)) : 0);
+        c->words[i] = (unsigned int)sum;
+        sum = sum >> 32;
+    }
+    return (uint32_t)sum;
+}
+
+/* Miller-Rabin rounds for a sieved candidate, with bases from a substream keyed by the
+ * candidate. How many composites reach this depends on the measured sieve depth, so drawing
+ * from ctx->rng would make every later draw on the context depend on machine load */
+static int candidate_rounds(pg_ctx *ctx, const pg_bigint *n, int rounds) {
+    prime_rng bases;
+    unsigned long long tag = 0;
+    int i;
+    for (i = 0; i < PG_BIGINT_WORDS; i++) tag = rng_mix64(tag ^ n->words[i]);
+    rng_substream(&bases, &ctx->rng, tag);
+    return pg_mr_rounds_big(ctx, &bases, n, rounds);
+}
+
+/* Index of the first position j >= 0 with base + 2j divisible by odd prime p */
+static uint32_t first_multiple(const pg_bigint *base, uint32_t p) {
+    uint64_t r = pg_bigint_mod_u32(base, p);
+    /* solve r + 2j = 0 (mod p) with 2^-1 = (p + 1) / 2 */
+    return (uint32_t)((p - r) % p * ((p + 1) / 2) % p);
+}
+
+/* Find the first probable prime at or after a random odd 'bits'-bit start.
+ * Runs of consecutive odd numbers base + 2j are sieved a window at a time:
+ * mark[j] holds the index of the smallest sieving prime dividing position j,
+ * 0 for survivors, which then get the Miller-Rabin test. The sieve depth and
+ * window come from pg_tune_select(), which is fed the residue, sieve and
+ * Miller-Rabin costs measured here. */
+int pg_generate_prime_big(pg_ctx *ctx, int bits, int rounds, pg_bigint *out) {
+    static thread_local uint32_t next[PG_TRIAL_MAX_PRIMES];
+    static thread_local uint16_t mark[PG_SIEVE_MAX_WINDOW];
+    pg_sieve_tuning *tune = &ctx->tune;
+    perf_stages *perf = ctx_perf(ctx);
+    unsigned long long attempts = 0;
+    pg_bigint base;
+    int restart = 0;
+
+    if (bits < 16 || bits > PG_BIGINT_BITS || rounds < 1) return PG_ERR_INVALID_ARG;
+
+    pg_tune_select(tune, bits);
+    ctx->stats.trial_bound = pg_small_primes[tune->primes - 1];
+    ctx->stats.sieve_window = (uint32_t)tune->window;
+
+    /* Random odd start with the top bit set */
+    perf_stage(perf, PERF_STAGE_CANDIDATE);
+    pg_bigint_random(ctx, &base, bits);
+    base.words[0] |= 1;
+
+    while (1) {
+        int nprimes = tune->primes;
+        int window = tune->window;
+        uint64_t offset = 0;
+        int i, j;
+        double t0;
+
+        if (restart) {
+            /* ran past 2^bits: continue from the bottom of the range */
+            pg_bigint_set_u64(&base, 1);
+            base.words[(bits - 1) / 32] |= 1U << ((bits - 1) % 32);
+            restart = 0;
+        }
+
+        /* Residues of the run's base, once per run */
+        perf_stage(perf, PERF_STAGE_SIEVE);
+        t0 = pg_now_ns();
+        for (i = 1; i < nprimes; i++) {
+            next[i] = first_multiple(&base, pg_small_primes[i]);
+        }
+        pg_tune_observe(&tune->residue_ns, (pg_now_ns() - t0) / (nprimes - 1) / pg_tune_words(bits));
+
+        while (!restart) {
+            double marks = 0;
+
+            /* Cross off multiples, largest prime first so the smallest divisor wins */
+            perf_stage(perf, PERF_STAGE_SIEVE);
+            t0 = pg_now_ns();
+            memset(mark, 0, sizeof(mark[0]) * (size_t)window);
+            for (i = nprimes - 1; i >= 1; i--) {
+                uint32_t p = pg_small_primes[i];
+                uint32_t k = next[i];
+                marks += k < (uint32_t)window ? ((uint32_t)window - k + p - 1) / p : 0;
+                for (; k < (uint32_t)window; k += p) {
+                    mark[k] = (uint16_t)i;
+                }
+                next[i] = k - (uint32_t)window;
+            }
+            pg_tune_observe(&tune->op_ns, (pg_now_ns() - t0) / (nprimes + marks));
+
+            for (j = 0; j < window; j++) {
+                uint64_t step = 2 * (offset + (uint64_t)j);
+                if (ctx_count_candidate(ctx)) {
+                    perf_stage(perf, PERF_STAGE_OTHER);
+                    return PG_ERR_CANCELLED;
+                }
+                attempts++;
+                TRACE_CANDIDATE_DRAWN(bits, (((unsigned long long)base.words[1] << 32) | base.words[0]) + step);
+
+                if (mark[j]) {
+                    TRACE_SIEVE_REJECTED(bits, pg_small_primes[mark[j]]);
+                    ctx->stats.sieve_rejects++;
+                    continue;
+                }
+
+                /* a carry out of the top word wraps 'out' to a small number when bits is the maximum */
+                if (bigint_add_u64(out, &base, step) || pg_bigint_bit_length(out) > bits) {
+                    restart = 1;
+                    break;
+                }
+
+                /* Miller-Rabin primality test */
+                perf_stage(perf, PERF_STAGE_MR);
+                t0 = pg_now_ns();
+                if (candidate_rounds(ctx, out, rounds)) {
+                    perf_stage(perf, PERF_STAGE_OTHER);
+                    TRACE_PRIME_FOUND(bits, attempts);
+                    ctx->stats.primes++;
+                    /* retune for the next call */
+                    pg_tune_select(tune, bits);
+                    return PG_OK;
+                }
+                pg_tune_observe(&tune->mr_ns, (pg_now_ns() - t0) / pg_tune_mr_units(bits));
+                ctx->stats.mr_rejects++;
+                perf_stage(perf, PERF_STAGE_SIEVE);
+            }
+            offset += (uint64_t)window;
+        }
+    }
+}
+
+/* c = a + b * m; returns the carry out of the top word */
+static uint32_t bigint_add_mul_u32(pg_bigint *c, const pg_bigint *a, const pg_bigint *b, uint32_t m) {
+    unsigned long long sum = 0;
+    int i;
+    for (i = 0; i < PG_BIGINT_WORDS; i++) {
+        sum += (unsigned long long)b->words[i] * m + a->words[i];
+        c->words[i] = (unsigned int)sum;
+        sum >>= 32;
+    }
+    return (uint32_t)sum;
+}
+
+/* First probable prime base + j step (j >= 0) of at most 'bits' bits; step is even and shares no
+ * factor with the sieving primes. Windows of the progression are sieved like pg_generate_prime_big
+ * does with step 2, and feed the tuner the same three costs. PG_ERR_OVERFLOW when the progression
+ * leaves the range first. */
+static int progression_prime(pg_ctx *ctx, const pg_bigint *base, const pg_bigint *step, int bits, int rounds,
+                             pg_bigint *out) {
+    static thread_local uint32_t next[PG_TRIAL_MAX_PRIMES];
+    static thread_local uint16_t mark[PG_SIEVE_MAX_WINDOW];
+    pg_sieve_tuning *tune = &ctx->tune;
+    int nprimes, window, i, j;
+    pg_bigint run;
+    double t0;
+
+    pg_tune_select(tune, bits);
+    nprimes = tune->primes;
+    window = tune->window;
+    t0 = pg_now_ns();
+    for (i = 1; i < nprimes; i++) {
+        uint32_t p = pg_small_primes[i];
+        uint64_t r = pg_bigint_mod_u32(base, p), s = pg_bigint_mod_u32(step, p);
+        /* solve r + j s = 0 (mod p) */
+        next[i] = (uint32_t)((p - r) % p * pg_powmod_u64(s, p - 2, p) % p);
+    }
+    pg_tune_observe(&tune->residue_ns, (pg_now_ns() - t0) / (nprimes - 1) / pg_tune_words(bits));
+    bigint_copy(&run, base);
+    while (1) {
+        double marks = 0;
+
+        t0 = pg_now_ns();
+        memset(mark, 0, sizeof(mark[0]) * (size_t)window);
+        for (i = nprimes - 1; i >= 1; i--) {
+            uint32_t p = pg_small_primes[i];
+            uint32_t k = next[i];
+            marks += k < (uint32_t)window ? ((uint32_t)window - k + p - 1) / p : 0;
+            for (; k < (uint32_t)window; k += p) {
+                mark[k] = (uint16_t)i;
+            }
+            next[i] = k - (uint32_t)window;
+        }
+        pg_tune_observe(&tune->op_ns, (pg_now_ns() - t0) / (nprimes + marks));
+        for (j = 0; j < window; j++) {
+            if (ctx_count_candidate(ctx)) return PG_ERR_CANCELLED;
+            if (mark[j]) {
+                TRACE_SIEVE_REJECTED(bits, pg_small_primes[mark[j]]);
+                ctx->stats.sieve_rejects++;
+                continue;
+            }
+            if (bigint_add_mul_u32(out, &run, step, (uint32_t)j) || pg_bigint_bit_length(out) > bits) {
+                return PG_ERR_OVERFLOW;
+            }
+            t0 = pg_now_ns();
+            if (candidate_rounds(ctx, out, rounds)) return PG_OK;
+            pg_tune_observe(&tune->mr_ns, (pg_now_ns() - t0) / pg_tune_mr_units(bits));
+            ctx->stats.mr_rejects++;
+        }
+        if (bigint_add_mul_u32(&run, &run, step, (uint32_t)window)) return PG_ERR_OVERFLOW;
+    }
+}
+
+/* Gordon's construction: primes s and t, then r = 2 i t + 1 prime, then
+ * p = p0 + 2 j r s with p0 = 2 (s^(r-2) mod r) s - 1, so that p = 1 (mod r)
+ * and p = -1 (mod s). r and s take about half of p's bits each, less 18 so
+ * that the progression for p has 2^16 terms in range; t is 16 bits below r. */
+int pg_generate_strong_prime_big(pg_ctx *ctx, int bits, int rounds, pg_strong_prime *out) {
+    int s_bits, r_bits, t_bits, status;
+    pg_bigint i0, base, step, e, u, p0, rs2, low, d;
+    pg_bigint_wide wide;
+
+    if (bits < PG_STRONG_MIN_BITS || bits > PG_BIGINT_BITS || rounds < 1) return PG_ERR_INVALID_ARG;
+    s_bits = (bits - 18) / 2;
+    r_bits = bits - 18 - s_bits;
+    t_bits = r_bits - 16;
+
+    status = pg_generate_prime_big(ctx, s_bits, rounds, &out->s);
+    if (status != PG_OK) return status;
+    status = pg_generate_prime_big(ctx, t_bits, rounds, &out->t);
+    if (status != PG_OK) return status;
+
+    /* r = 2 i t + 1 from a random 15-bit i on; a fresh i if the run leaves r_bits */
+    pg_bigint_add(&step, &out->t, &out->t);
+    do {
+        pg_bigint_random(ctx, &i0, 15);
+        bigint_set_u32(&base, 1);
+        bigint_add_mul_u32(&base, &base, &step, i0.words[0]);
+        status = progression_prime(ctx, &base, &step, r_bits, rounds, &out->r);
+    } while (status == PG_ERR_OVERFLOW);
+    if (status != PG_OK) return status;
+
+    /* p0 = 2 u s - 1 with u = s^(r-2) mod r = s^-1 mod r */
+    bigint_set_u32(&e, 2);
+    pg_bigint_sub(&e, &out->r, &e);
+    pg_bigint_mod_words(&u, out->s.words, PG_BIGINT_WORDS, &out->r);
+    pg_bigint_mod_exp(&u, &u, &e, &out->r);
+    pg_bigint_mul(&wide, &u, &out->s);
+    memcpy(p0.words, wide.words, sizeof(p0.words));
+    pg_bigint_add(&p0, &p0, &p0);
+    bigint_set_u32(&e, 1);
+    pg_bigint_sub(&p0, &p0, &e);
+    pg_bigint_mul(&wide, &out->r, &out->s);
+    memcpy(rs2.words, wide.words, sizeof(rs2.words));
+    pg_bigint_add(&rs2, &rs2, &rs2);
+
+    /* The first term of p0 + j 2rs at or after a random 'bits'-bit start; from 2^(bits-1) if
+     * the progression runs past 2^bits first */
+    pg_bigint_random(ctx, &low, bits);
+    for (;;) {
+        pg_bigint_mod_words(&d, low.words, PG_BIGINT_WORDS, &rs2);
+        pg_bigint_sub(&base, &low, &d);
+        pg_bigint_add(&base, &base, &p0);
+        if (bigint_compare(&p0, &d) < 0) pg_bigint_add(&base, &base, &rs2);
+        status = progression_prime(ctx, &base, &rs2, bits, rounds, &out->p);
+        if (status != PG_ERR_OVERFLOW) return status;
+        bigint_zero(&low);
+        low.words[(bits - 1) / 32] = 1U << ((bits - 1) % 32);
+    }
+}
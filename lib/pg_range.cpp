@@ -0,0 +1,641 @@
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <new>
+#include <vector>
+#include "pg_internal.h"
+
+/*
+ * Segmented sieve of Eratosthenes over any range [lo, hi] below 2^64
+ * - A segment is a bitmap of SEG_BITS odd numbers (128 KB, sized for L2)
+ * - Sieving primes up to sqrt(hi) come one at a time from a second
+ *   segmented sieve run with the table primes below 2^16. A prime joins
+ *   just before the segment holding its square
+ * - Plain mode keeps every sieving prime with its next multiple and visits
+ *   all of them in every segment. Near 2^64 that is up to 2^28 primes per
+ *   segment, and almost none of them hits it
+ * - Bucket mode does that only for primes below SEG_BITS, which hit every
+ *   segment. A larger prime goes into the bucket of the segment holding its
+ *   next multiple, or is dropped once that lies past hi. Sieving a segment
+ *   empties its bucket: each entry crosses off one multiple and moves to
+ *   the bucket of the next one, so the work is the multiples in the segment.
+ *   Entries step over multiples of 3 and 5 with a mod-30 wheel, since the
+ *   presieve has those already
+ * - Buckets are fixed-size blocks chained per segment in a ring; emptied
+ *   blocks go to a free list and are reused
+ * - Both sieves start each window from a copy of the multiples of 3 to 13,
+ *   which repeat every 15015 odd numbers, and cross off from 17 on
+ */
+
+#define SEG_BITS (1U << 20)          /* odd numbers per segment */
+#define SEG_WORDS (SEG_BITS / 64)
+#define BUCKET_ENTRIES 1023
+#define BUCKET_RING (1U << 14)       /* a wheel step is at most 3p bits: within 3 * 2^32 / SEG_BITS segments */
+#define WHEEL_SHIFT 29               /* bucket_entry.bit holds the wheel position above the bit */
+#define PRESIEVE_PERIOD 15015        /* 3 * 5 * 7 * 11 * 13 */
+#define PRESIEVE_FIRST 6             /* index of 17 in pg_small_primes */
+
+typedef struct {
+    uint32_t prime;
+    uint32_t bit;       /* position of the multiple within its segment, wheel position << WHEEL_SHIFT */
+} bucket_entry;
+
+typedef struct bucket {
+    struct bucket *next;
+    uint32_t count;
+    bucket_entry e[BUCKET_ENTRIES];
+} bucket;
+
+/* Buckets of the segments ahead, segment s at head[s & mask] */
+typedef struct {
+    bucket **head;
+    uint64_t mask;
+    bucket *free_list;
+} bucket_ring;
+
+/* Odd primes 3 <= p <= limit in increasing order */
+typedef struct {
+    uint64_t limit;
+    uint64_t base;      /* odd number of bit 0 of the current window */
+    uint32_t pos;       /* next bit to look at */
+    int active;         /* table primes sieving so far */
+    uint32_t next[PG_TRIAL_MAX_PRIMES];    /* their next multiple, as a bit of the window */
+    uint64_t map[SEG_WORDS];
+} prime_source;
+
+typedef struct {
+    uint64_t first;     /* smallest odd number >= max(lo, 3); bit i is first + 2i */
+    uint64_t odds;      /* odd numbers in the range */
+    uint64_t segments;
+    int bucketed;
+    std::vector<uint32_t> primes;    /* visited in every segment */
+    std::vector<uint64_t> next;      /* their next multiple as a bit of the range, UINT64_MAX if none */
+    bucket_ring ring;
+    uint64_t map[SEG_WORDS];
+} range_sieve;
+
+static int popcount64(uint64_t x) {
+#if defined(__GNUC__)
+    return __builtin_popcountll(x);
+#else
+    int n = 0;
+    for (; x; x &= x - 1) n++;
+    return n;
+#endif
+}
+
+static int ctz64(uint64_t x) {
+#if defined(__GNUC__)
+    return __builtin_ctzll(x);
+#else
+    int n = 0;
+    for (; !(x & 1); x >>= 1) n++;
+    return n;
+#endif
+}
+
+static uint64_t isqrt_u64(uint64_t n) {
+    uint64_t r = 0, bit;
+    for (bit = 1ULL << 31; bit; bit >>= 1) {
+        uint64_t t = r | bit;
+        if (t * t <= n) r = t;
+    }
+    return r;
+}
+
+/* Bit j set when 2j + 1 has a factor 3 to 13; one period plus a word, so any 64 bits can be read */
+typedef struct {
+    uint64_t w[(PRESIEVE_PERIOD + 64 + 63) / 64 + 1];
+} presieve_table;
+
+static constexpr presieve_table make_presieve(void) {
+    const uint32_t q[5] = { 3, 5, 7, 11, 13 };
+    presieve_table t{};
+    for (uint32_t j = 0; j < PRESIEVE_PERIOD + 64; j++) {
+        for (int i = 0; i < 5; i++) {
+            if ((2 * j + 1) % q[i] == 0) t.w[j / 64] |= 1ULL << (j % 64);
+        }
+    }
+    return t;
+}
+
+static constexpr presieve_table presieve_pattern = make_presieve();
+
+/* Start a window whose bit 0 is the odd number 2 j0 + 1; 3 to 13 themselves stay marked */
+static void presieve(uint64_t *map, uint64_t j0) {
+    uint32_t o = (uint32_t)(j0 % PRESIEVE_PERIOD), w;
+    for (w = 0; w < SEG_WORDS; w++) {
+        uint32_t idx = o / 64, sh = o % 64;
+        map[w] = sh ? presieve_pattern.w[idx] >> sh | presieve_pattern.w[idx + 1] << (64 - sh) : presieve_pattern.w[idx];
+        o += 64;
+        if (o >= PRESIEVE_PERIOD) o -= PRESIEVE_PERIOD;
+    }
+}
+
+/* Clear the bits of the primes 3 to 13 in a window starting at odd 'base' */
+static void unmark_presieved(uint64_t *map, uint64_t base) {
+    uint64_t q;
+    for (q = 3; q <= 13; q += 2) {
+        if (q >= base && q != 9) map[(q - base) / 2 / 64] &= ~(1ULL << ((q - base) / 2 % 64));
+    }
+}
+
+/* Sieve the next window of odd numbers with the table primes; windows follow each other from 3,
+ * so a prime joins in the window holding its square and keeps its offset from then on */
+static void source_fill(prime_source *ps) {
+    uint64_t end = ps->base + 2ULL * (SEG_BITS - 1);
+    int i;
+    presieve(ps->map, ps->base / 2);
+    unmark_presieved(ps->map, ps->base);
+    for (i = PRESIEVE_FIRST; i < pg_small_primes_count; i++) {
+        uint32_t q = pg_small_primes[i], k;
+        if (i >= ps->active) {
+            if ((uint64_t)q * q > end) break;
+            ps->next[i] = (uint32_t)(((uint64_t)q * q - ps->base) / 2);
+            ps->active = i + 1;
+        }
+        for (k = ps->next[i]; k < SEG_BITS; k += q) ps->map[k / 64] |= 1ULL << (k % 64);
+        ps->next[i] = k - SEG_BITS;
+    }
+    ps->pos = 0;
+}
+
+/* Next prime of the source, 0 when past its limit */
+static uint64_t source_next(prime_source *ps) {
+    for (;;) {
+        while (ps->pos < SEG_BITS) {
+            uint32_t w = ps->pos / 64;
+            uint64_t live = ~ps->map[w] & (~0ULL << (ps->pos % 64));
+            if (live == 0) {
+                ps->pos = (w + 1) * 64;
+                continue;
+            }
+            uint32_t bit = w * 64 + (uint32_t)ctz64(live);
+            uint64_t p = ps->base + 2ULL * bit;
+            ps->pos = bit + 1;
+            return p <= ps->limit ? p : 0;
+        }
+        ps->base += 2ULL * SEG_BITS;
+        if (ps->base > ps->limit) return 0;
+        source_fill(ps);
+    }
+}
+
+/* A ring of at least 'segments' heads */
+static int ring_init(bucket_ring *ring, uint64_t segments) {
+    uint64_t size = 1;
+    while (size < segments) size *= 2;
+    ring->head = (bucket **)calloc(size, sizeof(bucket *));
+    ring->mask = size - 1;
+    ring->free_list = NULL;
+    return ring->head != NULL ? PG_OK : PG_ERR_NOMEM;
+}
+
+static int bucket_push(bucket_ring *ring, uint64_t segment, uint32_t prime, uint32_t bit) {
+    bucket **head = &ring->head[segment & ring->mask];
+    bucket *b = *head;
+    if (b == NULL || b->count == BUCKET_ENTRIES) {
+        bucket *fresh = ring->free_list;
+        if (fresh != NULL) {
+            ring->free_list = fresh->next;
+        } else {
+            fresh = (bucket *)malloc(sizeof(bucket));
+            if (fresh == NULL) return PG_ERR_NOMEM;
+        }
+        fresh->count = 0;
+        fresh->next = b;
+        *head = fresh;
+        b = fresh;
+    }
+    b->e[b->count].prime = prime;
+    b->e[b->count].bit = bit;
+    b->count++;
+    return PG_OK;
+}
+
+/* Bit of the first odd multiple of p at or above max(p^2, first), UINT64_MAX past the range */
+static uint64_t first_multiple_bit(const range_sieve *rs, uint64_t p) {
+    uint64_t m, bit;
+    if (p * p >= rs->first) {
+        m = p * p;
+    } else {
+        uint64_t q = rs->first / p + (rs->first % p != 0);
+        if (!(q & 1)) q++;
+        if (q > UINT64_MAX / p) return UINT64_MAX;
+        m = q * p;
+    }
+    bit = (m - rs->first) / 2;
+    return bit < rs->odds ? bit : UINT64_MAX;
+}
+
+/* Multipliers m coprime to 30 by residue: the wheel position of m mod 30, -1 for the others,
+ * and the distance to the next such m in bits (m p odd, so 2 numbers per bit) per position */
+static const int8_t wheel_position[30] = { -1, 0, -1, -1, -1, -1, -1, 1, -1, -1, -1, 2, -1, 3, -1,
+                                           -1, -1, 4, -1, 5, -1, -1, -1, 6, -1, -1, -1, -1, -1, 7 };
+static const uint32_t wheel_step[8] = { 3, 2, 1, 2, 1, 2, 3, 1 };
+
+static int add_sieving_prime(range_sieve *rs, uint64_t p) {
+    uint64_t m, bit;
+    if (p <= 13) return PG_OK;   /* presieved */
+    if (!rs->bucketed || p < SEG_BITS) {
+        rs->primes.push_back((uint32_t)p);
+        rs->next.push_back(first_multiple_bit(rs, p));
+        return PG_OK;
+    }
+    /* first m p >= max(p^2, first) with m coprime to 30 */
+    m = rs->first / p + (rs->first % p != 0);
+    if (m < p) m = p;
+    while (wheel_position[m % 30] < 0) m++;
+    if (m > UINT64_MAX / p) return PG_OK;
+    bit = (m * p - rs->first) / 2;
+    if (bit >= rs->odds) return PG_OK;
+    return bucket_push(&rs->ring, bit / SEG_BITS, (uint32_t)p,
+                       (uint32_t)(bit % SEG_BITS) | (uint32_t)wheel_position[m % 30] << WHEEL_SHIFT);
+}
+
+/* Cross off the multiples in segment s, which holds 'bits' odd numbers */
+static int sieve_segment(range_sieve *rs, uint64_t s, uint32_t bits) {
+    uint64_t start = s * SEG_BITS;
+    size_t i;
+    presieve(rs->map, rs->first / 2 + start);
+    if (s == 0) unmark_presieved(rs->map, rs->first);
+    for (i = 0; i < rs->primes.size(); i++) {
+        uint64_t b = rs->next[i], k;
+        uint32_t p = rs->primes[i];
+        if (b >= start + bits) continue;
+        /* 64-bit k: p reaches 2^32 - 1 near hi = 2^64, where a 32-bit k + p would wrap */
+        for (k = b - start; k < bits; k += p) rs->map[k / 64] |= 1ULL << (k % 64);
+        rs->next[i] = start + k;
+    }
+    if (!rs->bucketed) return PG_OK;
+
+    bucket *b = rs->ring.head[s & rs->ring.mask];
+    rs->ring.head[s & rs->ring.mask] = NULL;
+    while (b != NULL) {
+        for (i = 0; i < b->count; i++) {
+            uint32_t k = b->e[i].bit & ((1U << WHEEL_SHIFT) - 1), w = b->e[i].bit >> WHEEL_SHIFT;
+            uint32_t p = b->e[i].prime;
+            rs->map[k / 64] |= 1ULL << (k % 64);
+            /* p >= SEG_BITS, so the next multiple is in a later segment */
+            uint64_t ahead = k + (uint64_t)wheel_step[w] * p;
+            uint64_t seg = s + ahead / SEG_BITS;
+            if (seg < rs->segments &&
+                bucket_push(&rs->ring, seg, p, (uint32_t)(ahead % SEG_BITS) | ((w + 1) & 7) << WHEEL_SHIFT) != PG_OK) {
+                return PG_ERR_NOMEM;
+            }
+        }
+        bucket *done = b;
+        b = b->next;
+        done->next = rs->ring.free_list;
+        rs->ring.free_list = done;
+    }
+    return PG_OK;
+}
+
+static void free_buckets(bucket_ring *ring) {
+    uint64_t i;
+    if (ring->head == NULL) return;
+    for (i = 0; i <= ring->mask + 1; i++) {
+        bucket **head = i <= ring->mask ? &ring->head[i] : &ring->free_list;
+        while (*head != NULL) {
+            bucket *b = *head;
+            *head = b->next;
+            free(b);
+        }
+    }
+    free(ring->head);
+    ring->head = NULL;
+}
+
+static int sieve_range(pg_ctx *ctx, uint64_t lo, uint64_t hi, int mode, pg_prime_fn fn, void *user,
+                       uint64_t *count, range_sieve *rs, prime_source *ps) {
+    uint64_t found = 0, p, s;
+    int status = PG_OK;
+
+    if (lo <= 2 && hi >= 2) {
+        found++;
+        if (fn) fn(user, 2);
+    }
+    rs->first = lo < 3 ? 3 : lo | 1;
+    if (rs->first < lo || rs->first > hi) {
+        *count = found;
+        return PG_OK;
+    }
+    rs->odds = (hi - rs->first) / 2 + 1;
+    rs->segments = (rs->odds + SEG_BITS - 1) / SEG_BITS;
+    rs->bucketed = mode == PG_RANGE_BUCKET;
+    if (rs->bucketed && ring_init(&rs->ring, BUCKET_RING) != PG_OK) return PG_ERR_NOMEM;
+
+    ps->limit = isqrt_u64(hi);
+    ps->base = 3;
+    ps->active = 0;
+    source_fill(ps);
+    p = source_next(ps);
+
+    for (s = 0; s < rs->segments && status == PG_OK; s++) {
+        uint32_t bits = (uint32_t)(rs->odds - s * SEG_BITS < SEG_BITS ? rs->odds - s * SEG_BITS : SEG_BITS);
+        uint64_t last = rs->first + 2 * (s * SEG_BITS + bits - 1);
+        uint32_t w;
+
+        if (ctx != NULL && ctx->cancel && ctx->cancel(ctx->cancel_user)) return PG_ERR_CANCELLED;
+        /* primes whose square is at most this segment's end start sieving now */
+        while (p != 0 && p * p <= last && status == PG_OK) {
+            status = add_sieving_prime(rs, p);
+            p = source_next(ps);
+        }
+        if (status == PG_OK) status = sieve_segment(rs, s, bits);
+        if (status != PG_OK) break;
+
+        for (w = 0; w < (bits + 63) / 64; w++) {
+            uint64_t live = ~rs->map[w];
+            if (w == bits / 64) live &= (1ULL << (bits % 64)) - 1;
+            if (fn == NULL) {
+                found += (uint64_t)popcount64(live);
+                continue;
+            }
+            while (live) {
+                int bit = ctz64(live);
+                live &= live - 1;
+                fn(user, rs->first + 2 * (s * SEG_BITS + 64ULL * w + (uint64_t)bit));
+                found++;
+            }
+        }
+    }
+    *count = found;
+    return status;
+}
+
+int pg_sieve_range_u64(pg_ctx *ctx, uint64_t lo, uint64_t hi, int mode, pg_prime_fn fn, void *user,
+                       uint64_t *count) {
+    range_sieve *rs;
+    prime_source *ps;
+    uint64_t found = 0;
+    int status;
+
+    if (lo > hi || (mode != PG_RANGE_BUCKET && mode != PG_RANGE_PLAIN)) return PG_ERR_INVALID_ARG;
+    rs = new (std::nothrow) range_sieve();
+    ps = (prime_source *)malloc(sizeof(prime_source));
+    if (rs == NULL || ps == NULL) {
+        delete rs;
+        free(ps);
+        return PG_ERR_NOMEM;
+    }
+    try {
+        status = sieve_range(ctx, lo, hi, mode, fn, user, &found, rs, ps);
+    } catch (const std::bad_alloc &) {
+        status = PG_ERR_NOMEM;
+    }
+    free_buckets(&rs->ring);
+    delete rs;
+    free(ps);
+    if (count != NULL) *count = found;
+    return status;
+}
+
+/*
+ * Factor sieve: the complete factorization of every n in [lo, hi]
+ * - A segment holds FACTOR_SEG consecutive numbers. Each carries the
+ *   sieving primes found so far with their exponents, and their product
+ * - Sieving primes run up to sqrt(hi). Those below FACTOR_SEG sieve
+ *   every segment with each of their powers up to hi, so exponents
+ *   come without a division. Larger ones wait in buckets as above (with
+ *   every multiple, no wheel); their rare higher powers are divided
+ *   out of the cofactor at the end
+ * - n / product then has no prime factor up to sqrt(hi), so it is 1 or a
+ *   prime: the factorization is complete without a primality test
+ * - Pool tasks take contiguous parts of the range, each with its own prime
+ *   source and buckets
+ */
+
+#define FACTOR_SEG (1U << 15)          /* numbers per segment */
+#define FACTOR_MIN_PART (1ULL << 22)   /* numbers per worker at least: each sieves all primes to sqrt(hi) */
+
+typedef struct {
+    uint64_t first;     /* first number of the part */
+    uint64_t numbers;
+    std::vector<uint32_t> item_prime;  /* primes below FACTOR_SEG, once per power */
+    std::vector<uint64_t> item_power;  /* p^k <= hi, increasing k after each prime */
+    std::vector<uint64_t> item_next;   /* next multiple as an offset from the segment start */
+    bucket_ring ring;
+    uint64_t prod[FACTOR_SEG];
+    uint8_t count[FACTOR_SEG];
+    uint8_t exps[FACTOR_SEG][PG_FACTOR_MAX];
+    uint32_t primes[FACTOR_SEG][PG_FACTOR_MAX];
+} factor_sieve;
+
+typedef struct {
+    uint64_t lo, hi;
+    uint64_t part;                 /* numbers per task; the last takes the rest */
+    pg_factor_fn fn;
+    void *user;
+    pg_cancel_fn cancel;
+    void *cancel_user;
+    std::atomic<int> stop;
+    std::vector<int> status;       /* per task */
+} factor_job;
+
+/* Next positive multiple of q at or after 'first', as an offset; UINT64_MAX when past the 64-bit
+ * range. 0 would collect every prime */
+static uint64_t first_multiple_offset(uint64_t first, uint64_t q) {
+    uint64_t r = first % q;
+    if (first == 0) return q;
+    if (r == 0) return 0;
+    return q - r <= UINT64_MAX - first ? q - r : UINT64_MAX;
+}
+
+static int factor_add_prime(factor_sieve *fs, uint64_t hi, uint64_t p) {
+    if (p < FACTOR_SEG) {
+        uint64_t q = p;
+        for (;;) {
+            fs->item_prime.push_back((uint32_t)p);
+            fs->item_power.push_back(q);
+            fs->item_next.push_back(first_multiple_offset(fs->first, q));
+            if (q > hi / p) return PG_OK;
+            q *= p;
+        }
+    }
+    uint64_t off = first_multiple_offset(fs->first, p);
+    if (off >= fs->numbers) return PG_OK;
+    return bucket_push(&fs->ring, off / FACTOR_SEG, (uint32_t)p, (uint32_t)(off % FACTOR_SEG));
+}
+
+/* Slot of prime p for the number at offset k, once per multiple */
+static void factor_hit(factor_sieve *fs, uint32_t k, uint32_t p) {
+    fs->primes[k][fs->count[k]] = p;
+    fs->exps[k][fs->count[k]] = 1;
+    fs->count[k]++;
+    fs->prod[k] *= p;
+}
+
+static int factor_segment(factor_sieve *fs, uint64_t s, uint32_t len) {
+    size_t i;
+    memset(fs->count, 0, len);
+    for (i = 0; i < len; i++) fs->prod[i] = 1;
+    for (i = 0; i < fs->item_power.size(); i++) {
+        uint64_t q = fs->item_power[i], k = fs->item_next[i];
+        uint32_t p = fs->item_prime[i];
+        if (k >= len) {
+            fs->item_next[i] = k - len;
+            continue;
+        }
+        /* powers near 2^64 would wrap k + q, so the step is taken relative to the segment end */
+        for (;;) {
+            if (q == p) {
+                factor_hit(fs, (uint32_t)k, p);
+            } else {
+                /* the slot of p is the last one: its powers follow it directly */
+                fs->exps[k][fs->count[k] - 1]++;
+                fs->prod[k] *= p;
+            }
+            if (q >= len - k) break;
+            k += q;
+        }
+        fs->item_next[i] = q - (len - k);
+    }
+
+    bucket *b = fs->ring.head[s & fs->ring.mask];
+    fs->ring.head[s & fs->ring.mask] = NULL;
+    while (b != NULL) {
+        for (i = 0; i < b->count; i++) {
+            uint32_t k = b->e[i].bit, p = b->e[i].prime;
+            factor_hit(fs, k, p);
+            uint64_t ahead = s * FACTOR_SEG + k + p;
+            if (ahead < fs->numbers &&
+                bucket_push(&fs->ring, ahead / FACTOR_SEG, p, (uint32_t)(ahead % FACTOR_SEG)) != PG_OK) {
+                return PG_ERR_NOMEM;
+            }
+        }
+        bucket *done = b;
+        b = b->next;
+        done->next = fs->ring.free_list;
+        fs->ring.free_list = done;
+    }
+    return PG_OK;
+}
+
+/* Hand the factorizations of segment s to fn */
+static void factor_emit(const factor_job *job, factor_sieve *fs, uint64_t s, uint32_t len) {
+    pg_factor f[PG_FACTOR_MAX];
+    uint32_t k;
+    int i, j, c;
+    for (k = 0; k < len; k++) {
+        uint64_t n = fs->first + s * FACTOR_SEG + k;
+        if (n < 2) {
+            job->fn(job->user, n, f, 0);
+            continue;
+        }
+        uint64_t rest = n / fs->prod[k];
+        c = fs->count[k];
+        for (i = 0; i < c; i++) {
+            pg_factor t;
+            t.prime = fs->primes[k][i];
+            t.exponent = fs->exps[k][i];
+            /* bucket primes arrive after the table ones and in no particular order */
+            for (j = i; j > 0 && f[j - 1].prime > t.prime; j--) f[j] = f[j - 1];
+            f[j] = t;
+        }
+        for (i = 0; i < c && rest > 1; i++) {
+            if (f[i].prime < FACTOR_SEG) continue;
+            while (rest % f[i].prime == 0) {
+                rest /= f[i].prime;
+                f[i].exponent++;
+            }
+        }
+        if (rest > 1) {
+            f[c].prime = rest;
+            f[c].exponent = 1;
+            c++;
+        }
+        job->fn(job->user, n, f, c);
+    }
+}
+
+static int factor_part(factor_job *job, uint64_t first, uint64_t numbers) {
+    factor_sieve *fs = new (std::nothrow) factor_sieve();
+    prime_source *ps = (prime_source *)malloc(sizeof(prime_source));
+    uint64_t limit = isqrt_u64(job->hi), s, segments, p;
+    int status = PG_OK;
+
+    if (fs == NULL || ps == NULL) {
+        delete fs;
+        free(ps);
+        return PG_ERR_NOMEM;
+    }
+    try {
+        fs->first = first;
+        fs->numbers = numbers;
+        segments = (numbers + FACTOR_SEG - 1) / FACTOR_SEG;
+        /* a bucket prime's next multiple is at most limit numbers ahead */
+        status = ring_init(&fs->ring, limit / FACTOR_SEG + 2);
+        if (status == PG_OK && limit >= 2) status = factor_add_prime(fs, job->hi, 2);
+        if (status == PG_OK && limit >= 3) {
+            ps->limit = limit;
+            ps->base = 3;
+            ps->active = 0;
+            source_fill(ps);
+            for (p = source_next(ps); p != 0 && status == PG_OK; p = source_next(ps)) {
+                status = factor_add_prime(fs, job->hi, p);
+            }
+        }
+        for (s = 0; s < segments && status == PG_OK; s++) {
+            uint32_t len = (uint32_t)(numbers - s * FACTOR_SEG < FACTOR_SEG ? numbers - s * FACTOR_SEG : FACTOR_SEG);
+            if (job->stop.load()) break;
+            if (job->cancel && job->cancel(job->cancel_user)) {
+                status = PG_ERR_CANCELLED;
+                break;
+            }
+            status = factor_segment(fs, s, len);
+            if (status == PG_OK) factor_emit(job, fs, s, len);
+        }
+    } catch (const std::bad_alloc &) {
+        status = PG_ERR_NOMEM;
+    }
+    if (status != PG_OK) job->stop.store(1);
+    free_buckets(&fs->ring);
+    delete fs;
+    free(ps);
+    return status;
+}
+
+/* Pool task 'index': its part of the range */
+static void factor_task(void *arg, uint32_t index) {
+    factor_job *job = (factor_job *)arg;
+    uint64_t skip = (uint64_t)index * job->part, span = job->hi - job->lo;
+    uint64_t numbers = span - skip < job->part ? span - skip + 1 : job->part;
+    job->status[index] = factor_part(job, job->lo + skip, numbers);
+}
+
+int pg_factor_range_u64(pg_ctx *ctx, uint64_t lo, uint64_t hi, uint32_t threads, pg_factor_fn fn, void *user) {
+    factor_job job;
+    uint64_t span;
+    uint32_t t;
+    int status = PG_OK;
+
+    if (lo > hi || fn == NULL) return PG_ERR_INVALID_ARG;
+    job.lo = lo;
+    job.hi = hi;
+    job.fn = fn;
+    job.user = user;
+    job.cancel = ctx != NULL ? ctx->cancel : NULL;
+    job.cancel_user = ctx != NULL ? ctx->cancel_user : NULL;
+    job.stop = 0;
+
+    /* one less than the count of numbers, which would wrap for the whole 64-bit range */
+    span = hi - lo;
+    if (threads == 0) threads = pg_pool_size();
+    if (threads > span / FACTOR_MIN_PART + 1) threads = (uint32_t)(span / FACTOR_MIN_PART + 1);
+    if (threads == 1) {
+        if (span == UINT64_MAX) {
+            status = factor_part(&job, 0, 1ULL << 63);
+            return status == PG_OK ? factor_part(&job, 1ULL << 63, 1ULL << 63) : status;
+        }
+        return factor_part(&job, lo, span + 1);
+    }
+    /* threads parts cover span + 1 numbers; rounding up may leave the last ones empty */
+    job.part = span / threads + 1;
+    threads = (uint32_t)(span / job.part + 1);
+    job.status.assign(threads, PG_OK);
+    pg_pool_run(threads, factor_task, &job);
+    for (t = 0; t < threads && status == PG_OK; t++) status = job.status[t];
+    return status;
+}
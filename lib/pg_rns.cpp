@@ -0,0 +1,265 @@
+#include <string.h>
+#include "pg_internal.h"
+#include "primegen_constexpr.hpp"
+
+/*
+ * Residue number system (RNS) backend for big-integer exponentiation
+ * - A value is held as its residues modulo two bases B and B' of RNS_K
+ *   primes just below 2^28 each; every channel is independent, there are
+ *   no carries between them
+ * - Modular multiplication is RNS Montgomery (Bajard, Didier, Kornerup):
+ *   q = -t N^-1 in B, extended to B' without correction (q + alpha M,
+ *   alpha < RNS_K, which only adds a multiple of N), r = (t + qN) / M in
+ *   B', then r extended exactly back to B, alpha from a floating sum
+ * - Base extension is a matrix-vector product with 56-bit terms summed in
+ *   64 bits and reduced once per channel, so its inner loop is a plain
+ *   multiply-add the compiler can vectorize
+ * - Values stay below (RNS_K + 2) N, far under M and M', which is what
+ *   makes the approximate first extension and the exact second one valid
+ */
+
+#define RNS_K     38                     /* 38 * 28 bits > 1024 + 2 log2(RNS_K + 2) */
+#define RNS_WORDS (RNS_K * 28 / 32 + 1)  /* 32-bit words of M and M' */
+
+typedef unsigned long long ull;
+
+/* Base constants, computed by the compiler (make_rns_tables) */
+typedef struct {
+    /* Moduli of both bases: m[0] is B, m[1] is B' */
+    uint32_t m[2][RNS_K];
+    /* (M_b / m_i)^-1 mod m_i */
+    uint32_t inv_mi[2][RNS_K];
+    /* ext[b][j][i] = (M_b / m_{b,i}) mod m_{1-b,j}; row j is one dot product */
+    uint32_t ext[2][RNS_K][RNS_K];
+    /* M_b mod m_{1-b,j} */
+    uint32_t m_mod[2][RNS_K];
+    /* M^-1 mod m'_j */
+    uint32_t minv[RNS_K];
+    double recip[RNS_K];   /* 1 / m'_j */
+    /* Positional M, M' and M' / m'_j, for conversions modulo N */
+    uint32_t big_m[RNS_WORDS];
+    uint32_t big_mp[RNS_WORDS];
+    uint32_t big_mpj[RNS_K][RNS_WORDS];
+} rns_tables;
+
+typedef struct {
+    uint32_t r[2][RNS_K];
+} rns_value;
+
+/* Per-modulus constants */
+typedef struct {
+    pg_bigint n;
+    uint32_t c[RNS_K];          /* -N^-1 (M / m_i)^-1 mod m_i */
+    uint32_t n1[RNS_K];         /* N mod m'_j */
+    pg_bigint m_mod_n;          /* M mod N: Montgomery form of 1 */
+    pg_bigint mpj_mod_n[RNS_K]; /* (M' / m'_j) mod N */
+    pg_bigint mp_neg_mod_n;     /* -M' mod N */
+} rns_modulus;
+
+/* Inverse modulo a prime below 2^32 */
+static constexpr uint32_t inv_mod_prime(uint32_t a, uint32_t p) {
+    ull r = 1, b = a % p;
+    for (uint32_t e = p - 2; e; e >>= 1) {
+        if (e & 1) r = r * b % p;
+        b = b * b % p;
+    }
+    return (uint32_t)r;
+}
+
+/* num = num * m for a multi-word num */
+static constexpr void words_mul_u32(uint32_t *num, int words, uint32_t m) {
+    ull carry = 0;
+    int i = 0;
+    for (i = 0; i < words; i++) {
+        carry += (ull)num[i] * m;
+        num[i] = (uint32_t)carry;
+        carry >>= 32;
+    }
+}
+
+/* q = num / d for a multi-word num */
+static constexpr void words_div_u32(uint32_t *q, const uint32_t *num, int words, uint32_t d) {
+    ull rem = 0;
+    int i = 0;
+    for (i = words - 1; i >= 0; i--) {
+        rem = (rem << 32) | num[i];
+        q[i] = (uint32_t)(rem / d);
+        rem %= d;
+    }
+}
+
+static constexpr rns_tables make_rns_tables(void) {
+    rns_tables t{};
+    uint32_t cand = (1U << 28) - 1;
+    int b = 0, i = 0, j = 0, l = 0;
+    /* the 2 * RNS_K largest primes below 2^28 */
+    for (b = 0; b < 2; b++) {
+        for (i = 0; i < RNS_K; cand -= 2) {
+            if (primegen::constexpr_is_prime(cand)) t.m[b][i++] = cand;
+        }
+    }
+    for (b = 0; b < 2; b++) {
+        for (i = 0; i < RNS_K; i++) {
+            ull mi = 1;
+            for (l = 0; l < RNS_K; l++) {
+                if (l != i) mi = mi * t.m[b][l] % t.m[b][i];
+            }
+            t.inv_mi[b][i] = inv_mod_prime((uint32_t)mi, t.m[b][i]);
+        }
+        for (j = 0; j < RNS_K; j++) {
+            uint32_t p = t.m[1 - b][j];
+            ull all = 1;
+            for (l = 0; l < RNS_K; l++) all = all * t.m[b][l] % p;
+            t.m_mod[b][j] = (uint32_t)all;
+            for (i = 0; i < RNS_K; i++) {
+                /* M_b / m_i = M_b * m_i^-1, all primes distinct */
+                t.ext[b][j][i] = (uint32_t)(all * inv_mod_prime(t.m[b][i] % p, p) % p);
+            }
+        }
+    }
+    for (j = 0; j < RNS_K; j++) {
+        t.minv[j] = inv_mod_prime(t.m_mod[0][j], t.m[1][j]);
+        t.recip[j] = 1.0 / t.m[1][j];
+    }
+    t.big_m[0] = t.big_mp[0] = 1;
+    for (i = 0; i < RNS_K; i++) {
+        words_mul_u32(t.big_m, RNS_WORDS, t.m[0][i]);
+        words_mul_u32(t.big_mp, RNS_WORDS, t.m[1][i]);
+    }
+    for (j = 0; j < RNS_K; j++) {
+        words_div_u32(t.big_mpj[j], t.big_mp, RNS_WORDS, t.m[1][j]);
+    }
+    return t;
+}
+
+static constexpr rns_tables rns = make_rns_tables();
+
+/* Constants for N; returns 0 if N shares a factor with M (or is even or 1) */
+static int rns_setup(rns_modulus *md, const pg_bigint *n) {
+    pg_bigint tmp;
+    int i, j;
+    if (bigint_is_even(n) || bigint_is_one(n)) return 0;
+    bigint_copy(&md->n, n);
+    for (i = 0; i < RNS_K; i++) {
+        uint32_t p = rns.m[0][i];
+        uint32_t r = pg_bigint_mod_u32(n, p);
+        if (r == 0) return 0;
+        md->c[i] = (uint32_t)((ull)(p - inv_mod_prime(r, p)) * rns.inv_mi[0][i] % p);
+    }
+    for (j = 0; j < RNS_K; j++) {
+        md->n1[j] = pg_bigint_mod_u32(n, rns.m[1][j]);
+        pg_bigint_mod_words(&md->mpj_mod_n[j], rns.big_mpj[j], RNS_WORDS, n);
+    }
+    pg_bigint_mod_words(&md->m_mod_n, rns.big_m, RNS_WORDS, n);
+    pg_bigint_mod_words(&tmp, rns.big_mp, RNS_WORDS, n);
+    if (bigint_is_zero(&tmp)) bigint_copy(&md->mp_neg_mod_n, &tmp);
+    else pg_bigint_sub(&md->mp_neg_mod_n, n, &tmp);
+    return 1;
+}
+
+/* Residues of a positional value in both bases */
+static void rns_from_bigint(rns_value *x, const pg_bigint *a) {
+    int b, i;
+    for (b = 0; b < 2; b++) {
+        for (i = 0; i < RNS_K; i++) x->r[b][i] = pg_bigint_mod_u32(a, rns.m[b][i]);
+    }
+}
+
+/* xi[j] = r'_j (M' / m'_j)^-1 mod m'_j, and alpha such that r = sum xi[j] M'/m'_j - alpha M' */
+static int rns_alpha(uint32_t *xi, const uint32_t *r1) {
+    double sum = 0.0;
+    int j;
+    for (j = 0; j < RNS_K; j++) {
+        xi[j] = (uint32_t)((ull)r1[j] * rns.inv_mi[1][j] % rns.m[1][j]);
+        sum += xi[j] * rns.recip[j];
+    }
+    /* sum = alpha + r / M' with r / M' < 2^-30, well inside the rounding margin */
+    return (int)(sum + 0.5);
+}
+
+/* z = x y M^-1 (mod N), z < (RNS_K + 2) N for x, y below that bound. z may alias x or y. */
+static void rns_mont_mul(rns_value *z, const rns_value *x, const rns_value *y, const rns_modulus *md) {
+    uint32_t xi[RNS_K], t1[RNS_K], r1[RNS_K];
+    int i, j, alpha;
+    for (i = 0; i < RNS_K; i++) {
+        uint32_t p = rns.m[0][i];
+        ull t = (ull)x->r[0][i] * y->r[0][i] % p;
+        xi[i] = (uint32_t)(t * md->c[i] % p);
+    }
+    for (j = 0; j < RNS_K; j++) {
+        t1[j] = (uint32_t)((ull)x->r[1][j] * y->r[1][j] % rns.m[1][j]);
+    }
+    /* q extended to B' (plus some alpha M), then r = (t + q N) / M in B' */
+    for (j = 0; j < RNS_K; j++) {
+        uint32_t p = rns.m[1][j];
+        const uint32_t *row = rns.ext[0][j];
+        ull acc = 0, q, r;
+        for (i = 0; i < RNS_K; i++) acc += (ull)xi[i] * row[i];
+        q = acc % p;
+        r = (t1[j] + q * md->n1[j]) % p;
+        r1[j] = (uint32_t)(r * rns.minv[j] % p);
+    }
+    /* exact extension of r back to B */
+    alpha = rns_alpha(xi, r1);
+    for (i = 0; i < RNS_K; i++) {
+        uint32_t p = rns.m[0][i];
+        ull acc = (ull)(p - rns.m_mod[1][i]) * (uint32_t)alpha;
+        for (j = 0; j < RNS_K; j++) acc += (ull)xi[j] * rns.ext[1][i][j];
+        z->r[0][i] = (uint32_t)(acc % p);
+    }
+    memcpy(z->r[1], r1, sizeof(r1));
+}
+
+/* c = x mod N for x < M', by CRT over B' with every term reduced modulo N */
+static void rns_to_bigint(pg_bigint *c, const rns_value *x, const rns_modulus *md) {
+    uint32_t xi[RNS_K];
+    uint32_t acc[PG_BIGINT_WORDS + 2] = {0};
+    int alpha = rns_alpha(xi, x->r[1]);
+    int i, j;
+    for (j = 0; j <= RNS_K; j++) {
+        /* the last term adds alpha (-M' mod N) */
+        const pg_bigint *v = j < RNS_K ? &md->mpj_mod_n[j] : &md->mp_neg_mod_n;
+        ull m = j < RNS_K ? xi[j] : (uint32_t)alpha;
+        ull carry = 0;
+        for (i = 0; i < PG_BIGINT_WORDS; i++) {
+            carry += acc[i] + m * v->words[i];
+            acc[i] = (uint32_t)carry;
+            carry >>= 32;
+        }
+        for (; i < PG_BIGINT_WORDS + 2; i++) {
+            carry += acc[i];
+            acc[i] = (uint32_t)carry;
+            carry >>= 32;
+        }
+    }
+    pg_bigint_mod_words(c, acc, PG_BIGINT_WORDS + 2, &md->n);
+}
+
+/* Modular exponentiation in RNS: c = (base^exp) mod mod */
+void pg_bigint_mod_exp_rns(pg_bigint *c, const pg_bigint *base, const pg_bigint *exp, const pg_bigint *mod) {
+    rns_modulus md;
+    rns_value result, b, one;
+    pg_bigint t;
+    int i, bit, bits = pg_bigint_bit_length(exp);
+    if (!rns_setup(&md, mod)) {
+        pg_bigint_mod_exp(c, base, exp, mod);
+        return;
+    }
+    /* into Montgomery form: base M mod N, and M mod N for 1 */
+    pg_bigint_mod_words(&t, base->words, PG_BIGINT_WORDS, mod);
+    pg_bigint_mod_mul(&t, &t, &md.m_mod_n, mod);
+    rns_from_bigint(&b, &t);
+    rns_from_bigint(&result, &md.m_mod_n);
+
+    for (bit = 0; bit < bits; bit++) {
+        if ((exp->words[bit / 32] >> (bit % 32)) & 1) {
+            rns_mont_mul(&result, &result, &b, &md);
+        }
+        rns_mont_mul(&b, &b, &b, &md);
+    }
+
+    /* out of Montgomery form */
+    for (i = 0; i < RNS_K; i++) one.r[0][i] = one.r[1][i] = 1;
+    rns_mont_mul(&result, &result, &one, &md);
+    rns_to_bigint(c, &result, &md);
+}
@@ -0,0 +1,187 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pg_internal.h"
+#include "primegen_constexpr.hpp"
+
+/*
+ * Small-prime trial division shared by the 64-bit and big-integer paths
+ * - The prime table (all primes below 2^16) and the per-bit-length
+ *   depths are computed at compile time (primegen_constexpr.hpp)
+ * - How deep to divide is chosen per candidate bit length from a cost
+ *   model: dividing by one more prime p pays off while its cost is below
+ *   the Miller-Rabin work it saves, c_div < c_mr / p, so the bound is
+ *   about c_mr / c_div
+ * - The big-integer generator sieves windows of consecutive odd numbers
+ *   instead; pg_tune_select() picks its depth and window size from costs
+ *   measured while it runs
+ */
+
+#define TRIAL_MAX_BOUND 65536
+
+/* Small primes for quick filtering, ascending */
+static constexpr primegen::prime_table<TRIAL_MAX_BOUND> small_table =
+    primegen::make_prime_table<TRIAL_MAX_BOUND>();
+static_assert(small_table.count == PG_TRIAL_MAX_PRIMES, "PG_TRIAL_MAX_PRIMES is the number of primes below 2^16");
+
+const unsigned int *const pg_small_primes = small_table.p;
+const int pg_small_primes_count = (int)small_table.count;
+
+/* 64-bit: a Miller-Rabin round is 'bits' Montgomery squarings plus a
+ * multiply for about every other exponent bit, 3 hardware multiplies each,
+ * and the Montgomery setup; one hardware division costs about as much as 5
+ * multiplies, so a round is worth about 'bits' divisions (timed at 1.2 to
+ * 1.5 'bits' on x86-64 for 32 to 64 bits) */
+static constexpr uint32_t model_bound_u64(int bits) {
+    return (uint32_t)bits;
+}
+
+/* Big integers: a round is 'bits' modular squarings of w = bits/32 words,
+ * each about 3 w^2 multiply-adds (product plus Knuth D reduction); dividing
+ * by a small prime is w word divisions, each worth about 3 multiply-adds */
+static constexpr uint32_t model_bound_big(int bits) {
+    uint32_t w = (uint32_t)(bits + 31) / 32;
+    return (uint32_t)bits * w;
+}
+
+/* Number of table primes <= bound; always covers 2 and 3 so the testers never see n <= 3 */
+static constexpr int primes_up_to(uint32_t bound) {
+    int lo = 2, hi = (int)small_table.count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (small_table.p[mid] <= bound) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+typedef struct {
+    /* Number of table primes to divide by, per bit length */
+    int count_u64[65];
+    int count_big[PG_BIGINT_BITS + 1];
+    /* Over the odd table primes among the first n: fraction of odd numbers
+     * with none of them as a factor, and the sum of their reciprocals */
+    double survive_prefix[PG_TRIAL_MAX_PRIMES + 1];
+    double recip_prefix[PG_TRIAL_MAX_PRIMES + 1];
+} trial_tables;
+
+static constexpr trial_tables make_trial_tables(void) {
+    trial_tables t{};
+    int bits = 0;
+    t.survive_prefix[0] = t.survive_prefix[1] = 1.0;
+    for (int i = 1; i < PG_TRIAL_MAX_PRIMES; i++) {
+        t.survive_prefix[i + 1] = t.survive_prefix[i] * (1.0 - 1.0 / small_table.p[i]);
+        t.recip_prefix[i + 1] = t.recip_prefix[i] + 1.0 / small_table.p[i];
+    }
+    for (bits = 0; bits <= 64; bits++) {
+        t.count_u64[bits] = primes_up_to(model_bound_u64(bits));
+    }
+    for (bits = 0; bits <= PG_BIGINT_BITS; bits++) {
+        t.count_big[bits] = primes_up_to(model_bound_big(bits));
+    }
+    return t;
+}
+
+/* Trial depths for all sizes, shared by both testers */
+static constexpr trial_tables trial = make_trial_tables();
+
+const int *const pg_trial_count_u64 = trial.count_u64;
+const int *const pg_trial_count_big = trial.count_big;
+
+/* Expected time per prime of the windowed sieve with the first n primes and
+ * a window of w odd positions, for candidates that are prime with probability q:
+ * residues once, sieve steps for every window touched until one holds a
+ * prime, and a Miller-Rabin test for every composite the sieve lets through */
+static double window_cost(int n, int w, double q, double residue, double op, double mr) {
+    double hit = 1.0 - pow(1.0 - q, w);
+    return n * residue + (n + w * trial.recip_prefix[n]) * op / hit + trial.survive_prefix[n] / q * mr;
+}
+
+void pg_tune_select(pg_sieve_tuning *t, int bits) {
+    double residue, op, mr, q, best = -1.0;
+    int max_primes, k, w;
+    t->bits = bits;
+    /* candidates are >= 2^(bits-1), so no sieving prime can be a candidate itself */
+    max_primes = bits > 17 ? pg_small_primes_count : primes_up_to((1U << (bits - 1)) - 1);
+    if (t->residue_ns > 0 && t->op_ns > 0 && t->mr_ns > 0) {
+        /* measured per unit, possibly at other sizes (strong primes mix four) */
+        residue = t->residue_ns * pg_tune_words(bits);
+        op = t->op_ns;
+        mr = t->mr_ns * pg_tune_mr_units(bits);
+    } else {
+        /* nothing measured yet: the static model in multiply-add units */
+        residue = 3.0 * pg_tune_words(bits);
+        op = 1.0;
+        mr = 3.0 * pg_tune_mr_units(bits);
+    }
+    q = 2.0 / (bits * log(2.0));
+    for (k = 4; k <= 16; k++) {
+        int n = primes_up_to(1U << k);
+        if (n > max_primes) n = max_primes;
+        for (w = 64; w <= PG_SIEVE_MAX_WINDOW; w *= 2) {
+            double cost = window_cost(n, w, q, residue, op, mr);
+            if (best < 0 || cost < best) {
+                best = cost;
+                t->primes = n;
+                t->window = w;
+            }
+        }
+    }
+}
+
+static int bit_length_u64(uint64_t n) {
+    int bits = 0;
+    while (n) {
+        bits++;
+        n >>= 1;
+    }
+    return bits;
+}
+
+uint32_t pg_trial_bound_u64(int bits) {
+    if (bits < 0 || bits > 64) return 0;
+    return pg_small_primes[pg_trial_count_u64[bits] - 1];
+}
+
+uint32_t pg_trial_bound_big(int bits) {
+    if (bits < 0 || bits > PG_BIGINT_BITS) return 0;
+    return pg_small_primes[pg_trial_count_big[bits] - 1];
+}
+
+double pg_trial_survival(uint32_t bound) {
+    double survive = 1.0;
+    for (int i = 1; i < pg_small_primes_count && pg_small_primes[i] <= bound; ++i) {
+        survive *= 1.0 - 1.0 / pg_small_primes[i];
+    }
+    return survive;
+}
+
+uint32_t pg_small_prime_divisor_u64(uint64_t n) {
+    int count = pg_trial_count_u64[bit_length_u64(n)];
+    for (int i = 0; i < count; ++i) {
+        if (n % pg_small_primes[i] == 0) return pg_small_primes[i];
+    }
+    return 0;
+}
+
+uint32_t pg_small_prime_divisor_big(const pg_bigint *n) {
+    int count = pg_trial_count_big[pg_bigint_bit_length(n)];
+    for (int i = 0; i < count; ++i) {
+        if (pg_bigint_mod_u32(n, pg_small_primes[i]) == 0) return pg_small_primes[i];
+    }
+    return 0;
+}
+
+uint8_t *pg_sieve_odd_primes(uint64_t limit) {
+    uint64_t size = limit / 16 + 1;
+    uint8_t *bits = (uint8_t *)malloc(size);
+    uint64_t i, j;
+    if (bits == NULL) return NULL;
+    memset(bits, 0xFF, size);
+    bits[0] &= (uint8_t)~1;   /* 1 is not prime */
+    for (i = 3; i * i < limit; i += 2) {
+        if (!pg_odd_prime_bit(bits, i)) continue;
+        for (j = i * i; j < limit; j += 2 * i) bits[j >> 4] &= (uint8_t)~(1U << ((j >> 1) & 7));
+    }
+    return bits;
+}
@@ -0,0 +1,752 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <set>
+#include <vector>
+#include "pg_internal.h"
+
+/*
+ * Self-initializing quadratic sieve (SIQS) for splitting composites of
+ * 64 to PG_SIQS_MAX_BITS bits
+ * - A Knuth-Schroeppel multiplier k makes small primes likelier to divide
+ *   values; the factor base is -1, 2 and the primes p with (kn/p) = 1, taken
+ *   from the library's prime sieve
+ * - Polynomials g(x) = ((Ax + B)^2 - kn) / A with A a product of s factor
+ *   base primes; each A gives 2^(s-1) values of B, switched in Gray-code
+ *   order so every root moves by one precomputed addition (the "self
+ *   initialization")
+ * - Sieving adds rounded log2 p over [-M, M); primes below 30 are skipped
+ *   and made up for in the threshold. Candidates are trial divided using
+ *   the roots, so only primes that do divide are divided out
+ * - Relations with one large prime below 64 pmax are kept and paired on
+ *   the large prime
+ * - Threads sieve different A; linear algebra is singleton removal and then
+ *   dense Gaussian elimination over GF(2) with the row history kept as bits
+ * - Every dependency gives X^2 = Y^2 (mod n); gcd(X - Y, n) is tried until
+ *   it splits n
+ */
+
+typedef unsigned long long ull;
+
+/* Factor base size and sieve half-width M by decimal digits of kn, interpolated.
+ * The base stops growing at 16000 primes to keep the dense matrix in memory. */
+static const struct {
+    int digits;
+    uint32_t fb;
+    uint32_t m;
+} siqs_table[] = {
+    { 20, 100, 8192 },
+    { 30, 200, 16384 },
+    { 40, 500, 32768 },
+    { 50, 1200, 32768 },
+    { 60, 2800, 49152 },
+    { 70, 5500, 65536 },
+    { 80, 10000, 98304 },
+    { 90, 14000, 131072 },
+    { 100, 16000, 163840 },
+};
+
+#define SIQS_SMALL_PRIME 30     /* primes below this are not sieved */
+#define SIQS_EXCESS 64          /* relations beyond the factor base size */
+#define SIQS_MAX_S 20
+
+/* Signed big integer for B and Ax + B */
+typedef struct {
+    int neg;
+    pg_bigint mag;
+} sbig;
+
+typedef struct {
+    pg_bigint y;                    /* product of the (Ax + B) mod n */
+    std::vector<uint32_t> factors;  /* factor base indices with multiplicity; 0 is -1 */
+    uint32_t large;                 /* large prime whose square is in the product; 1 if none */
+} siqs_relation;
+
+/* Shared by the workers of one pg_siqs_big call */
+typedef struct {
+    const pg_bigint *n;
+    pg_bigint kn;
+    uint32_t fb_size;
+    std::vector<uint32_t> prime;    /* index 0 is -1 (stored as 1), index 1 is 2 */
+    std::vector<uint32_t> sqrt_kn;  /* square root of kn mod p */
+    std::vector<uint8_t> logp;
+    uint32_t m;                     /* sieve over [-M, M) */
+    uint32_t lp_bound;
+    int threshold;
+    double log2_a;                  /* target size of A */
+    int s;                          /* primes in A */
+    uint32_t pool_lo, pool_hi;      /* factor base indices A's primes come from */
+    uint32_t needed;
+    std::atomic<int> stop;
+    std::atomic<uint64_t> polys;
+    uint64_t seed;                  /* worker i draws from stream i of it */
+    pg_cancel_fn cancel;
+    void *cancel_user;
+    int cancelled;
+    std::mutex lock;                /* guards everything below */
+    std::vector<siqs_relation> full;
+    std::map<uint32_t, siqs_relation> partial;
+    std::set<std::vector<uint32_t> > used_a;
+} siqs_job;
+
+/* a = a * m */
+static void mul_u32(pg_bigint *a, uint32_t m) {
+    ull carry = 0;
+    int i;
+    for (i = 0; i < PG_BIGINT_WORDS; i++) {
+        carry += (ull)a->words[i] * m;
+        a->words[i] = (uint32_t)carry;
+        carry >>= 32;
+    }
+}
+
+/* Words of a up to its highest nonzero one */
+static int used_words(const pg_bigint *a) {
+    int len = PG_BIGINT_WORDS;
+    while (len > 0 && a->words[len - 1] == 0) len--;
+    return len;
+}
+
+/* a mod d over the low len words; the values here are a few words long, so this beats
+ * pg_bigint_mod_u32 by the unused top words */
+static uint32_t mod_words(const pg_bigint *a, int len, uint32_t d) {
+    ull rem = 0;
+    int i;
+    for (i = len - 1; i >= 0; i--) rem = ((rem << 32) | a->words[i]) % d;
+    return (uint32_t)rem;
+}
+
+/* a = a / d, returns the remainder */
+static uint32_t div_u32(pg_bigint *a, uint32_t d) {
+    ull rem = 0;
+    int i;
+    for (i = used_words(a) - 1; i >= 0; i--) {
+        rem = (rem << 32) | a->words[i];
+        a->words[i] = (uint32_t)(rem / d);
+        rem %= d;
+    }
+    return (uint32_t)rem;
+}
+
+/* r = a + (b_neg ? -b : b) */
+static void sbig_add(sbig *r, const sbig *a, int b_neg, const pg_bigint *b) {
+    if (a->neg == b_neg) {
+        pg_bigint_add(&r->mag, &a->mag, b);
+        r->neg = a->neg;
+    } else if (bigint_compare(&a->mag, b) >= 0) {
+        pg_bigint_sub(&r->mag, &a->mag, b);
+        r->neg = a->neg;
+    } else {
+        pg_bigint_sub(&r->mag, b, &a->mag);
+        r->neg = b_neg;
+    }
+}
+
+static uint32_t mulmod32(uint32_t a, uint32_t b, uint32_t p) {
+    return (uint32_t)((ull)a * b % p);
+}
+
+/* a^-1 mod p for 0 < a < p, p prime */
+static uint32_t inv_mod(uint32_t a, uint32_t p) {
+    int64_t t0 = 0, t1 = 1;
+    uint32_t r0 = p, r1 = a;
+    while (r1 != 0) {
+        uint32_t q = r0 / r1, r = r0 - q * r1;
+        int64_t t = t0 - (int64_t)q * t1;
+        r0 = r1;
+        r1 = r;
+        t0 = t1;
+        t1 = t;
+    }
+    return (uint32_t)(t0 < 0 ? t0 + p : t0);
+}
+
+/* Square root of a quadratic residue a modulo an odd prime p (Tonelli-Shanks) */
+static uint32_t sqrt_mod(uint32_t a, uint32_t p) {
+    uint32_t q = p - 1, z = 2;
+    int s = 0;
+    if (a == 0) return 0;
+    if ((p & 3) == 3) return (uint32_t)pg_powmod_u64(a, (p + 1) / 4, p);
+    while ((q & 1) == 0) {
+        q >>= 1;
+        s++;
+    }
+    while (pg_powmod_u64(z, (p - 1) / 2, p) != p - 1) z++;
+    uint32_t c = (uint32_t)pg_powmod_u64(z, q, p);
+    uint32_t x = (uint32_t)pg_powmod_u64(a, (q + 1) / 2, p);
+    uint32_t t = (uint32_t)pg_powmod_u64(a, q, p);
+    while (t != 1) {
+        int i = 0;
+        uint32_t t2 = t;
+        while (t2 != 1) {
+            t2 = mulmod32(t2, t2, p);
+            i++;
+        }
+        uint32_t b = c;
+        for (int j = 0; j < s - i - 1; j++) b = mulmod32(b, b, p);
+        x = mulmod32(x, b, p);
+        c = mulmod32(b, b, p);
+        t = mulmod32(t, c, p);
+        s = i;
+    }
+    return x;
+}
+
+/* Knuth-Schroeppel: the multiplier that makes the most small primes residues of kn */
+static uint32_t choose_multiplier(const pg_bigint *n) {
+    static const uint32_t ks[] = { 1, 3, 5, 7, 11, 13, 15, 17, 19, 21, 23, 29, 31, 33, 35, 37, 39, 41, 43, 47,
+                                   51, 53, 55, 57, 59, 61, 65, 67, 69, 71, 73 };
+    double best = -1e30;
+    uint32_t best_k = 1;
+    for (size_t i = 0; i < sizeof(ks) / sizeof(ks[0]); i++) {
+        uint32_t k = ks[i];
+        double f = -0.5 * log((double)k);
+        uint32_t kn8 = (k * (n->words[0] & 7)) & 7;
+        if (kn8 == 1) f += 2.0 * log(2.0);
+        else if (kn8 == 5) f += log(2.0);
+        else f += 0.5 * log(2.0);
+        for (int j = 1; j < pg_small_primes_count && pg_small_primes[j] < 2000; j++) {
+            uint32_t p = pg_small_primes[j];
+            uint32_t r = mulmod32(k % p, pg_bigint_mod_u32(n, p), p);
+            if (r == 0) f += log((double)p) / p;
+            else if (pg_powmod_u64(r, (p - 1) / 2, p) == 1) f += 2.0 * log((double)p) / (p - 1);
+        }
+        if (f > best) {
+            best = f;
+            best_k = k;
+        }
+    }
+    return best_k;
+}
+
+/* Factor base, sieve parameters and A's shape for kn */
+static int build_factor_base(siqs_job *job) {
+    double log2_kn = 0;
+    int bits = pg_bigint_bit_length(&job->kn);
+    double digits = bits * log10(2.0);
+    size_t rows = sizeof(siqs_table) / sizeof(siqs_table[0]);
+    size_t i = 0;
+    double fb, m;
+    uint64_t limit;
+    for (int w = PG_BIGINT_WORDS - 1; w >= 0; w--) log2_kn = log2_kn * 4294967296.0 + job->kn.words[w];
+    log2_kn = log2(log2_kn);
+
+    while (i + 1 < rows - 1 && siqs_table[i + 1].digits < digits) i++;
+    {
+        double t = (digits - siqs_table[i].digits) / (siqs_table[i + 1].digits - siqs_table[i].digits);
+        if (t < 0) t = 0;
+        if (t > 1) t = 1;
+        fb = siqs_table[i].fb + t * ((double)siqs_table[i + 1].fb - siqs_table[i].fb);
+        m = siqs_table[i].m + t * ((double)siqs_table[i + 1].m - siqs_table[i].m);
+    }
+    job->fb_size = (uint32_t)fb;
+    job->m = ((uint32_t)m + 63) & ~63U;
+
+    /* -1 and 2, then the odd primes with (kn/p) = 1 or p | k */
+    job->prime.assign(1, 1);
+    job->prime.push_back(2);
+    for (limit = 4096; job->prime.size() < job->fb_size; limit *= 2) {
+        uint8_t *bits_map = pg_sieve_odd_primes(limit);
+        uint64_t p;
+        if (bits_map == NULL) return PG_ERR_NOMEM;
+        job->prime.resize(2);
+        for (p = 3; p < limit && job->prime.size() < job->fb_size; p += 2) {
+            uint32_t r;
+            if (!pg_odd_prime_bit(bits_map, p)) continue;
+            r = pg_bigint_mod_u32(&job->kn, (uint32_t)p);
+            if (r == 0 || pg_powmod_u64(r, (p - 1) / 2, p) == 1) job->prime.push_back((uint32_t)p);
+        }
+        free(bits_map);
+    }
+    job->sqrt_kn.resize(job->fb_size);
+    job->logp.resize(job->fb_size);
+    for (i = 1; i < job->fb_size; i++) {
+        uint32_t p = job->prime[i];
+        job->sqrt_kn[i] = p == 2 ? 1 : sqrt_mod(pg_bigint_mod_u32(&job->kn, p), p);
+        job->logp[i] = (uint8_t)(log2((double)p) + 0.5);
+    }
+
+    /* Largest |g(x)| is about M sqrt(kn / 2); accept what is left after one large prime, less
+     * an allowance for the unsieved small primes and prime powers that grows with n */
+    {
+        uint32_t pmax = job->prime[job->fb_size - 1];
+        double lp = 64.0 * pmax;
+        if (lp > (double)pmax * pmax) lp = (double)pmax * pmax;
+        if (lp > 4294967295.0) lp = 4294967295.0;
+        job->lp_bound = (uint32_t)lp;
+        job->threshold = (int)(log2((double)job->m) + (log2_kn - 1) / 2 - log2(lp) - (2.0 + digits / 5));
+    }
+
+    /* A near sqrt(2 kn) / M, from s primes well inside the factor base */
+    job->log2_a = (log2_kn + 1) / 2 - log2((double)job->m);
+    {
+        double qbits = log2((double)job->prime[job->fb_size - 1]) - 1.5;
+        if (qbits > 11.5) qbits = 11.5;
+        job->s = (int)ceil(job->log2_a / qbits);
+        if (job->s < 1) job->s = 1;
+        if (job->s > SIQS_MAX_S) return PG_ERR_INVALID_ARG;
+        qbits = job->log2_a / job->s;
+        job->pool_lo = job->fb_size;
+        job->pool_hi = 0;
+        for (i = 2; i < job->fb_size; i++) {
+            double b = log2((double)job->prime[i]);
+            if (job->prime[i] < SIQS_SMALL_PRIME || job->sqrt_kn[i] == 0) continue;
+            if (b < qbits - 1.0 || b > qbits + 1.0) continue;
+            if (i < job->pool_lo) job->pool_lo = (uint32_t)i;
+            job->pool_hi = (uint32_t)i + 1;
+        }
+        if (job->pool_hi < job->pool_lo + (uint32_t)job->s + 4) return PG_ERR_INVALID_ARG;
+    }
+    job->needed = job->fb_size + SIQS_EXCESS;
+    return PG_OK;
+}
+
+/* Per-thread state */
+typedef struct {
+    prime_rng rng;
+    std::vector<uint8_t> sieve;
+    std::vector<uint32_t> root1, root2, ainv;
+    std::vector<uint32_t> bainv;    /* s rows of fb_size: 2 B_l A^-1 mod p */
+    std::vector<uint8_t> in_a;      /* factor base primes that divide A */
+    std::vector<siqs_relation> found_full, found_partial;
+} siqs_worker;
+
+/* Pick A's primes; returns 0 if this draw should be retried */
+static int choose_a(siqs_job *job, siqs_worker *w, std::vector<uint32_t> &idx, pg_bigint *a) {
+    double have = 0;
+    uint32_t span = job->pool_hi - job->pool_lo;
+    idx.clear();
+    for (int l = 0; l < job->s - 1; l++) {
+        uint32_t k = job->pool_lo + (uint32_t)rng_uniform(&w->rng, span);
+        if (std::find(idx.begin(), idx.end(), k) != idx.end()) return 0;
+        idx.push_back(k);
+        have += log2((double)job->prime[k]);
+    }
+    /* the last prime brings A closest to its target */
+    double want = pow(2.0, job->log2_a - have);
+    std::vector<uint32_t>::iterator it =
+        std::lower_bound(job->prime.begin() + 2, job->prime.end(), (uint32_t)(want < 3 ? 3 : want > 4e9 ? 4e9 : want));
+    uint32_t last = (uint32_t)(it - job->prime.begin());
+    if (last >= job->fb_size) last = job->fb_size - 1;
+    if (job->prime[last] < SIQS_SMALL_PRIME || job->sqrt_kn[last] == 0) return 0;
+    if (std::find(idx.begin(), idx.end(), last) != idx.end()) return 0;
+    idx.push_back(last);
+    std::sort(idx.begin(), idx.end());
+    {
+        std::lock_guard<std::mutex> guard(job->lock);
+        if (!job->used_a.insert(idx).second) return 0;
+    }
+    pg_bigint_set_u64(a, 1);
+    for (size_t l = 0; l < idx.size(); l++) mul_u32(a, job->prime[idx[l]]);
+    return 1;
+}
+
+/* Trial divide Q((i - M)) for sieve position i; keeps full and single-large-prime relations */
+static void check_candidate(siqs_job *job, siqs_worker *w, const pg_bigint *a, const sbig *b, uint32_t i) {
+    sbig v;
+    pg_bigint q, t;
+    pg_bigint_wide sq;
+    siqs_relation rel;
+    int32_t x = (int32_t)i - (int32_t)job->m;
+    uint32_t k;
+
+    /* v = A x + B, q = |v^2 - kn| */
+    bigint_copy(&t, a);
+    mul_u32(&t, (uint32_t)(x < 0 ? -x : x));
+    {
+        sbig ax;
+        ax.neg = x < 0;
+        bigint_copy(&ax.mag, &t);
+        sbig_add(&v, &ax, b->neg, &b->mag);
+    }
+    pg_bigint_mul(&sq, &v.mag, &v.mag);
+    memcpy(q.words, sq.words, sizeof(q.words));
+    if (bigint_compare(&q, &job->kn) >= 0) {
+        pg_bigint_sub(&q, &q, &job->kn);
+    } else {
+        pg_bigint_sub(&q, &job->kn, &q);
+        rel.factors.push_back(0);
+    }
+    if (bigint_is_zero(&q)) return;
+    while (bigint_is_even(&q)) {
+        bigint_shr_one(&q);
+        rel.factors.push_back(1);
+    }
+    int q_len = used_words(&q);
+    for (k = 2; k < job->fb_size; k++) {
+        uint32_t p = job->prime[k];
+        if (w->in_a[k] || job->sqrt_kn[k] == 0) {
+            if (mod_words(&q, q_len, p) != 0) continue;
+        } else {
+            uint32_t r = i % p;
+            if (r != w->root1[k] && r != w->root2[k]) continue;
+        }
+        pg_bigint d;
+        bigint_copy(&d, &q);
+        while (div_u32(&d, p) == 0) {
+            bigint_copy(&q, &d);
+            rel.factors.push_back(k);
+        }
+    }
+    if (pg_bigint_bit_length(&q) > 32) return;
+    if (q.words[0] > job->lp_bound) return;
+    pg_bigint_mod_words(&rel.y, v.mag.words, PG_BIGINT_WORDS, job->n);
+    rel.large = q.words[0];
+    if (rel.large == 1) w->found_full.push_back(rel);
+    else w->found_partial.push_back(rel);
+}
+
+/* All 2^(s-1) polynomials of one A */
+static void sieve_a(siqs_job *job, siqs_worker *w, const std::vector<uint32_t> &idx, const pg_bigint *a) {
+    int s = (int)idx.size();
+    uint32_t fb = job->fb_size, m2 = 2 * job->m;
+    pg_bigint bl[SIQS_MAX_S];
+    sbig b;
+    uint32_t k;
+    int l;
+
+    std::fill(w->in_a.begin(), w->in_a.end(), 0);
+    for (l = 0; l < s; l++) w->in_a[idx[l]] = 1;
+    /* B_l = (A / q_l) * (sqrt(kn) (A / q_l)^-1 mod q_l), B = sum B_l; B^2 = kn (mod A) */
+    b.neg = 0;
+    bigint_zero(&b.mag);
+    for (l = 0; l < s; l++) {
+        uint32_t ql = job->prime[idx[l]];
+        pg_bigint al;
+        bigint_copy(&al, a);
+        div_u32(&al, ql);
+        uint32_t gamma = mulmod32(job->sqrt_kn[idx[l]], inv_mod(pg_bigint_mod_u32(&al, ql), ql), ql);
+        if (gamma > ql / 2) gamma = ql - gamma;
+        bigint_copy(&bl[l], &al);
+        mul_u32(&bl[l], gamma);
+        pg_bigint_add(&b.mag, &b.mag, &bl[l]);
+    }
+    int a_len = used_words(a), b_len = used_words(&b.mag), bl_len[SIQS_MAX_S];
+    for (l = 0; l < s; l++) bl_len[l] = used_words(&bl[l]);
+    for (k = 1; k < fb; k++) {
+        uint32_t p = job->prime[k];
+        if (w->in_a[k] || job->sqrt_kn[k] == 0 || p == 2) continue;
+        uint32_t ai = inv_mod(mod_words(a, a_len, p), p);
+        uint32_t bm = mod_words(&b.mag, b_len, p);
+        uint32_t t = job->sqrt_kn[k], mm = job->m % p;
+        w->ainv[k] = ai;
+        for (l = 0; l < s; l++) w->bainv[l * fb + k] = mulmod32(2 * mod_words(&bl[l], bl_len[l], p) % p, ai, p);
+        /* index-space roots of A x + B = +-t, shifted by M */
+        w->root1[k] = (mulmod32(ai, (t + p - bm) % p, p) + mm) % p;
+        w->root2[k] = (mulmod32(ai, (2 * p - t - bm) % p, p) + mm) % p;
+    }
+
+    for (uint32_t poly = 0; poly < (1U << (s - 1)); poly++) {
+        if (poly > 0) {
+            /* Gray code: flip the sign of B_v for v = 1 + lowest set bit */
+            int v = 0;
+            while (!((poly >> v) & 1)) v++;
+            int now_neg = ((poly ^ (poly >> 1)) >> v) & 1;
+            sbig nb;
+            pg_bigint twice;
+            pg_bigint_add(&twice, &bl[v + 1], &bl[v + 1]);
+            sbig_add(&nb, &b, now_neg, &twice);
+            b = nb;
+            const uint32_t *row = &w->bainv[(v + 1) * fb];
+            for (k = 2; k < fb; k++) {
+                uint32_t p = job->prime[k];
+                if (w->in_a[k] || job->sqrt_kn[k] == 0) continue;
+                /* B went down by 2 B_v: roots go up by 2 B_v / A, and the other way round */
+                uint32_t step = now_neg ? row[k] : p - row[k];
+                uint32_t r1 = w->root1[k] + step, r2 = w->root2[k] + step;
+                w->root1[k] = r1 >= p ? r1 - p : r1;
+                w->root2[k] = r2 >= p ? r2 - p : r2;
+            }
+        }
+        job->polys.fetch_add(1, std::memory_order_relaxed);
+
+        uint8_t *sv = w->sieve.data();
+        memset(sv, 0, m2);
+        for (k = 2; k < fb; k++) {
+            uint32_t p = job->prime[k];
+            uint8_t lg = job->logp[k];
+            uint32_t pos;
+            if (p < SIQS_SMALL_PRIME || w->in_a[k] || job->sqrt_kn[k] == 0) continue;
+            for (pos = w->root1[k]; pos < m2; pos += p) sv[pos] += lg;
+            if (w->root2[k] != w->root1[k]) {
+                for (pos = w->root2[k]; pos < m2; pos += p) sv[pos] += lg;
+            }
+        }
+        for (uint32_t i = 0; i < m2; i += 8) {
+            ull chunk;
+            memcpy(&chunk, sv + i, 8);
+            /* most chunks are far below the threshold; test eight bytes at once for >= 64 */
+            if (job->threshold >= 64 && (chunk & 0xC0C0C0C0C0C0C0C0ULL) == 0) continue;
+            for (uint32_t j = i; j < i + 8; j++) {
+                if (sv[j] >= job->threshold) check_candidate(job, w, a, &b, j);
+            }
+        }
+    }
+}
+
+/* Move a worker's relations into the job, pairing partials on their large prime */
+static void merge_relations(siqs_job *job, siqs_worker *w) {
+    std::lock_guard<std::mutex> guard(job->lock);
+    for (size_t i = 0; i < w->found_full.size(); i++) job->full.push_back(w->found_full[i]);
+    for (size_t i = 0; i < w->found_partial.size(); i++) {
+        siqs_relation &r = w->found_partial[i];
+        std::map<uint32_t, siqs_relation>::iterator it = job->partial.find(r.large);
+        if (it == job->partial.end()) {
+            job->partial[r.large] = r;
+            continue;
+        }
+        siqs_relation both;
+        pg_bigint_mod_mul(&both.y, &it->second.y, &r.y, job->n);
+        both.factors = it->second.factors;
+        both.factors.insert(both.factors.end(), r.factors.begin(), r.factors.end());
+        both.large = r.large;
+        job->full.push_back(both);
+    }
+    w->found_full.clear();
+    w->found_partial.clear();
+    if (job->full.size() >= job->needed) job->stop.store(1);
+}
+
+/* One pool task, sieving until the job has its relations */
+static void siqs_worker_run(void *arg, uint32_t index) {
+    siqs_job *job = (siqs_job *)arg;
+    siqs_worker w;
+    std::vector<uint32_t> idx;
+    pg_bigint a;
+    rng_init(&w.rng, job->seed, index);
+    w.sieve.resize(2 * job->m + 8);
+    w.root1.resize(job->fb_size);
+    w.root2.resize(job->fb_size);
+    w.ainv.resize(job->fb_size);
+    w.bainv.resize((size_t)job->s * job->fb_size);
+    w.in_a.resize(job->fb_size);
+    while (!job->stop.load()) {
+        if (job->cancel && job->cancel(job->cancel_user)) {
+            std::lock_guard<std::mutex> guard(job->lock);
+            job->cancelled = 1;
+            job->stop.store(1);
+            return;
+        }
+        if (!choose_a(job, &w, idx, &a)) continue;
+        sieve_a(job, &w, idx, &a);
+        merge_relations(job, &w);
+    }
+}
+
+/* Factor base indices with an odd exponent in a relation */
+static std::vector<uint32_t> odd_columns(const siqs_relation &r) {
+    std::vector<uint32_t> f = r.factors, odd;
+    std::sort(f.begin(), f.end());
+    for (size_t j = 0; j < f.size();) {
+        size_t run = 1;
+        while (j + run < f.size() && f[j + run] == f[j]) run++;
+        if (run & 1) odd.push_back(f[j]);
+        j += run;
+    }
+    return odd;
+}
+
+/* Try the dependencies of the relation matrix until one splits n */
+static int linear_algebra(siqs_job *job, pg_bigint *factor) {
+    std::vector<siqs_relation> &rel = job->full;
+    uint32_t fb = job->fb_size;
+    std::vector<std::vector<uint32_t> > cols(rel.size());
+    std::vector<uint32_t> weight(fb, 0);
+    std::vector<uint8_t> alive(rel.size(), 1);
+    size_t i, j;
+    int changed = 1;
+
+    for (i = 0; i < rel.size(); i++) {
+        cols[i] = odd_columns(rel[i]);
+        for (j = 0; j < cols[i].size(); j++) weight[cols[i][j]]++;
+    }
+    /* Singleton removal: a column set in only one row can never be paired off */
+    while (changed) {
+        changed = 0;
+        for (i = 0; i < rel.size(); i++) {
+            if (!alive[i]) continue;
+            for (j = 0; j < cols[i].size() && weight[cols[i][j]] != 1; j++) {
+            }
+            if (j == cols[i].size()) continue;
+            alive[i] = 0;
+            changed = 1;
+            for (j = 0; j < cols[i].size(); j++) weight[cols[i][j]]--;
+        }
+    }
+
+    /* Dense elimination: the odd-exponent columns, then one history bit per row */
+    std::vector<uint32_t> rows;
+    for (i = 0; i < rel.size(); i++) {
+        if (alive[i]) rows.push_back((uint32_t)i);
+    }
+    size_t nr = rows.size();
+    size_t cw = (fb + 63) / 64, hw = (nr + 63) / 64, width = cw + hw;
+    std::vector<ull> mat(nr * width, 0);
+    for (i = 0; i < nr; i++) {
+        ull *row = &mat[i * width];
+        const std::vector<uint32_t> &c = cols[rows[i]];
+        for (j = 0; j < c.size(); j++) row[c[j] / 64] |= 1ULL << (c[j] % 64);
+        row[cw + i / 64] |= 1ULL << (i % 64);
+    }
+    std::vector<uint8_t> pivot(nr, 0);
+    for (uint32_t c = 0; c < fb; c++) {
+        size_t w = c / 64, p = nr;
+        ull bit = 1ULL << (c % 64);
+        for (i = 0; i < nr; i++) {
+            if (!pivot[i] && (mat[i * width + w] & bit)) {
+                p = i;
+                break;
+            }
+        }
+        if (p == nr) continue;
+        pivot[p] = 1;
+        const ull *pr = &mat[p * width];
+        for (i = 0; i < nr; i++) {
+            if (i == p || !(mat[i * width + w] & bit)) continue;
+            ull *r = &mat[i * width];
+            for (j = w; j < width; j++) r[j] ^= pr[j];
+        }
+    }
+
+    /* Rows that were never pivots are now zero: their history is a dependency */
+    std::vector<uint32_t> expo(fb);
+    for (size_t d = 0; d < nr; d++) {
+        if (pivot[d]) continue;
+        const ull *hist = &mat[d * width + cw];
+        pg_bigint x, y, t, diff;
+        std::fill(expo.begin(), expo.end(), 0);
+        bigint_set_u32(&x, 1);
+        bigint_set_u32(&y, 1);
+        for (i = 0; i < nr; i++) {
+            if (!((hist[i / 64] >> (i % 64)) & 1)) continue;
+            const siqs_relation &r = rel[rows[i]];
+            pg_bigint_mod_mul(&x, &x, &r.y, job->n);
+            for (j = 0; j < r.factors.size(); j++) expo[r.factors[j]]++;
+            if (r.large != 1) {
+                pg_bigint_set_u64(&t, r.large);
+                pg_bigint_mod_mul(&y, &y, &t, job->n);
+            }
+        }
+        int odd = 0;
+        for (j = 0; j < fb; j++) odd |= expo[j] & 1;
+        if (odd) continue;
+        for (j = 1; j < fb; j++) {
+            pg_bigint p, e;
+            if (expo[j] == 0) continue;
+            pg_bigint_set_u64(&p, job->prime[j]);
+            pg_bigint_set_u64(&e, expo[j] / 2);
+            pg_bigint_mod_exp(&t, &p, &e, job->n);
+            pg_bigint_mod_mul(&y, &y, &t, job->n);
+        }
+        /* x^2 = y^2 (mod n): try x - y and x + y */
+        for (int sign = 0; sign < 2; sign++) {
+            if (sign == 0) bigint_mod_sub(&diff, &x, &y, job->n);
+            else bigint_mod_add(&diff, &x, &y, job->n);
+            pg_bigint_gcd_odd(factor, &diff, job->n);
+            if (!bigint_is_one(factor) && bigint_compare(factor, job->n) != 0) return 1;
+        }
+    }
+    return 0;
+}
+
+/* y^2 + c in Montgomery form */
+static uint64_t rho_step(uint64_t y, uint64_t c, const pg_mont64 *m) {
+    y = pg_mont_mul(y, y, m->n, m->ninv);
+    return y >= m->n - c ? y - (m->n - c) : y + c;
+}
+
+static uint64_t gcd_u64(uint64_t a, uint64_t b) {
+    while (b) {
+        uint64_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+/* Pollard's rho with Brent's cycle finding for n below 2^64; n odd and composite */
+static uint64_t rho_u64(uint64_t n) {
+    pg_mont64 m;
+    uint64_t c;
+    pg_mont_init(&m, n);
+    for (c = 1;; c++) {
+        uint64_t cm = pg_mont_to(&m, c);
+        uint64_t x = 0, y = m.one, ys = y, q = m.one, g = 1, r = 1, k, i;
+        while (g == 1) {
+            x = y;
+            for (i = 0; i < r; i++) y = rho_step(y, cm, &m);
+            /* gcds are batched over 128 steps */
+            for (k = 0; k < r && g == 1; k += 128) {
+                ys = y;
+                for (i = 0; i < 128 && i < r - k; i++) {
+                    y = rho_step(y, cm, &m);
+                    q = pg_mont_mul(q, x > y ? x - y : y - x, n, m.ninv);
+                }
+                g = gcd_u64(q, n);
+            }
+            r *= 2;
+        }
+        if (g == n) {
+            /* the batch overshot: step one at a time from its start */
+            do {
+                ys = rho_step(ys, cm, &m);
+                g = gcd_u64(x > ys ? x - ys : ys - x, n);
+            } while (g == 1);
+        }
+        if (g != n) return g;
+    }
+}
+
+int pg_siqs_big(pg_ctx *ctx, const pg_bigint *n, uint32_t threads, pg_siqs_result *result) {
+    pg_bigint small, rem;
+    uint32_t p;
+    int bits = pg_bigint_bit_length(n);
+    int status;
+
+    memset(result, 0, sizeof(*result));
+    if (bits > PG_SIQS_MAX_BITS) return PG_ERR_INVALID_ARG;
+    bigint_set_u32(&small, 4);
+    if (bigint_compare(n, &small) < 0) return 0;
+
+    /* easy cases first: small factors, primes, squares, word-sized n */
+    p = bigint_is_even(n) ? 2 : pg_small_prime_divisor_big(n);
+    bigint_set_u32(&small, p);
+    if (p != 0 && bigint_compare(n, &small) != 0) {
+        bigint_copy(&result->factor, &small);
+    } else if (p != 0 || pg_is_probable_prime_bpsw_big(ctx, n, 0)) {
+        return 0;
+    } else if (pg_bigint_isqrt(&result->factor, n)) {
+        /* n = r^2 */
+    } else if (bits <= 64) {
+        uint64_t v = (uint64_t)n->words[1] << 32 | n->words[0];
+        pg_bigint_set_u64(&result->factor, rho_u64(v));
+    } else {
+        siqs_job job;
+        job.seed = rng_next64(&ctx->rng);
+        job.n = n;
+        result->multiplier = choose_multiplier(n);
+        bigint_copy(&job.kn, n);
+        mul_u32(&job.kn, result->multiplier);
+        status = build_factor_base(&job);
+        if (status != PG_OK) return status;
+        job.stop = 0;
+        job.polys = 0;
+        job.cancel = ctx->cancel;
+        job.cancel_user = ctx->cancel_user;
+        job.cancelled = 0;
+
+        if (threads == 0) threads = pg_pool_size();
+        pg_pool_run(threads, siqs_worker_run, &job);
+        result->factor_base = job.fb_size;
+        result->relations = (uint32_t)job.full.size();
+        result->polynomials = job.polys.load();
+        if (job.cancelled) return PG_ERR_CANCELLED;
+        if (!linear_algebra(&job, &result->factor)) return 0;
+    }
+    pg_bigint_divmod_words(&result->cofactor, &rem, n->words, PG_BIGINT_WORDS, &result->factor);
+    return 1;
+}
@@ -0,0 +1,419 @@
+#include "pg_internal.h"
+
+/*
+ * 64-bit Miller-Rabin testing and prime generation
+ * - Exponentiation uses Montgomery multiplication with 128-bit products,
+ *   exact for every modulus below 2^64
+ * - Batch entry points interleave several exponentiations (see below)
+ * - pg_is_prime_u64 is exact: it evaluates a fixed set of 7 bases at once
+ */
+
+typedef unsigned long long ull;
+
+/* Number of significant bits of n */
+static int bit_length(ull n) {
+    int bits = 0;
+    while (n) {
+        bits++;
+        n >>= 1;
+    }
+    return bits;
+}
+
+/* Multiplication modulo without overflow: (a * b) % mod, 0 for mod 0 */
+uint64_t pg_mulmod_u64(uint64_t a, uint64_t b, uint64_t mod) {
+    if (mod == 0) return 0;
+#if defined(__SIZEOF_INT128__)
+    return (uint64_t)((unsigned __int128)a * b % mod);
+#else
+    ull res = 0;
+    a %= mod;
+    while (b) {
+        if (b & 1) res = res >= mod - a ? res - (mod - a) : res + a;
+        a = a >= mod - a ? a - (mod - a) : a + a;
+        b >>= 1;
+    }
+    return res;
+#endif
+}
+
+/* Montgomery exponentiation for odd mod: (base^exp) % mod */
+static ull powmod_mont(const pg_mont64 *m, ull base, ull exp) {
+    ull res = m->one;
+    ull b = pg_mont_to(m, base);
+    while (exp) {
+        if (exp & 1) res = pg_mont_mul(res, b, m->n, m->ninv);
+        b = pg_mont_mul(b, b, m->n, m->ninv);
+        exp >>= 1;
+    }
+    return res;
+}
+
+/* Modular exponentiation: (base^exp) % mod, 0 for mod 0 */
+uint64_t pg_powmod_u64(uint64_t base, uint64_t exp, uint64_t mod) {
+    if (mod == 0) return 0;
+    if (mod & 1) {
+        pg_mont64 m;
+        if (mod == 1) return 0;
+        pg_mont_init(&m, mod);
+        return pg_mont_from(&m, powmod_mont(&m, base, exp));
+    }
+    ull res = 1 % mod;
+    base %= mod;
+    while (exp) {
+        if (exp & 1) res = pg_mulmod_u64(res, base, mod);
+        base = pg_mulmod_u64(base, base, mod);
+        exp >>= 1;
+    }
+    return res;
+}
+
+/* Miller-Rabin witness test for base 'a'. Returns 1 if passes (likely prime for this base), 0 if composite.
+ * 0 and 1 are not probable primes, so they fail for every base; the batch and bases entry points
+ * send n < 5 here */
+int pg_mr_witness_u64(uint64_t n, uint64_t a) {
+    if (n < 2) return 0;
+    if (a % n == 0) return 1;
+    if ((n & 1) == 0) return n == 2;   /* Montgomery form needs an odd modulus */
+    ull d = n - 1;
+    int s = 0;
+    while ((d & 1) == 0) {
+        d >>= 1;
+        s++;
+    }
+    pg_mont64 m;
+    pg_mont_init(&m, n);
+    ull minus_one = n - m.one;   /* n - 1 in Montgomery form */
+    ull x = powmod_mont(&m, a, d);
+    if (x == m.one || x == minus_one) return 1;
+    for (int r = 1; r < s; ++r) {
+        x = pg_mont_mul(x, x, m.n, m.ninv);
+        if (x == minus_one) return 1;
+    }
+    return 0;
+}
+
+/*
+ * Interleaved kernels: PG_LANES independent exponentiations advance in
+ * lockstep, so their multiplies overlap in the pipeline instead of each
+ * waiting on the latency of the one before. Every lane squares on every
+ * step and the conditional multiply is a select, so there are no
+ * data-dependent branches; a group runs for its longest exponent.
+ */
+
+#define PG_LANES 8
+
+/* x[l] = base[l]^exp[l] in Montgomery form for a group of PG_LANES odd moduli */
+static void powmod_lanes(const pg_mont64 *m, const ull *base, const ull *exp, ull *x) {
+    ull res[PG_LANES], b[PG_LANES], e[PG_LANES];
+    ull emax = 0;
+    int l;
+    for (l = 0; l < PG_LANES; l++) {
+        res[l] = m[l].one;
+        b[l] = pg_mont_to(&m[l], base[l]);
+        e[l] = exp[l];
+        emax |= exp[l];
+    }
+    while (emax) {
+        for (l = 0; l < PG_LANES; l++) {
+            ull prod = pg_mont_mul(res[l], b[l], m[l].n, m[l].ninv);
+            res[l] = (e[l] & 1) ? prod : res[l];
+            b[l] = pg_mont_mul(b[l], b[l], m[l].n, m[l].ninv);
+            e[l] >>= 1;
+        }
+        emax >>= 1;
+    }
+    for (l = 0; l < PG_LANES; l++) x[l] = res[l];
+}
+
+void pg_powmod_batch_u64(const uint64_t *base, const uint64_t *exp, const uint64_t *mod, uint64_t *out,
+                         size_t count) {
+    pg_mont64 m[PG_LANES];
+    ull b[PG_LANES], e[PG_LANES], x[PG_LANES];
+    size_t idx[PG_LANES];
+    size_t i = 0;
+    int l, lanes;
+    while (i < count) {
+        /* gather up to PG_LANES odd moduli; even ones take the scalar path */
+        for (lanes = 0; lanes < PG_LANES && i < count; i++) {
+            if ((mod[i] & 1) == 0 || mod[i] == 1) {
+                out[i] = pg_powmod_u64(base[i], exp[i], mod[i]);
+                continue;
+            }
+            pg_mont_init(&m[lanes], mod[i]);
+            b[lanes] = base[i];
+            e[lanes] = exp[i];
+            idx[lanes++] = i;
+        }
+        if (lanes == 0) break;
+        /* pad the group with copies of lane 0 */
+        for (l = lanes; l < PG_LANES; l++) {
+            m[l] = m[0];
+            b[l] = b[0];
+            e[l] = 0;
+        }
+        powmod_lanes(m, b, e, x);
+        for (l = 0; l < lanes; l++) out[idx[l]] = pg_mont_from(&m[l], x[l]);
+    }
+}
+
+void pg_mr_witness_batch_u64(const uint64_t *n, const uint64_t *a, int *passed, size_t count) {
+    pg_mont64 m[PG_LANES];
+    ull b[PG_LANES], d[PG_LANES], x[PG_LANES];
+    int s[PG_LANES], pass[PG_LANES];
+    size_t idx[PG_LANES];
+    size_t i = 0;
+    int l, lanes, r, smax;
+    while (i < count) {
+        for (lanes = 0; lanes < PG_LANES && i < count; i++) {
+            if ((n[i] & 1) == 0 || n[i] < 5 || a[i] % n[i] == 0) {
+                passed[i] = pg_mr_witness_u64(n[i], a[i]);
+                continue;
+            }
+            pg_mont_init(&m[lanes], n[i]);
+            b[lanes] = a[i];
+            d[lanes] = n[i] - 1;
+            s[lanes] = 0;
+            while ((d[lanes] & 1) == 0) {
+                d[lanes] >>= 1;
+                s[lanes]++;
+            }
+            idx[lanes++] = i;
+        }
+        if (lanes == 0) break;
+        for (l = lanes; l < PG_LANES; l++) {
+            m[l] = m[0];
+            b[l] = b[0];
+            d[l] = 0;
+            s[l] = 0;
+        }
+        powmod_lanes(m, b, d, x);
+        smax = 0;
+        for (l = 0; l < PG_LANES; l++) {
+            pass[l] = x[l] == m[l].one || x[l] == m[l].n - m[l].one;
+            if (s[l] > smax) smax = s[l];
+        }
+        /* squaring phase, also in lockstep; a lane's result is frozen after s - 1 steps */
+        for (r = 1; r < smax; r++) {
+            for (l = 0; l < PG_LANES; l++) {
+                x[l] = pg_mont_mul(x[l], x[l], m[l].n, m[l].ninv);
+                pass[l] |= (r < s[l]) & (x[l] == m[l].n - m[l].one);
+            }
+        }
+        for (l = 0; l < lanes; l++) passed[idx[l]] = pass[l];
+    }
+}
+
+/* Small prime check: 1 if n is a small prime, 0 if it has a small factor, -1 if undecided */
+static int small_prime_check(ull n) {
+    int count = pg_trial_count_u64[bit_length(n)];
+    for (int i = 0; i < count; ++i) {
+        ull p = pg_small_primes[i];
+        if (p == n) return 1;
+        if (n % p == 0) return 0;
+    }
+    return -1;
+}
+
+/*
+ * Many bases of one modulus: the lanes share n's Montgomery constants and
+ * the exponent d, so the multiply-or-not decision is the same for every
+ * lane and only the bases differ. Evaluating the bases together costs
+ * about as much latency as a single base.
+ */
+
+/* pass[l] = strong probable-prime test of odd n > 4 to base a[l], for l < lanes <= PG_LANES */
+static void witness_lanes_shared(const pg_mont64 *m, ull d, int s, const uint64_t *a, int *pass, int lanes) {
+    ull res[PG_LANES], b[PG_LANES];
+    ull minus_one = m->n - m->one;
+    int l, r;
+    for (l = 0; l < lanes; l++) {
+        res[l] = m->one;
+        b[l] = pg_mont_to(m, a[l]);
+    }
+    while (d) {
+        if (d & 1) {
+            for (l = 0; l < lanes; l++) res[l] = pg_mont_mul(res[l], b[l], m->n, m->ninv);
+        }
+        for (l = 0; l < lanes; l++) b[l] = pg_mont_mul(b[l], b[l], m->n, m->ninv);
+        d >>= 1;
+    }
+    for (l = 0; l < lanes; l++) {
+        /* a base that is a multiple of n proves nothing and passes, as in pg_mr_witness_u64 */
+        pass[l] = res[l] == m->one || res[l] == minus_one || a[l] % m->n == 0;
+    }
+    for (r = 1; r < s; r++) {
+        for (l = 0; l < lanes; l++) {
+            res[l] = pg_mont_mul(res[l], res[l], m->n, m->ninv);
+            pass[l] |= res[l] == minus_one;
+        }
+    }
+}
+
+void pg_mr_witness_bases_u64(uint64_t n, const uint64_t *a, int *passed, size_t count) {
+    pg_mont64 m;
+    ull d = n - 1;
+    int s = 0;
+    if ((n & 1) == 0 || n < 5) {
+        for (size_t i = 0; i < count; i++) passed[i] = pg_mr_witness_u64(n, a[i]);
+        return;
+    }
+    while ((d & 1) == 0) {
+        d >>= 1;
+        s++;
+    }
+    pg_mont_init(&m, n);
+    for (size_t i = 0; i < count; i += PG_LANES) {
+        int lanes = count - i < PG_LANES ? (int)(count - i) : PG_LANES;
+        witness_lanes_shared(&m, d, s, a + i, passed + i, lanes);
+    }
+}
+
+/* Bases that make the strong probable-prime test exact below 2^64 (Jim Sinclair, 2011) */
+static const uint64_t deterministic_bases[7] = { 2, 325, 9375, 28178, 450775, 9780504, 1795265022 };
+
+int pg_is_prime_u64(uint64_t n) {
+    int passed[7];
+    if (n < 2) return 0;
+    int small = small_prime_check(n);
+    if (small >= 0) return small;
+    pg_mr_witness_bases_u64(n, deterministic_bases, passed, 7);
+    for (int i = 0; i < 7; ++i) {
+        if (!passed[i]) return 0;
+    }
+    return 1;
+}
+
+int pg_mr_rounds_u64(pg_ctx *ctx, uint64_t n, int rounds, uint64_t *bases, int *passed) {
+    if (n <= 3 || (n & 1) == 0 || rounds < 1) return PG_ERR_INVALID_ARG;
+    int all_pass = 1;
+    int bits = bit_length(n);
+    /* every round runs, so draw all the bases first and evaluate them together */
+    for (int start = 0; start < rounds; start += PG_LANES) {
+        uint64_t a[PG_LANES];
+        int pass[PG_LANES];
+        int lanes = rounds - start < PG_LANES ? rounds - start : PG_LANES;
+        for (int l = 0; l < lanes; ++l) {
+            a[l] = n > 4 ? 2 + rng_uniform(&ctx->rng, n - 3) : 2;
+            TRACE_MR_ROUND_START(bits, start + l);
+        }
+        ctx->stats.mr_rounds += lanes;
+        pg_mr_witness_bases_u64(n, a, pass, lanes);
+        for (int l = 0; l < lanes; ++l) {
+            TRACE_MR_ROUND_END(bits, start + l, pass[l]);
+            if (bases) bases[start + l] = a[l];
+            if (passed) passed[start + l] = pass[l];
+            if (!pass[l]) all_pass = 0;
+        }
+    }
+    return all_pass;
+}
+
+int pg_is_probable_prime_u64(pg_ctx *ctx, uint64_t n, int rounds) {
+    if (rounds < 1) return PG_ERR_INVALID_ARG;
+    if (n < 2) return 0;
+    int small = small_prime_check(n);
+    if (small >= 0) return small;
+    int bits = bit_length(n);
+    for (int i = 0; i < rounds; ++i) {
+        ull a = 2 + rng_uniform(&ctx->rng, n - 3);
+        ctx->stats.mr_rounds++;
+        TRACE_MR_ROUND_START(bits, i);
+        int pass = pg_mr_witness_u64(n, a);
+        TRACE_MR_ROUND_END(bits, i, pass);
+        if (!pass) return 0;
+    }
+    return 1;
+}
+
+int pg_is_probable_prime_batch_u64(pg_ctx *ctx, const uint64_t *n, int *result, size_t count, int rounds) {
+    enum { CHUNK = 256 };
+    uint64_t cand[CHUNK], base[CHUNK];
+    int passed[CHUNK];
+    size_t at[CHUNK];
+    if (rounds < 1) return PG_ERR_INVALID_ARG;
+    for (size_t start = 0; start < count; start += CHUNK) {
+        size_t end = count - start < CHUNK ? count : start + CHUNK;
+        size_t alive = 0;
+        /* trial division decides most numbers; the rest go to Miller-Rabin together */
+        for (size_t i = start; i < end; i++) {
+            int small = n[i] < 2 ? 0 : small_prime_check(n[i]);
+            result[i] = small;
+            if (small < 0) {
+                cand[alive] = n[i];
+                at[alive++] = i;
+            }
+        }
+        for (int r = 0; r < rounds && alive > 0; r++) {
+            size_t k, kept = 0;
+            for (k = 0; k < alive; k++) {
+                base[k] = 2 + rng_uniform(&ctx->rng, cand[k] - 3);
+            }
+            ctx->stats.mr_rounds += alive;
+            pg_mr_witness_batch_u64(cand, base, passed, alive);
+            /* drop the lanes a witness proved composite */
+            for (k = 0; k < alive; k++) {
+                if (passed[k]) {
+                    cand[kept] = cand[k];
+                    at[kept++] = at[k];
+                } else {
+                    result[at[k]] = 0;
+                }
+            }
+            alive = kept;
+        }
+        for (size_t k = 0; k < alive; k++) result[at[k]] = 1;
+    }
+    return PG_OK;
+}
+
+/* Generate a random odd number with given bit length (bits >= 2) */
+static ull gen_random_odd(prime_rng *rng, int bits) {
+    /* generate value in [2^(bits-1) .. 2^bits -1] and make it odd */
+    ull high = 1ULL << (bits - 1);
+    ull range = high; /* range = 2^bits - 2^(bits-1) */
+    ull r = rng_uniform(rng, range) + high;
+    r |= 1ULL; /* make odd */
+    return r;
+}
+
+/* Search random odd candidates until one passes the Miller-Rabin rounds */
+int pg_generate_prime_u64(pg_ctx *ctx, int bits, int rounds, uint64_t *out) {
+    if (bits < 2 || bits > 64 || rounds < 1) return PG_ERR_INVALID_ARG;
+    perf_stages *perf = ctx_perf(ctx);
+    int trial_count = pg_trial_count_u64[bits];
+    ull candidate;
+    ull attempts = 0;
+    ctx->stats.trial_bound = pg_small_primes[trial_count - 1];
+    ctx->stats.sieve_window = 0;
+    while (1) {
+        attempts++;
+        if (ctx_count_candidate(ctx)) {
+            perf_stage(perf, PERF_STAGE_OTHER);
+            return PG_ERR_CANCELLED;
+        }
+        perf_stage(perf, PERF_STAGE_CANDIDATE);
+        candidate = gen_random_odd(&ctx->rng, bits);
+        TRACE_CANDIDATE_DRAWN(bits, candidate);
+        perf_stage(perf, PERF_STAGE_SIEVE);
+        unsigned int divisible = 0;
+        for (int i = 0; i < trial_count; ++i) {
+            unsigned int p = pg_small_primes[i];
+            if ((ull)p == candidate) { divisible = 0; break; }
+            if (candidate % p == 0) { divisible = p; break; }
+        }
+        if (divisible) {
+            TRACE_SIEVE_REJECTED(bits, divisible);
+            ctx->stats.sieve_rejects++;
+            continue;
+        }
+        perf_stage(perf, PERF_STAGE_MR);
+        if (pg_is_probable_prime_u64(ctx, candidate, rounds)) break;
+        ctx->stats.mr_rejects++;
+    }
+    perf_stage(perf, PERF_STAGE_OTHER);
+    TRACE_PRIME_FOUND(bits, attempts);
+    ctx->stats.primes++;
+    *out = candidate;
+    return PG_OK;
+}
@@ -0,0 +1,147 @@
+#ifndef PRIME_PERF_H
+#define PRIME_PERF_H
+
+#include <string.h>
+#include "primegen.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/*
+ * Per-stage hardware performance counters (Linux perf_event_open)
+ * - One counter group (cycles, instructions, branch misses, L1D read
+ *   misses, LLC misses) is opened for the calling thread, user space only
+ * - The generator calls perf_stage() when it moves between pipeline
+ *   stages; the counter delta since the previous switch is charged to the
+ *   stage that was running, so each stage accumulates its own totals
+ * - Events the CPU or kernel refuses are left out; on other platforms, or
+ *   when perf_event_open is not permitted, perf_open() returns 0 and
+ *   every call is a no-op
+ * - A pointer to perf_stages may be NULL everywhere to disable it
+ * - Stage and event indices are the PG_PERF_* constants of primegen.h
+ */
+
+#define PERF_STAGE_OTHER     PG_PERF_STAGE_OTHER
+#define PERF_STAGE_CANDIDATE PG_PERF_STAGE_CANDIDATE
+#define PERF_STAGE_SIEVE     PG_PERF_STAGE_SIEVE
+#define PERF_STAGE_MR        PG_PERF_STAGE_MR
+#define PERF_STAGES          PG_PERF_STAGES
+#define PERF_EVENTS          PG_PERF_EVENTS
+
+typedef struct {
+    int fd[PERF_EVENTS];          /* -1 for events that could not be opened */
+    int slot[PERF_EVENTS];        /* position of each event in a group read */
+    int nopen;                    /* events in the group */
+    int leader;                   /* group leader fd, -1 if unavailable */
+    int stage;                    /* stage currently being charged */
+    unsigned long long last[PERF_EVENTS];
+    unsigned long long totals[PERF_STAGES][PERF_EVENTS];
+    unsigned long long switches[PERF_STAGES];
+} perf_stages;
+
+#ifdef __linux__
+static inline int perf_open_event(unsigned int type, unsigned long long config, int group_fd) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = group_fd == -1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+
+/* Read the whole group into p->last (raw running totals) */
+static inline int perf_read_group(perf_stages *p, unsigned long long now[PERF_EVENTS]) {
+    unsigned long long buf[1 + PERF_EVENTS];
+    int e;
+    if (read(p->leader, buf, sizeof(buf)) < (ssize_t)(sizeof(unsigned long long) * (1 + p->nopen))) return 0;
+    for (e = 0; e < PERF_EVENTS; e++) {
+        now[e] = p->fd[e] >= 0 ? buf[1 + p->slot[e]] : 0;
+    }
+    return 1;
+}
+#endif
+
+/* Open the counter group; returns the number of events available (0 if none) */
+static inline int perf_open(perf_stages *p) {
+    memset(p, 0, sizeof(*p));
+    p->leader = -1;
+    for (int e = 0; e < PERF_EVENTS; e++) p->fd[e] = -1;
+#ifdef __linux__
+    static const unsigned int types[PERF_EVENTS] = {
+        PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE
+    };
+    static const unsigned long long configs[PERF_EVENTS] = {
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_BRANCH_MISSES,
+        PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+        PERF_COUNT_HW_CACHE_MISSES
+    };
+    for (int e = 0; e < PERF_EVENTS; e++) {
+        int fd = perf_open_event(types[e], configs[e], p->leader);
+        if (fd < 0) continue;
+        if (p->leader < 0) p->leader = fd;
+        p->fd[e] = fd;
+        p->slot[e] = p->nopen++;
+    }
+    if (p->leader < 0) return 0;
+    ioctl(p->leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(p->leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    perf_read_group(p, p->last);
+#endif
+    return p->nopen;
+}
+
+/* Charge the counts since the last read to the running stage */
+static inline void perf_charge(perf_stages *p) {
+    if (p == NULL || p->leader < 0) return;
+#ifdef __linux__
+    unsigned long long now[PERF_EVENTS];
+    if (perf_read_group(p, now)) {
+        for (int e = 0; e < PERF_EVENTS; e++) {
+            p->totals[p->stage][e] += now[e] - p->last[e];
+            p->last[e] = now[e];
+        }
+    }
+#endif
+}
+
+/* Charge the counts since the last switch to the running stage, then run 'stage' */
+static inline void perf_stage(perf_stages *p, int stage) {
+    if (p == NULL || p->leader < 0) return;
+    perf_charge(p);
+    p->switches[stage]++;
+    p->stage = stage;
+}
+
+static inline void perf_close(perf_stages *p) {
+    perf_stage(p, PERF_STAGE_OTHER);
+#ifdef __linux__
+    for (int e = 0; e < PERF_EVENTS; e++) {
+        if (p->fd[e] >= 0) close(p->fd[e]);
+    }
+#endif
+    p->leader = -1;
+}
+
+/* Copy the accumulated totals into the public report layout */
+static inline void perf_report(const perf_stages *p, pg_perf_report *out) {
+    memset(out, 0, sizeof(*out));
+    for (int e = 0; e < PERF_EVENTS; e++) {
+        if (p->fd[e] >= 0) out->event_mask |= 1U << e;
+    }
+    for (int s = 0; s < PERF_STAGES; s++) {
+        out->entries[s] = p->switches[s];
+        for (int e = 0; e < PERF_EVENTS; e++) out->counts[s][e] = p->totals[s][e];
+    }
+}
+
+#endif
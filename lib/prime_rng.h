@@ -0,0 +1,117 @@
+#ifndef PRIME_RNG_H
+#define PRIME_RNG_H
+
+#include <stdlib.h>
+#include <time.h>
+
+/*
+ * Counter-based random number generator (Philox4x32-10)
+ * - Output block i of stream s is philox(key = seed, counter = (i, s)),
+ *   so every stream is independent and needs no shared state
+ * - A run is fully determined by its master seed; each worker, shard or
+ *   batch derives its own stream from (seed, stream index)
+ * - Header-only; the library keeps one generator per pg_ctx
+ */
+
+#define PHILOX_M0 0xD2511F53U
+#define PHILOX_M1 0xCD9E8D57U
+#define PHILOX_W0 0x9E3779B9U
+#define PHILOX_W1 0xBB67AE85U
+#define PHILOX_ROUNDS 10
+
+typedef struct {
+    unsigned int key[2];         /* master seed */
+    unsigned long long stream;   /* stream index (high half of counter) */
+    unsigned long long block;    /* block index (low half of counter) */
+    unsigned int buf[4];         /* current output block */
+    int used;                    /* words of buf already consumed */
+} prime_rng;
+
+/* Philox4x32 bijection: out = philox(ctr, key) */
+static inline void philox4x32(unsigned int out[4], const unsigned int ctr[4], const unsigned int key[2]) {
+    unsigned int c0 = ctr[0], c1 = ctr[1], c2 = ctr[2], c3 = ctr[3];
+    unsigned int k0 = key[0], k1 = key[1];
+    int i;
+    for (i = 0; i < PHILOX_ROUNDS; i++) {
+        unsigned long long p0 = (unsigned long long)PHILOX_M0 * c0;
+        unsigned long long p1 = (unsigned long long)PHILOX_M1 * c2;
+        unsigned int n0 = (unsigned int)(p1 >> 32) ^ c1 ^ k0;
+        unsigned int n2 = (unsigned int)(p0 >> 32) ^ c3 ^ k1;
+        c1 = (unsigned int)p1;
+        c3 = (unsigned int)p0;
+        c0 = n0;
+        c2 = n2;
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+    out[0] = c0; out[1] = c1; out[2] = c2; out[3] = c3;
+}
+
+/* Initialize stream 'stream' of master seed 'seed' at block 0 */
+static inline void rng_init(prime_rng *r, unsigned long long seed, unsigned long long stream) {
+    r->key[0] = (unsigned int)seed;
+    r->key[1] = (unsigned int)(seed >> 32);
+    r->stream = stream;
+    r->block = 0;
+    r->used = 4;
+}
+
+/* Next 32 random bits of the stream */
+static inline unsigned int rng_next32(prime_rng *r) {
+    if (r->used == 4) {
+        unsigned int ctr[4];
+        ctr[0] = (unsigned int)r->block;
+        ctr[1] = (unsigned int)(r->block >> 32);
+        ctr[2] = (unsigned int)r->stream;
+        ctr[3] = (unsigned int)(r->stream >> 32);
+        philox4x32(r->buf, ctr, r->key);
+        r->block++;
+        r->used = 0;
+    }
+    return r->buf[r->used++];
+}
+
+/* Next 64 random bits of the stream */
+static inline unsigned long long rng_next64(prime_rng *r) {
+    unsigned long long hi = rng_next32(r);
+    return (hi << 32) | rng_next32(r);
+}
+
+/* Uniform value in [0, max) without modulo bias; returns 0 if max == 0 */
+static inline unsigned long long rng_uniform(prime_rng *r, unsigned long long max) {
+    if (max == 0) return 0;
+    /* reject the top partial interval: 2^64 mod max values */
+    unsigned long long limit = (0ULL - max) % max;
+    unsigned long long x;
+    do {
+        x = rng_next64(r);
+    } while (x < limit);
+    return x % max;
+}
+
+/* splitmix64 finalizer */
+static inline unsigned long long rng_mix64(unsigned long long z) {
+    z += 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/* Substream 'tag' of r's current position: same master seed, stream index
+ * hashed from r's stream, position and tag. Drawing from it leaves r where it
+ * was, so work whose draw count varies (Miller-Rabin bases for candidates a
+ * tuned sieve lets through) cannot shift r's later draws */
+static inline void rng_substream(prime_rng *sub, const prime_rng *r, unsigned long long tag) {
+    unsigned long long h = rng_mix64(r->stream);
+    h = rng_mix64(h ^ (r->block * 4 + (unsigned long long)r->used));   /* words drawn, plus 4 */
+    rng_init(sub, (unsigned long long)r->key[1] << 32 | r->key[0], rng_mix64(h ^ tag));
+}
+
+/* Default master seed when --seed is not given: mixes wall-clock time and
+ * the address of a stack object (splitmix64 finalizer) */
+static inline unsigned long long rng_default_seed(void) {
+    int local = 0;
+    return rng_mix64((unsigned long long)time(NULL) ^ ((unsigned long long)(size_t)&local << 16));
+}
+
+#endif
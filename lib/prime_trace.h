@@ -0,0 +1,54 @@
+#ifndef PRIME_TRACE_H
+#define PRIME_TRACE_H
+
+/*
+ * USDT static tracepoints (provider "primegen")
+ * - Built on <sys/sdt.h> (systemtap-sdt-dev) when it is available; each
+ *   probe is a single nop plus an ELF note until a tracer attaches, and
+ *   compiles away entirely without the header or with -DPRIME_NO_USDT
+ * - Arguments are plain integers so evaluating them costs nothing
+ *
+ * Probes and arguments:
+ *   candidate_drawn(bits, low64)          random odd candidate generated;
+ *                                         low64 = its low 64 bits
+ *   sieve_rejected(bits, p)               candidate divisible by small prime p
+ *   mr_round_start(bits, round)           Miller-Rabin round 'round' (0-based) begins
+ *   mr_round_end(bits, round, passed)     round finished; passed = 1 (probably
+ *                                         prime) or 0 (composite)
+ *   prime_found(bits, attempts)           probable prime accepted after
+ *                                         'attempts' candidates
+ *   batch_start(batch, count)             benchmark batch of 'count' primes begins
+ *   batch_end(batch, primes, candidates)  batch finished
+ *
+ * Example:
+ *   bpftrace -e 'usdt:./prime1024:primegen:mr_round_start { @s[tid] = nsecs; }
+ *                usdt:./prime1024:primegen:mr_round_end /@s[tid]/ {
+ *                    @ns = hist(nsecs - @s[tid]); delete(@s[tid]); }' -p PID
+ */
+
+#if !defined(PRIME_NO_USDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define PRIME_HAVE_USDT 1
+#endif
+#endif
+
+#ifdef PRIME_HAVE_USDT
+#define TRACE_CANDIDATE_DRAWN(bits, low64)       DTRACE_PROBE2(primegen, candidate_drawn, bits, low64)
+#define TRACE_SIEVE_REJECTED(bits, p)            DTRACE_PROBE2(primegen, sieve_rejected, bits, p)
+#define TRACE_MR_ROUND_START(bits, round)        DTRACE_PROBE2(primegen, mr_round_start, bits, round)
+#define TRACE_MR_ROUND_END(bits, round, passed)  DTRACE_PROBE3(primegen, mr_round_end, bits, round, passed)
+#define TRACE_PRIME_FOUND(bits, attempts)        DTRACE_PROBE2(primegen, prime_found, bits, attempts)
+#define TRACE_BATCH_START(batch, count)          DTRACE_PROBE2(primegen, batch_start, batch, count)
+#define TRACE_BATCH_END(batch, primes, cands)    DTRACE_PROBE3(primegen, batch_end, batch, primes, cands)
+#else
+#define TRACE_CANDIDATE_DRAWN(bits, low64)       do { (void)(bits); (void)(low64); } while (0)
+#define TRACE_SIEVE_REJECTED(bits, p)            do { (void)(bits); (void)(p); } while (0)
+#define TRACE_MR_ROUND_START(bits, round)        do { (void)(bits); (void)(round); } while (0)
+#define TRACE_MR_ROUND_END(bits, round, passed)  do { (void)(bits); (void)(round); (void)(passed); } while (0)
+#define TRACE_PRIME_FOUND(bits, attempts)        do { (void)(bits); (void)(attempts); } while (0)
+#define TRACE_BATCH_START(batch, count)          do { (void)(batch); (void)(count); } while (0)
+#define TRACE_BATCH_END(batch, primes, cands)    do { (void)(batch); (void)(primes); (void)(cands); } while (0)
+#endif
+
+#endif
@@ -0,0 +1,354 @@
+#ifndef PRIMEGEN_H
+#define PRIMEGEN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * primegen: Miller-Rabin primality testing and prime generation (C ABI)
+ * - All mutable state lives in an explicit pg_ctx: RNG stream, counters,
+ *   progress callback and perf instrumentation. A context may be used by
+ *   one thread at a time; give every thread its own context (and stream)
+ * - Nothing is printed; results are written to caller-supplied buffers
+ * - Functions returning int return PG_OK (0) or a negative PG_ERR_* code
+ *   unless documented otherwise
+ * - Big integers are fixed 1024-bit values stored as little-endian
+ *   arrays of 32-bit words. The output of a pg_bigint_* function may be
+ *   one of its inputs (except the wide product of pg_bigint_mul)
+ * - Structs in this header only grow at the end, and only together with
+ *   a PG_API_VERSION bump
+ */
+
+#define PG_API_VERSION 17
+
+#if defined(_WIN32) && defined(PG_SHARED)
+#ifdef PG_BUILD
+#define PG_API __declspec(dllexport)
+#else
+#define PG_API __declspec(dllimport)
+#endif
+#elif defined(__GNUC__)
+#define PG_API __attribute__((visibility("default")))
+#else
+#define PG_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Status codes */
+#define PG_OK                   0
+#define PG_ERR_INVALID_ARG     -1
+#define PG_ERR_NOMEM           -2
+#define PG_ERR_BUFFER_TOO_SMALL -3
+#define PG_ERR_PARSE           -4
+#define PG_ERR_OVERFLOW        -5
+#define PG_ERR_CANCELLED       -6
+#define PG_ERR_IO              -7   /* file missing, unwritable or malformed (since API version 13) */
+
+#define PG_DEFAULT_ROUNDS 10
+
+/* Big integers */
+#define PG_BIGINT_BITS  1024
+#define PG_BIGINT_WORDS 32
+
+typedef struct {
+    uint32_t words[PG_BIGINT_WORDS];
+} pg_bigint;
+
+/* Double-width product of two pg_bigint values */
+typedef struct {
+    uint32_t words[PG_BIGINT_WORDS * 2];
+} pg_bigint_wide;
+
+/* Generation counters, accumulated per context */
+typedef struct {
+    uint64_t candidates;     /* random odd candidates drawn */
+    uint64_t sieve_rejects;  /* rejected by small-prime trial division */
+    uint64_t mr_rejects;     /* rejected by Miller-Rabin */
+    uint64_t mr_rounds;      /* Miller-Rabin rounds run */
+    uint64_t primes;         /* primes found */
+    /* Chosen by the last generation (since API version 4) */
+    uint32_t trial_bound;    /* largest small prime candidates were divided by */
+    uint32_t sieve_window;   /* odd positions per sieve window; 0 for 64-bit generation */
+} pg_stats;
+
+/* Hardware counters per generation stage (see pg_ctx_enable_perf) */
+#define PG_PERF_STAGE_OTHER     0   /* outside the generation loop */
+#define PG_PERF_STAGE_CANDIDATE 1   /* drawing a random candidate */
+#define PG_PERF_STAGE_SIEVE     2   /* small-prime trial division */
+#define PG_PERF_STAGE_MR        3   /* Miller-Rabin rounds */
+#define PG_PERF_STAGES          4
+
+#define PG_PERF_EV_CYCLES        0
+#define PG_PERF_EV_INSTRUCTIONS  1
+#define PG_PERF_EV_BRANCH_MISSES 2
+#define PG_PERF_EV_L1D_MISSES    3
+#define PG_PERF_EV_LLC_MISSES    4
+#define PG_PERF_EVENTS           5
+
+typedef struct {
+    uint32_t event_mask;                              /* bit e set if event e was counted */
+    uint64_t entries[PG_PERF_STAGES];                 /* times each stage was entered */
+    uint64_t counts[PG_PERF_STAGES][PG_PERF_EVENTS];
+} pg_perf_report;
+
+typedef struct pg_ctx pg_ctx;
+
+/* Called every 'every' candidates during generation with the context's counters */
+typedef void (*pg_progress_fn)(void *user, const pg_stats *stats);
+
+/* Polled before every candidate; a nonzero return stops generation with PG_ERR_CANCELLED */
+typedef int (*pg_cancel_fn)(void *user);
+
+/* Library information */
+PG_API int pg_api_version(void);
+PG_API const char *pg_strerror(int status);
+/* The worker pool behind every threads == 0 default (since API version 15): one thread pinned to
+ * each CPU the process may use, grouped into NUMA nodes. Starts the pool if it is not running. */
+PG_API void pg_pool_topology(uint32_t *workers, uint32_t *nodes);
+/* A seed mixed from the clock and the address space; for callers with no seed of their own */
+PG_API uint64_t pg_default_seed(void);
+
+/* Contexts. Each draws from stream 'stream' of master seed 'seed', so runs
+ * replay exactly and independent streams need no shared state. */
+PG_API pg_ctx *pg_ctx_create(uint64_t seed, uint64_t stream);   /* NULL if out of memory */
+PG_API void pg_ctx_destroy(pg_ctx *ctx);
+PG_API void pg_ctx_set_stream(pg_ctx *ctx, uint64_t seed, uint64_t stream);
+PG_API void pg_ctx_get_stats(const pg_ctx *ctx, pg_stats *out);
+PG_API void pg_ctx_reset_stats(pg_ctx *ctx);
+PG_API void pg_ctx_set_progress(pg_ctx *ctx, pg_progress_fn fn, void *user, uint64_t every);
+/* fn may be NULL to remove the hook; it runs on the thread using the context (since API version 2) */
+PG_API void pg_ctx_set_cancel(pg_ctx *ctx, pg_cancel_fn fn, void *user);
+/* Open per-stage hardware counters (Linux perf_event_open) for the calling
+ * thread; returns the number of events available, 0 if none */
+PG_API int pg_ctx_enable_perf(pg_ctx *ctx);
+PG_API void pg_ctx_get_perf(pg_ctx *ctx, pg_perf_report *out);
+
+/* 64-bit arithmetic and testing; every n and mod is accepted */
+/* (a * b) % mod and (base^exp) % mod; 0 for mod 0 */
+PG_API uint64_t pg_mulmod_u64(uint64_t a, uint64_t b, uint64_t mod);
+PG_API uint64_t pg_powmod_u64(uint64_t base, uint64_t exp, uint64_t mod);
+/* 1 if n passes the strong probable-prime test to base a, 0 if a witnesses n composite;
+ * 0 for n < 2. A base that is a multiple of n > 1 proves nothing and passes */
+PG_API int pg_mr_witness_u64(uint64_t n, uint64_t a);
+/* Smallest prime up to the trial-division bound for n's bit length dividing n, 0 if none */
+PG_API uint32_t pg_small_prime_divisor_u64(uint64_t n);
+/* 1 if n is a probable prime after 'rounds' random bases, 0 if composite */
+PG_API int pg_is_probable_prime_u64(pg_ctx *ctx, uint64_t n, int rounds);
+/* Run all 'rounds' random-base rounds without stopping at the first witness.
+ * bases[i] / passed[i] (either may be NULL) receive each base and its result.
+ * Returns 1 if every round passed, 0 otherwise. n must be odd and > 3. */
+PG_API int pg_mr_rounds_u64(pg_ctx *ctx, uint64_t n, int rounds, uint64_t *bases, int *passed);
+/* Random probable prime of exactly 'bits' bits, 2 <= bits <= 64 */
+PG_API int pg_generate_prime_u64(pg_ctx *ctx, int bits, int rounds, uint64_t *out);
+
+/* Batch kernels (since API version 5). Independent exponentiations are
+ * interleaved so their multiplies overlap; throughput is several times
+ * that of calling the scalar functions in a loop. */
+/* out[i] = base[i]^exp[i] mod mod[i], 0 where mod[i] is 0 */
+PG_API void pg_powmod_batch_u64(const uint64_t *base, const uint64_t *exp, const uint64_t *mod, uint64_t *out,
+                                size_t count);
+/* passed[i] = pg_mr_witness_u64(n[i], a[i]), so 0 where n[i] < 2; pass the same n several times to
+ * test several bases of it */
+PG_API void pg_mr_witness_batch_u64(const uint64_t *n, const uint64_t *a, int *passed, size_t count);
+/* result[i] = pg_is_probable_prime_u64(ctx, n[i], rounds), with the rounds of all numbers interleaved
+ * (bases are drawn in a different order, so individual results may differ from the scalar call
+ * only for numbers that are composite but pass some rounds) */
+PG_API int pg_is_probable_prime_batch_u64(pg_ctx *ctx, const uint64_t *n, int *result, size_t count, int rounds);
+/* passed[i] = pg_mr_witness_u64(n, a[i]) for many bases of one n (all 0 for n < 2), evaluated
+ * together so the latency is close to that of one base (since API version 6) */
+PG_API void pg_mr_witness_bases_u64(uint64_t n, const uint64_t *a, int *passed, size_t count);
+/* Deterministic test, exact for every n < 2^64: 1 if n is prime, 0 if not. Evaluates a fixed
+ * set of 7 bases with pg_mr_witness_bases_u64 (since API version 6) */
+PG_API int pg_is_prime_u64(uint64_t n);
+
+/* Range sieve (since API version 12). fn receives each prime of the range in increasing order */
+typedef void (*pg_prime_fn)(void *user, uint64_t p);
+
+#define PG_RANGE_BUCKET 0   /* large sieving primes wait in per-segment buckets: fast anywhere */
+#define PG_RANGE_PLAIN  1   /* every sieving prime visits every segment: slow and memory-hungry near 2^64 */
+
+/* All primes lo <= p <= hi by a segmented sieve; fn may be NULL to only count them into *count
+ * (which may also be NULL). The cancel hook of ctx (may be NULL) is polled once per segment of
+ * 2^21 numbers. */
+PG_API int pg_sieve_range_u64(pg_ctx *ctx, uint64_t lo, uint64_t hi, int mode, pg_prime_fn fn, void *user,
+                              uint64_t *count);
+
+/* Factorizations of whole ranges (since API version 14) */
+#define PG_FACTOR_MAX 15    /* distinct prime factors of a number below 2^64 */
+
+typedef struct {
+    uint64_t prime;
+    uint32_t exponent;
+} pg_factor;
+
+/* Receives n with its prime factors in increasing order; count is 0 for n = 0 and n = 1 */
+typedef void (*pg_factor_fn)(void *user, uint64_t n, const pg_factor *factors, int count);
+
+/* Factors every lo <= n <= hi with a segmented sieve by the primes up to sqrt(hi). threads == 0
+ * uses one per pool worker; each takes a contiguous part of the range and calls fn for its
+ * numbers in increasing order, so with several threads fn is called concurrently and the parts
+ * interleave. The cancel hook of ctx (may be NULL) is polled from the workers once per 2^15
+ * numbers. */
+PG_API int pg_factor_range_u64(pg_ctx *ctx, uint64_t lo, uint64_t hi, uint32_t threads, pg_factor_fn fn, void *user);
+
+/* Prime bitmap files with a rank/select index (since API version 13). An open index is read-only
+ * and may be queried from any number of threads. */
+typedef struct pg_prime_index pg_prime_index;
+
+/* Sieves the numbers below limit, 3 <= limit <= 2^32, into a bitmap file at path with its index
+ * (a little over limit / 16 bytes); ctx (may be NULL) is polled for cancellation */
+PG_API int pg_prime_index_build(pg_ctx *ctx, const char *path, uint64_t limit);
+/* Memory-maps a file written by pg_prime_index_build */
+PG_API int pg_prime_index_open(const char *path, pg_prime_index **out);
+PG_API void pg_prime_index_close(pg_prime_index *idx);
+/* Numbers below this are covered; queries above it return PG_ERR_OVERFLOW */
+PG_API uint64_t pg_prime_index_limit(const pg_prime_index *idx);
+PG_API int pg_prime_index_is_prime(const pg_prime_index *idx, uint64_t n, int *prime);
+/* Number of primes p <= x, in constant time */
+PG_API int pg_prime_pi(const pg_prime_index *idx, uint64_t x, uint64_t *count);
+/* The k-th prime, k >= 1 (the first is 2) */
+PG_API int pg_nth_prime(const pg_prime_index *idx, uint64_t k, uint64_t *p);
+
+/* Trial-division depth. Candidates are divided by every prime up to a bound
+ * chosen per bit length from a cost model (since API version 3). */
+PG_API uint32_t pg_trial_bound_u64(int bits);   /* 0 <= bits <= 64 */
+PG_API uint32_t pg_trial_bound_big(int bits);   /* 0 <= bits <= 1024 */
+/* Fraction of random odd numbers with no odd prime factor <= bound */
+PG_API double pg_trial_survival(uint32_t bound);
+
+/* Big-integer arithmetic. Outputs may alias inputs. */
+PG_API void pg_bigint_set_u64(pg_bigint *a, uint64_t v);
+PG_API int pg_bigint_cmp(const pg_bigint *a, const pg_bigint *b);      /* -1, 0 or 1 */
+PG_API int pg_bigint_bit_length(const pg_bigint *a);
+PG_API int pg_bigint_from_hex(pg_bigint *a, const char *hex);          /* optional 0x prefix */
+/* Hex with a 0x prefix, otherwise decimal, of any length; PG_ERR_OVERFLOW above 1024 bits (since API version 16) */
+PG_API int pg_bigint_from_text(pg_bigint *a, const char *text);
+PG_API int pg_bigint_to_hex(const pg_bigint *a, char *buf, size_t size);  /* lowercase, no prefix */
+PG_API uint32_t pg_bigint_add(pg_bigint *c, const pg_bigint *a, const pg_bigint *b);  /* returns carry */
+PG_API void pg_bigint_sub(pg_bigint *c, const pg_bigint *a, const pg_bigint *b);      /* mod 2^1024 */
+PG_API void pg_bigint_mul(pg_bigint_wide *c, const pg_bigint *a, const pg_bigint *b);
+/* r = num mod n for a num of 'num_words' words (at most 2 * PG_BIGINT_WORDS), n != 0 */
+PG_API void pg_bigint_mod_words(pg_bigint *r, const uint32_t *num, int num_words, const pg_bigint *n);
+PG_API void pg_bigint_mod_mul(pg_bigint *c, const pg_bigint *a, const pg_bigint *b, const pg_bigint *n);
+PG_API void pg_bigint_mod_exp(pg_bigint *c, const pg_bigint *base, const pg_bigint *exp, const pg_bigint *mod);
+/* Same result as pg_bigint_mod_exp, computed in a residue number system with RNS Montgomery
+ * multiplication (experimental, since API version 7). Falls back to pg_bigint_mod_exp for even
+ * moduli and the rare odd ones sharing a factor with the RNS bases (primes just below 2^28). */
+PG_API void pg_bigint_mod_exp_rns(pg_bigint *c, const pg_bigint *base, const pg_bigint *exp, const pg_bigint *mod);
+PG_API uint32_t pg_bigint_mod_u32(const pg_bigint *a, uint32_t p);
+/* Uniform random value of exactly 'bits' bits (top bit set), 1 <= bits <= 1024 */
+PG_API int pg_bigint_random(pg_ctx *ctx, pg_bigint *a, int bits);
+
+/* Big-integer testing and generation */
+PG_API int pg_mr_witness_big(const pg_bigint *n, const pg_bigint *a);
+/* Smallest prime up to the trial-division bound for n's bit length dividing n, 0 if none */
+PG_API uint32_t pg_small_prime_divisor_big(const pg_bigint *n);
+PG_API int pg_is_probable_prime_big(pg_ctx *ctx, const pg_bigint *n, int rounds);
+/* Strong Lucas probable-prime test with Selfridge's parameters (P = 1, Q = (1 - D) / 4 for the first
+ * D of 5, -7, 9, -11, ... with Jacobi symbol (D/n) = -1). 1 if n passes, 0 if composite (since API version 8) */
+PG_API int pg_strong_lucas_big(const pg_bigint *n);
+/* Baillie-PSW: trial division, the strong base-2 test and pg_strong_lucas_big, about three
+ * exponentiations in all and no known counterexample; then 'rounds' >= 0 random-base rounds
+ * (since API version 8) */
+PG_API int pg_is_probable_prime_bpsw_big(pg_ctx *ctx, const pg_bigint *n, int rounds);
+/* Width dispatch (since API version 16): n is tested on the narrowest engine that holds it and
+ * that engine's PG_WIDTH_* goes to *width (may be NULL). Exact below 2^64 ('rounds' unused);
+ * above, Baillie-PSW plus 'rounds' >= 0 random bases, as pg_is_probable_prime_bpsw_big */
+#define PG_WIDTH_32  32     /* 32-bit Montgomery, bases 2, 7, 61 */
+#define PG_WIDTH_64  64     /* pg_is_prime_u64 */
+#define PG_WIDTH_128 128    /* 128-bit Montgomery Baillie-PSW */
+#define PG_WIDTH_BIG PG_BIGINT_BITS
+PG_API int pg_is_prime_auto(pg_ctx *ctx, const pg_bigint *n, int rounds, int *width);
+/* Batches of big integers (since API version 17): up to 'capacity' numbers of at most 'bits' bits
+ * in one arena allocated at create time, stored word-major so the same word of every number is
+ * contiguous. pg_big_batch_add returns the number's index, PG_ERR_OVERFLOW if it is wider than
+ * 'bits' or PG_ERR_BUFFER_TOO_SMALL when the batch is full; reset empties the batch in O(1).
+ * pg_big_batch_test gives the numbers the test of pg_is_prime_auto with the base-2 exponentiation
+ * run on eight numbers at once, writes 1 (probable prime) or 0 per number to the results array
+ * and returns how many probable primes there were. */
+typedef struct pg_big_batch pg_big_batch;
+PG_API int pg_big_batch_create(uint32_t capacity, int bits, pg_big_batch **out);
+PG_API void pg_big_batch_destroy(pg_big_batch *batch);
+PG_API void pg_big_batch_reset(pg_big_batch *batch);
+PG_API uint32_t pg_big_batch_size(const pg_big_batch *batch);
+PG_API int pg_big_batch_add(pg_big_batch *batch, const pg_bigint *n);
+PG_API int pg_big_batch_get(const pg_big_batch *batch, uint32_t index, pg_bigint *n);
+PG_API int pg_big_batch_test(pg_ctx *ctx, pg_big_batch *batch, int rounds);
+/* One entry per number, valid after pg_big_batch_test until the batch changes */
+PG_API const uint8_t *pg_big_batch_results(const pg_big_batch *batch);
+/* Elliptic curve factoring (since API version 9) */
+#define PG_ECM_MAX_B2 (1ULL << 32)
+
+typedef struct {
+    uint32_t b1;        /* stage 1 bound; 11000 suits factors up to ~20 digits, 50000 ~25 */
+    uint64_t b2;        /* stage 2 bound, at most PG_ECM_MAX_B2; 0 for 100 * b1, <= b1 for stage 1 only */
+    uint32_t curves;    /* curves to try before giving up */
+    uint32_t threads;   /* curves run in parallel; 0 for one per pool worker */
+} pg_ecm_params;
+
+typedef struct {
+    pg_bigint factor;   /* a factor 1 < f < n when one was found */
+    int stage;          /* where it was found: 0 trial division, 1 or 2 the ECM stage */
+    uint32_t sigma;     /* Suyama parameter of the curve that found it */
+    uint32_t curves;    /* curves completed */
+} pg_ecm_result;
+
+/* Look for a factor of n with ECM. Returns 1 with result->factor set, 0 if n is below 4,
+ * a probable prime or no curve succeeded, or a PG_ERR_* code. Curve parameters come from the
+ * context's RNG; with threads = 1 the result is reproducible, with more the first curve to
+ * finish with a factor wins. The cancel hook is polled from the worker threads. */
+PG_API int pg_ecm_big(pg_ctx *ctx, const pg_bigint *n, const pg_ecm_params *params, pg_ecm_result *result);
+/* Self-initializing quadratic sieve (since API version 10) */
+#define PG_SIQS_MAX_BITS 340
+
+typedef struct {
+    pg_bigint factor;       /* a factor 1 < f < n when one was found */
+    pg_bigint cofactor;     /* n / factor */
+    uint32_t multiplier;    /* Knuth-Schroeppel multiplier k; the sieve works on k n */
+    uint32_t factor_base;   /* primes in the factor base, counting -1 */
+    uint32_t relations;     /* full relations collected, including combined partials */
+    uint64_t polynomials;   /* sieve polynomials used */
+} pg_siqs_result;
+
+/* Split n (at most PG_SIQS_MAX_BITS bits) with the quadratic sieve; small factors, squares and
+ * n below 2^64 are handled without it. Returns 1 with result->factor and result->cofactor set,
+ * 0 if n is below 4 or a probable prime (or, very rarely, no dependency split n), or a PG_ERR_*
+ * code. 'threads' sieve in parallel, 0 for one per pool worker; the cancel hook is polled
+ * between polynomial batches. Practical up to about 100 digits. */
+PG_API int pg_siqs_big(pg_ctx *ctx, const pg_bigint *n, uint32_t threads, pg_siqs_result *result);
+
+/* Random probable prime of exactly 'bits' bits, 16 <= bits <= 1024: the first
+ * probable prime at or after a random odd start (wrapping to 2^(bits-1)).
+ * Consecutive odd numbers are sieved in windows whose depth and size adapt to
+ * costs measured on the context; the counters vary with machine load, the
+ * primes found for a given stream do not. Only the random start is drawn from
+ * the context's stream; each candidate's Miller-Rabin bases come from a
+ * substream keyed by the candidate, so later calls replay exactly too. */
+PG_API int pg_generate_prime_big(pg_ctx *ctx, int bits, int rounds, pg_bigint *out);
+
+/* Strong primes (since API version 11) */
+#define PG_STRONG_MIN_BITS 128
+
+typedef struct {
+    pg_bigint p;    /* the prime */
+    pg_bigint r;    /* prime factor of p - 1, about bits/2 - 9 bits */
+    pg_bigint s;    /* prime factor of p + 1, about bits/2 - 9 bits */
+    pg_bigint t;    /* prime factor of r - 1, 16 bits shorter than r */
+} pg_strong_prime;
+
+/* Probable prime of exactly 'bits' bits, PG_STRONG_MIN_BITS <= bits <= 1024, with the large prime
+ * factors r | p - 1, s | p + 1 and t | r - 1 (Gordon's construction). s and t come from
+ * pg_generate_prime_big; r and p are the first probable primes of arithmetic progressions from
+ * random starts, sieved so that only survivors get the 'rounds' Miller-Rabin rounds. The steps draw
+ * only their starts from the context's stream, so a given stream gives the same s, t, r and p
+ * under any load. */
+PG_API int pg_generate_strong_prime_big(pg_ctx *ctx, int bits, int rounds, pg_strong_prime *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
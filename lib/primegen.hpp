@@ -0,0 +1,234 @@
+#ifndef PRIMEGEN_HPP
+#define PRIMEGEN_HPP
+
+#include <stdexcept>
+#include <string>
+#include "primegen.h"
+
+/*
+ * C++ wrapper over the primegen C ABI
+ * - Header only; the library itself stays plain C ABI so it can be
+ *   linked from any language
+ * - Errors are thrown as primegen::Error carrying the PG_ERR_* code
+ * - Context owns a pg_ctx: movable, not copyable
+ */
+
+namespace primegen {
+
+class Error : public std::runtime_error {
+public:
+    explicit Error(int status) : std::runtime_error(pg_strerror(status)), status_(status) {}
+    int status() const { return status_; }
+
+private:
+    int status_;
+};
+
+inline int check(int status) {
+    if (status < 0) throw Error(status);
+    return status;
+}
+
+/* 1024-bit value; a thin value type over pg_bigint */
+struct BigInt {
+    pg_bigint v;
+
+    BigInt() { pg_bigint_set_u64(&v, 0); }
+    explicit BigInt(uint64_t x) { pg_bigint_set_u64(&v, x); }
+
+    static BigInt from_hex(const std::string &hex) {
+        BigInt r;
+        check(pg_bigint_from_hex(&r.v, hex.c_str()));
+        return r;
+    }
+
+    /* 0x-prefixed hex or decimal, any length up to 1024 bits */
+    static BigInt from_text(const std::string &text) {
+        BigInt r;
+        check(pg_bigint_from_text(&r.v, text.c_str()));
+        return r;
+    }
+
+    std::string to_hex() const {
+        char buf[PG_BIGINT_BITS / 4 + 1];
+        check(pg_bigint_to_hex(&v, buf, sizeof(buf)));
+        return buf;
+    }
+
+    int bit_length() const { return pg_bigint_bit_length(&v); }
+
+    friend bool operator==(const BigInt &a, const BigInt &b) { return pg_bigint_cmp(&a.v, &b.v) == 0; }
+    friend bool operator!=(const BigInt &a, const BigInt &b) { return pg_bigint_cmp(&a.v, &b.v) != 0; }
+    friend bool operator<(const BigInt &a, const BigInt &b) { return pg_bigint_cmp(&a.v, &b.v) < 0; }
+};
+
+/* Exact primality for 64-bit values; needs no context */
+inline bool is_prime(uint64_t n) { return pg_is_prime_u64(n) != 0; }
+
+/* Threads and NUMA nodes of the library's worker pool */
+inline void pool_topology(uint32_t &workers, uint32_t &nodes) { pg_pool_topology(&workers, &nodes); }
+
+/* Prime bitmap file with its rank/select index, open for queries */
+class PrimeIndex {
+public:
+    /* Writes the file; see pg_prime_index_build */
+    static void build(const char *path, uint64_t limit, pg_ctx *ctx = NULL) { check(pg_prime_index_build(ctx, path, limit)); }
+
+    explicit PrimeIndex(const char *path) : idx_(NULL) { check(pg_prime_index_open(path, &idx_)); }
+    ~PrimeIndex() { pg_prime_index_close(idx_); }
+
+    PrimeIndex(const PrimeIndex &) = delete;
+    PrimeIndex &operator=(const PrimeIndex &) = delete;
+
+    uint64_t limit() const { return pg_prime_index_limit(idx_); }
+    bool is_prime(uint64_t n) const {
+        int prime;
+        check(pg_prime_index_is_prime(idx_, n, &prime));
+        return prime != 0;
+    }
+    uint64_t pi(uint64_t x) const {
+        uint64_t count;
+        check(pg_prime_pi(idx_, x, &count));
+        return count;
+    }
+    uint64_t nth_prime(uint64_t k) const {
+        uint64_t p;
+        check(pg_nth_prime(idx_, k, &p));
+        return p;
+    }
+
+private:
+    pg_prime_index *idx_;
+};
+
+class Context {
+public:
+    explicit Context(uint64_t seed = pg_default_seed(), uint64_t stream = 0) : ctx_(pg_ctx_create(seed, stream)) {
+        if (ctx_ == NULL) throw Error(PG_ERR_NOMEM);
+    }
+    ~Context() { pg_ctx_destroy(ctx_); }
+
+    Context(const Context &) = delete;
+    Context &operator=(const Context &) = delete;
+    Context(Context &&other) noexcept : ctx_(other.ctx_) { other.ctx_ = NULL; }
+    Context &operator=(Context &&other) noexcept {
+        if (this != &other) {
+            pg_ctx_destroy(ctx_);
+            ctx_ = other.ctx_;
+            other.ctx_ = NULL;
+        }
+        return *this;
+    }
+
+    pg_ctx *get() const { return ctx_; }
+
+    void set_stream(uint64_t seed, uint64_t stream) { pg_ctx_set_stream(ctx_, seed, stream); }
+
+    pg_stats stats() const {
+        pg_stats s;
+        pg_ctx_get_stats(ctx_, &s);
+        return s;
+    }
+    void reset_stats() { pg_ctx_reset_stats(ctx_); }
+
+    void set_progress(pg_progress_fn fn, void *user, uint64_t every) { pg_ctx_set_progress(ctx_, fn, user, every); }
+    void set_cancel(pg_cancel_fn fn, void *user) { pg_ctx_set_cancel(ctx_, fn, user); }
+
+    int enable_perf() { return pg_ctx_enable_perf(ctx_); }
+    pg_perf_report perf() const {
+        pg_perf_report r;
+        pg_ctx_get_perf(ctx_, &r);
+        return r;
+    }
+
+    bool is_probable_prime(uint64_t n, int rounds = PG_DEFAULT_ROUNDS) {
+        return check(pg_is_probable_prime_u64(ctx_, n, rounds)) != 0;
+    }
+    bool is_probable_prime(const BigInt &n, int rounds = PG_DEFAULT_ROUNDS) {
+        return check(pg_is_probable_prime_big(ctx_, &n.v, rounds)) != 0;
+    }
+
+    /* Baillie-PSW plus 'rounds' random-base rounds */
+    bool is_probable_prime_bpsw(const BigInt &n, int rounds = 0) {
+        return check(pg_is_probable_prime_bpsw_big(ctx_, &n.v, rounds)) != 0;
+    }
+
+    /* On the narrowest engine that holds n; *width gets its PG_WIDTH_* */
+    bool is_prime_auto(const BigInt &n, int rounds = 0, int *width = NULL) {
+        return check(pg_is_prime_auto(ctx_, &n.v, rounds, width)) != 0;
+    }
+
+    /* ECM; true with result.factor set when a factor was found */
+    bool ecm(const BigInt &n, const pg_ecm_params &params, pg_ecm_result &result) {
+        return check(pg_ecm_big(ctx_, &n.v, &params, &result)) != 0;
+    }
+
+    /* Quadratic sieve; true with result.factor and result.cofactor set when n was split */
+    bool siqs(const BigInt &n, pg_siqs_result &result, uint32_t threads = 0) {
+        return check(pg_siqs_big(ctx_, &n.v, threads, &result)) != 0;
+    }
+
+    /* Primes lo <= p <= hi in increasing order to fn (may be NULL); returns how many there were */
+    uint64_t sieve_range(uint64_t lo, uint64_t hi, pg_prime_fn fn = NULL, void *user = NULL,
+                         int mode = PG_RANGE_BUCKET) {
+        uint64_t count;
+        check(pg_sieve_range_u64(ctx_, lo, hi, mode, fn, user, &count));
+        return count;
+    }
+
+    /* Factorization of every lo <= n <= hi to fn, concurrently from the workers when threads != 1 */
+    void factor_range(uint64_t lo, uint64_t hi, pg_factor_fn fn, void *user = NULL, uint32_t threads = 0) {
+        check(pg_factor_range_u64(ctx_, lo, hi, threads, fn, user));
+    }
+
+    uint64_t generate_prime_u64(int bits, int rounds = PG_DEFAULT_ROUNDS) {
+        uint64_t p;
+        check(pg_generate_prime_u64(ctx_, bits, rounds, &p));
+        return p;
+    }
+    BigInt generate_prime(int bits, int rounds = PG_DEFAULT_ROUNDS) {
+        BigInt p;
+        check(pg_generate_prime_big(ctx_, bits, rounds, &p.v));
+        return p;
+    }
+    /* Strong prime with its large factors r | p - 1, s | p + 1 and t | r - 1 */
+    pg_strong_prime generate_strong_prime(int bits, int rounds = PG_DEFAULT_ROUNDS) {
+        pg_strong_prime sp;
+        check(pg_generate_strong_prime_big(ctx_, bits, rounds, &sp));
+        return sp;
+    }
+
+private:
+    pg_ctx *ctx_;
+};
+
+/* Numbers tested together from one arena; see pg_big_batch_create */
+class BigBatch {
+public:
+    BigBatch(uint32_t capacity, int bits) : batch_(NULL) { check(pg_big_batch_create(capacity, bits, &batch_)); }
+    ~BigBatch() { pg_big_batch_destroy(batch_); }
+
+    BigBatch(const BigBatch &) = delete;
+    BigBatch &operator=(const BigBatch &) = delete;
+
+    /* Index of n in the batch */
+    uint32_t add(const BigInt &n) { return (uint32_t)check(pg_big_batch_add(batch_, &n.v)); }
+    void reset() { pg_big_batch_reset(batch_); }
+    uint32_t size() const { return pg_big_batch_size(batch_); }
+    BigInt operator[](uint32_t i) const {
+        BigInt n;
+        check(pg_big_batch_get(batch_, i, &n.v));
+        return n;
+    }
+
+    /* Number of probable primes; result(i) says which */
+    uint32_t test(Context &ctx, int rounds = 0) { return (uint32_t)check(pg_big_batch_test(ctx.get(), batch_, rounds)); }
+    bool result(uint32_t i) const { return pg_big_batch_results(batch_)[i] != 0; }
+
+private:
+    pg_big_batch *batch_;
+};
+
+}  // namespace primegen
+
+#endif
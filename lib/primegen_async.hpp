@@ -0,0 +1,239 @@
+#ifndef PRIMEGEN_ASYNC_HPP
+#define PRIMEGEN_ASYNC_HPP
+
+#if !(__cplusplus >= 202002L || (defined(_MSVC_LANG) && _MSVC_LANG >= 202002L))
+#error "primegen_async.hpp requires C++20"
+#endif
+
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "primegen.hpp"
+
+/*
+ * Asynchronous generation and testing on top of the primegen library
+ * - An Executor runs jobs on a fixed pool of worker threads; each job gets
+ *   its own pg_ctx on a fresh RNG stream of the executor's seed, so any
+ *   number of requests can be in flight without a thread per request
+ * - Operations return a Task<T>, consumed exactly once in one of three ways:
+ *     co_await task                  resumes the coroutine with the result
+ *     std::move(task).future()       std::future<T>
+ *     std::move(task).then(cb)       cb(std::exception_ptr, T)
+ *   Nothing runs until the task is consumed
+ * - Cancellation is a std::stop_token, polled before every candidate (and
+ *   between the numbers of a batch); a cancelled job fails with
+ *   primegen::Error whose status() is PG_ERR_CANCELLED
+ * - Progress callbacks and, unless AsyncOptions::resume_on is set,
+ *   completions run on a worker thread. An event loop passes its own post
+ *   function as resume_on to get completions back on the loop thread; it
+ *   must not keep the function when it throws
+ */
+
+namespace primegen {
+
+class Executor {
+public:
+    /* threads == 0 uses one worker per hardware thread */
+    explicit Executor(unsigned threads = 0, uint64_t seed = pg_default_seed()) : seed_(seed) {
+        if (threads == 0) threads = std::thread::hardware_concurrency();
+        if (threads == 0) threads = 1;
+        for (unsigned i = 0; i < threads; i++) {
+            workers_.emplace_back([this] { run(); });
+        }
+    }
+
+    /* Finishes the queued jobs, then joins the workers */
+    ~Executor() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        ready_.notify_all();
+        for (std::thread &t : workers_) t.join();
+    }
+
+    Executor(const Executor &) = delete;
+    Executor &operator=(const Executor &) = delete;
+
+    void post(std::function<void()> job) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            queue_.push_back(std::move(job));
+        }
+        ready_.notify_one();
+    }
+
+    uint64_t seed() const { return seed_; }
+    uint64_t next_stream() { return next_stream_.fetch_add(1, std::memory_order_relaxed); }
+
+private:
+    void run() {
+        for (;;) {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                ready_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+                if (queue_.empty()) return;
+                job = std::move(queue_.front());
+                queue_.pop_front();
+            }
+            job();
+        }
+    }
+
+    uint64_t seed_;
+    std::atomic<uint64_t> next_stream_{0};
+    std::mutex mutex_;
+    std::condition_variable ready_;
+    std::deque<std::function<void()>> queue_;
+    std::vector<std::thread> workers_;
+    bool stopping_ = false;
+};
+
+struct AsyncOptions {
+    std::stop_token stop;                                   /* default: never cancelled */
+    std::function<void(const pg_stats &)> progress;         /* runs on the worker thread */
+    uint64_t progress_every = 100;                          /* candidates (or batch numbers) per call */
+    std::function<void(std::function<void()>)> resume_on;  /* default: complete on the worker thread */
+    std::optional<uint64_t> stream;                         /* default: the executor's next stream */
+};
+
+template <class T>
+class Task {
+public:
+    using Work = std::function<T(Context &, const AsyncOptions &)>;
+    using Callback = std::function<void(std::exception_ptr, T)>;
+
+    Task(Executor &ex, AsyncOptions opts, Work work) : ex_(&ex), opts_(std::move(opts)), work_(std::move(work)) {}
+
+    /* Coroutine interface */
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> h) {
+        std::move(*this).then([this, h](std::exception_ptr error, T value) {
+            error_ = error;
+            if (!error) value_.emplace(std::move(value));
+            h.resume();
+        });
+    }
+    T await_resume() {
+        if (error_) std::rethrow_exception(error_);
+        return std::move(*value_);
+    }
+
+    /* Callback interface; on failure the value is default-constructed. Exceptions thrown by
+     * 'done' are discarded; if resume_on throws, 'done' runs on the worker with that exception */
+    void then(Callback done) && {
+        Executor *ex = ex_;
+        uint64_t stream = opts_.stream ? *opts_.stream : ex->next_stream();
+        ex->post([ex, stream, opts = std::move(opts_), work = std::move(work_), done = std::move(done)]() mutable {
+            std::exception_ptr error;
+            T value{};
+            try {
+                Context ctx(ex->seed(), stream);
+                if (opts.progress) {
+                    ctx.set_progress(progress_thunk, &opts.progress, opts.progress_every);
+                }
+                if (opts.stop.stop_possible()) {
+                    ctx.set_cancel(cancel_thunk, &opts.stop);
+                }
+                value = work(ctx, opts);
+            } catch (...) {
+                error = std::current_exception();
+            }
+            if (opts.resume_on) {
+                auto cb = std::make_shared<Callback>(std::move(done));
+                try {
+                    opts.resume_on([cb, error, value = std::move(value)]() mutable {
+                        complete(*cb, error, std::move(value));
+                    });
+                } catch (...) {
+                    /* the loop did not take the completion; fail the task here rather than lose it */
+                    complete(*cb, std::current_exception(), T{});
+                }
+            } else {
+                complete(done, error, std::move(value));
+            }
+        });
+    }
+
+    /* Future interface */
+    std::future<T> future() && {
+        auto promise = std::make_shared<std::promise<T>>();
+        std::future<T> f = promise->get_future();
+        std::move(*this).then([promise](std::exception_ptr error, T value) {
+            if (error) promise->set_exception(error);
+            else promise->set_value(std::move(value));
+        });
+        return f;
+    }
+
+private:
+    /* Completions run on a worker or on the caller's loop, where an exception would reach
+     * std::terminate; the job is over and nothing is left to report it to, so it is dropped */
+    static void complete(Callback &done, std::exception_ptr error, T value) noexcept {
+        try {
+            done(error, std::move(value));
+        } catch (...) {
+        }
+    }
+    static void progress_thunk(void *user, const pg_stats *stats) {
+        (*static_cast<std::function<void(const pg_stats &)> *>(user))(*stats);
+    }
+    static int cancel_thunk(void *user) {
+        return static_cast<std::stop_token *>(user)->stop_requested();
+    }
+
+    Executor *ex_;
+    AsyncOptions opts_;
+    Work work_;
+    std::exception_ptr error_;
+    std::optional<T> value_;
+};
+
+/* Random probable prime of exactly 'bits' bits, 16 <= bits <= 1024 */
+inline Task<BigInt> generate_prime_async(Executor &ex, int bits, int rounds = PG_DEFAULT_ROUNDS,
+                                         AsyncOptions opts = {}) {
+    return Task<BigInt>(ex, std::move(opts), [bits, rounds](Context &ctx, const AsyncOptions &) {
+        return ctx.generate_prime(bits, rounds);
+    });
+}
+
+/* Random probable prime of exactly 'bits' bits, 2 <= bits <= 63 */
+inline Task<uint64_t> generate_prime_u64_async(Executor &ex, int bits, int rounds = PG_DEFAULT_ROUNDS,
+                                               AsyncOptions opts = {}) {
+    return Task<uint64_t>(ex, std::move(opts), [bits, rounds](Context &ctx, const AsyncOptions &) {
+        return ctx.generate_prime_u64(bits, rounds);
+    });
+}
+
+/* Test every number of the batch; result[i] is true for probable primes.
+ * Cancellation is checked and progress reported between numbers. */
+inline Task<std::vector<bool>> test_batch_async(Executor &ex, std::vector<BigInt> numbers,
+                                                int rounds = PG_DEFAULT_ROUNDS, AsyncOptions opts = {}) {
+    return Task<std::vector<bool>>(ex, std::move(opts),
+                                   [numbers = std::move(numbers), rounds](Context &ctx, const AsyncOptions &o) {
+        std::vector<bool> result(numbers.size());
+        uint64_t every = o.progress_every ? o.progress_every : 1;
+        for (size_t i = 0; i < numbers.size(); i++) {
+            if (o.stop.stop_requested()) throw Error(PG_ERR_CANCELLED);
+            result[i] = ctx.is_probable_prime(numbers[i], rounds);
+            if (o.progress && (i + 1) % every == 0) o.progress(ctx.stats());
+        }
+        return result;
+    });
+}
+
+}  // namespace primegen
+
+#endif
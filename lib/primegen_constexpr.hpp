@@ -0,0 +1,158 @@
+#ifndef PRIMEGEN_CONSTEXPR_HPP
+#define PRIMEGEN_CONSTEXPR_HPP
+
+#include <stdint.h>
+
+/*
+ * Compile-time primality and prime tables (C++17)
+ * - Header only and independent of the library: everything here is
+ *   constexpr, so it works in static_assert, array bounds and template
+ *   arguments, and a table kept in a constexpr variable is stored
+ *   read-only in the binary with no code run at startup
+ * - constexpr_is_prime is exact below 2^64: trial division by the primes
+ *   below 64, then the strong probable-prime test to the same 7 bases as
+ *   pg_is_prime_u64. It is meant for constants; at run time
+ *   pg_is_prime_u64 is several times faster
+ * - prime_table<Limit> holds the primes below Limit, sieved over the odd
+ *   numbers. No loop runs more than Limit / 2 times, so GCC's default
+ *   -fconstexpr-loop-limit (2^18) allows Limit up to 2^19; larger tables
+ *   need that limit (and Clang's -fconstexpr-steps) raised
+ */
+
+namespace primegen {
+
+namespace detail {
+
+#if defined(__SIZEOF_INT128__)
+__extension__ typedef unsigned __int128 u128;
+#endif
+
+/* (a * b) % n for a, b < n */
+constexpr uint64_t mulmod(uint64_t a, uint64_t b, uint64_t n) {
+#if defined(__SIZEOF_INT128__)
+    return (uint64_t)((u128)a * b % n);
+#else
+    uint64_t r = 0;
+    while (b) {
+        if (b & 1) r = r >= n - a ? r - (n - a) : r + a;
+        a = a >= n - a ? a - (n - a) : a + a;
+        b >>= 1;
+    }
+    return r;
+#endif
+}
+
+constexpr uint64_t powmod(uint64_t b, uint64_t e, uint64_t n) {
+    uint64_t r = 1 % n;
+    b %= n;
+    while (e) {
+        if (e & 1) r = mulmod(r, b, n);
+        b = mulmod(b, b, n);
+        e >>= 1;
+    }
+    return r;
+}
+
+/* Strong probable-prime test of odd n > 2 to base a */
+constexpr bool sprp(uint64_t n, uint64_t a) {
+    uint64_t d = n - 1, x = 0;
+    int s = 0;
+    a %= n;
+    if (a == 0) return true;
+    while ((d & 1) == 0) {
+        d >>= 1;
+        s++;
+    }
+    x = powmod(a, d, n);
+    if (x == 1 || x == n - 1) return true;
+    while (--s > 0) {
+        x = mulmod(x, x, n);
+        if (x == n - 1) return true;
+    }
+    return false;
+}
+
+/* composite[i] says whether 2i + 1 is composite, for 2i + 1 < Limit */
+template <uint32_t Limit>
+struct odd_sieve {
+    bool composite[Limit / 2 + 1];
+};
+
+template <uint32_t Limit>
+constexpr odd_sieve<Limit> sieve_odd() {
+    odd_sieve<Limit> s{};
+    s.composite[0] = true;
+    for (uint64_t i = 1; (2 * i + 1) * (2 * i + 1) < Limit; i++) {
+        if (s.composite[i]) continue;
+        for (uint64_t j = (2 * i + 1) * (2 * i + 1) / 2; 2 * j + 1 < Limit; j += 2 * i + 1) {
+            s.composite[j] = true;
+        }
+    }
+    return s;
+}
+
+template <uint32_t Limit>
+constexpr uint32_t count_primes() {
+    const odd_sieve<Limit> s = sieve_odd<Limit>();
+    uint32_t count = Limit > 2 ? 1 : 0;
+    for (uint64_t i = 1; 2 * i + 1 < Limit; i++) {
+        if (!s.composite[i]) count++;
+    }
+    return count;
+}
+
+}  // namespace detail
+
+/* Exact primality of a 64-bit constant */
+constexpr bool constexpr_is_prime(uint64_t n) {
+    const uint32_t small[18] = { 2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53, 59, 61 };
+    /* Jim Sinclair, 2011: exact below 2^64 */
+    const uint64_t bases[7] = { 2, 325, 9375, 28178, 450775, 9780504, 1795265022 };
+    if (n < 2) return false;
+    for (uint32_t p : small) {
+        if (n % p == 0) return n == p;
+    }
+    if (n < 67 * 67) return true;
+    for (uint64_t a : bases) {
+        if (!detail::sprp(n, a)) return false;
+    }
+    return true;
+}
+
+/* Smallest prime >= n, or 0 when there is none below 2^64;
+ * e.g. a hash table size: constexpr_next_prime(1000) == 1009 */
+constexpr uint64_t constexpr_next_prime(uint64_t n) {
+    if (n <= 2) return 2;
+    for (n |= 1; !constexpr_is_prime(n); n += 2) {
+        if (n == UINT64_MAX) return 0;
+    }
+    return n;
+}
+
+/* All primes below Limit, ascending; build one with make_prime_table */
+template <uint32_t Limit>
+struct prime_table {
+    static constexpr uint32_t count = detail::count_primes<Limit>();
+    uint32_t p[count ? count : 1];
+
+    constexpr uint32_t size() const { return count; }
+    constexpr uint32_t operator[](uint32_t i) const { return p[i]; }
+    constexpr const uint32_t *begin() const { return p; }
+    constexpr const uint32_t *end() const { return p + count; }
+};
+
+template <uint32_t Limit>
+constexpr prime_table<Limit> make_prime_table() {
+    const detail::odd_sieve<Limit> s = detail::sieve_odd<Limit>();
+    prime_table<Limit> t{};
+    uint32_t k = 0;
+    if (Limit > 2) t.p[k++] = 2;
+    for (uint64_t i = 1; 2 * i + 1 < Limit; i++) {
+        if (!s.composite[i]) t.p[k++] = (uint32_t)(2 * i + 1);
+    }
+    return t;
+}
+
+}  // namespace primegen
+
+#endif
@@ -1,227 +1,544 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <time.h>
-
-/*
- * Miller-Rabin primality test implementation in C99
- * - Only uses stdio, stdlib, time
- * - Uses small-prime trial division for quick filtering
- * - For primality test picks 10 random bases, prints them (hex) and results
- * - Generates a random prime of specified bit length (default 30 bits)
- * - Saves generated prime in hex to "prime.txt"
- */
-
-typedef unsigned long long ull;
-typedef unsigned long ul;
-
-/* Small primes for quick filtering */
-static const int small_primes[] = {
-    2,3,5,7,11,13,17,19,23,29,
-    31,37,41,43,47,53,59,61,67,71,
-    73,79,83,89,97,101,103,107,109,113,
-    127,131,137,139,149,151,157,163,167,173,
-    179,181,191,193,197,199
-};
-static const int small_primes_count = sizeof(small_primes)/sizeof(small_primes[0]);
-
-/* Generate a 32-bit random value using rand() (portable) */
-static unsigned int rand32(void) {
-    unsigned int r = ((unsigned int)rand() & 0xFFFF);
-    r = (r << 16) | ((unsigned int)rand() & 0xFFFF);
-    return r;
-}
-
-/* Generate a random unsigned long long in [0, max) */
-static ull rand_ull(ull max) {
-    if (max == 0) return 0;
-    ull r = 0;
-    /* build 64-bit from multiple rand32 calls */
-    r = ((ull)rand32() << 32) | (ull)rand32();
-    return r % max;
-}
-
-/* Multiplication modulo without overflow: (a * b) % mod */
-static ull mulmod(ull a, ull b, ull mod) {
-    ull res = 0;
-    a %= mod;
-    while (b) {
-        if (b & 1) {
-            res += a;
-            if (res >= mod) res -= mod;
-        }
-        a <<= 1;
-        if (a >= mod) a -= mod;
-        b >>= 1;
-    }
-    return res % mod;
-}
-
-/* Modular exponentiation: (base^exp) % mod */
-static ull powmod(ull base, ull exp, ull mod) {
-    ull res = 1;
-    base %= mod;
-    while (exp) {
-        if (exp & 1) res = mulmod(res, base, mod);
-        base = mulmod(base, base, mod);
-        exp >>= 1;
-    }
-    return res;
-}
-
-/* Miller-Rabin witness test for base 'a'. Returns 1 if passes (likely prime for this base), 0 if composite */
-static int miller_rabin_witness(ull n, ull a) {
-    if (a % n == 0) return 1;
-    ull d = n - 1;
-    int s = 0;
-    while ((d & 1) == 0) {
-        d >>= 1;
-        s++;
-    }
-    ull x = powmod(a, d, n);
-    if (x == 1 || x == n - 1) return 1;
-    for (int r = 1; r < s; ++r) {
-        x = mulmod(x, x, n);
-        if (x == n - 1) return 1;
-    }
-    return 0;
-}
-
-/* Perform k rounds with random bases, print bases (hex) and results. Returns 1 if probably prime. */
-static int is_probable_prime_with_print(ull n, int k) {
-    if (n < 2) return 0;
-    /* small prime check */
-    for (int i = 0; i < small_primes_count; ++i) {
-        int p = small_primes[i];
-        if ((ull)p == n) return 1;
-        if (n % p == 0) return 0;
-    }
-
-    int all_pass = 1;
-    for (int i = 0; i < k; ++i) {
-        ull a;
-        if (n > 4) a = 2 + rand_ull(n - 3);
-        else a = 2;
-        int pass = miller_rabin_witness(n, a);
-        printf("  base %2d: 0x%llx -> %s\n", i+1, (unsigned long long)a, pass ? "probably prime" : "composite");
-        if (!pass) all_pass = 0;
-    }
-    return all_pass;
-}
-
-/* Perform k rounds without printing (used for generation). Returns 1 if probably prime. */
-static int is_probable_prime(ull n, int k) {
-    if (n < 2) return 0;
-    for (int i = 0; i < small_primes_count; ++i) {
-        int p = small_primes[i];
-        if ((ull)p == n) return 1;
-        if (n % p == 0) return 0;
-    }
-    for (int i = 0; i < k; ++i) {
-        ull a = 2 + rand_ull(n - 3);
-        if (!miller_rabin_witness(n, a)) return 0;
-    }
-    return 1;
-}
-
-/* Generate a random odd number with given bit length (bits >= 2) */
-static ull gen_random_odd(int bits) {
-    if (bits < 2) return 3;
-    /* generate value in [2^(bits-1) .. 2^bits -1] and make it odd */
-    ull high = 1ULL << (bits - 1);
-    ull range = (1ULL << bits) - high; /* range = 2^(bits-1) */
-    ull r = rand_ull(range) + high;
-    r |= 1ULL; /* make odd */
-    return r;
-}
-
-/* Check primality for user-supplied hex input and print 10 bases and results */
-static void check_input_hex(void) {
-    char buf[256];
-    printf("Enter number in hex (e.g. 0x1f,0x3b0c1abd): ");
-    if (!fgets(buf, sizeof(buf), stdin)) return;
-    /* parse hex, allow 0x prefix */
-    char *endptr;
-    ull n = strtoull(buf, &endptr, 0); /* base 0 allows 0x */
-    printf("Testing input n = 0x%llx\n", (unsigned long long)n);
-    /* small prime check */
-    for (int i = 0; i < small_primes_count; ++i) {
-        int p = small_primes[i];
-        if ((ull)p == n) {
-            printf("Number equals small prime %d -> prime\n", p);
-            return;
-        }
-        if (n % p == 0) {
-            printf("Divisible by small prime %d -> composite\n", p);
-            return;
-        }
-    }
-    int result = is_probable_prime_with_print(n, 10);
-    if (result) printf("Overall result: probably prime\n");
-    else printf("Overall result: composite\n");
-}
-
-/* Generate a 30-bit prime, display and save to file */
-static void generate_30bit_prime(void) {
-    int bits = 30;
-    time_t start = time(NULL);
-    int attempts = 0;
-    ull candidate;
-    while (1) {
-        attempts++;
-        candidate = gen_random_odd(bits);
-        int divisible = 0;
-        for (int i = 0; i < small_primes_count; ++i) {
-            int p = small_primes[i];
-            if ((ull)p == candidate) { divisible = 0; break; }
-            if (candidate % p == 0) { divisible = 1; break; }
-        }
-        if (divisible) continue;
-        if (is_probable_prime(candidate, 10)) break;
-        if (difftime(time(NULL), start) > 60.0) {
-            srand((unsigned)time(NULL) + attempts);
-        }
-    }
-    time_t end = time(NULL);
-    printf("\nFound probable %d-bit prime after %d attempts in %.0f seconds:\n", bits, attempts, difftime(end, start));
-    printf("  p = 0x%llx\n", (unsigned long long)candidate);
-
-    FILE *f = NULL;
-#ifdef _MSC_VER
-    if (fopen_s(&f, "prime.txt", "w") == 0 && f != NULL) {
-#else
-    f = fopen("prime.txt", "w");
-    if (f != NULL) {
-#endif
-        fprintf(f, "0x%llx\n", (unsigned long long)candidate);
-        fclose(f);
-        printf("Saved prime in hex to prime.txt\n");
-    } else {
-        printf("Failed to open prime.txt for writing.\n");
-    }
-}
-
-int main() {
-    srand((unsigned)time(NULL));
-
-    while (1) {
-    	printf("\n -------------------------------------------------------------");
-        printf("\n| Select option:                                              |\n");
-        printf("|   1) Test a number (hex input) for primality                |\n");
-        printf("|   2) Generate a random 30-bit prime and save to prime.txt   |\n");
-        printf("|   3) Exit                                                   |\n");
-        printf(" -------------------------------------------------------------\n");
-        printf("Enter choice: ");
-        int c = getchar();
-        while (getchar() != '\n' && !feof(stdin));
-        if (c == '1') {
-            check_input_hex();
-        } else if (c == '2') {
-            generate_30bit_prime();
-        } else if (c == '3') {
-            break;
-        } else {
-            printf("Invalid choice\n");
-        }
-    }
-    return 0;
-}
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "primegen.h"
+#include "prime_bench.h"
+#include "prime_trace.h"
+#include "prime_metrics.h"
+
+/*
+ * Miller-Rabin primality test implementation in C99
+ * - Thin front-end over the primegen library (lib/primegen.h), which does
+ *   the arithmetic, trial division, testing and generation
+ * - Uses small-prime trial division for quick filtering
+ * - For primality test picks 10 random bases, prints them (hex) and results,
+ *   then confirms with the deterministic test (exact below 2^64); input of
+ *   any length up to 1024 bits, several numbers per line, each on the
+ *   narrowest engine (32, 64, 128 bits or big integer) that holds it
+ * - Generates a random prime of specified bit length (default 30 bits)
+ * - Saves generated prime in hex to "prime.txt"
+ * - Random bases and candidates come from a counter-based RNG; every menu
+ *   action draws from its own stream of the master seed (--seed N), so a
+ *   session can be replayed exactly
+ * - --bench-kernels times the 64-bit kernels, scalar and interleaved batch,
+ *   and prints the results as JSON
+ * - --bench-gen N generates N primes and prints throughput statistics as JSON;
+ *   with --perf it adds per-stage hardware counters (Linux perf_event_open)
+ * - USDT probes (prime_trace.h) mark candidates, sieve rejections,
+ *   Miller-Rabin rounds and found primes for bpftrace
+ * - --metrics-file PATH makes --bench-gen write Prometheus text-format
+ *   metrics every --metrics-interval seconds
+ * - --range LO HI counts the primes in [LO, HI] with the segmented sieve
+ *   (bucketed; --range-plain for the plain sieve, to compare);
+ *   --range-check LO HI runs both and fails unless they agree
+ * - --build-index PATH writes the prime bitmap file of the numbers below
+ *   2^32 with its rank/select index; --pi PATH X and --nth-prime PATH K
+ *   answer from it
+ * - --factor-range LO HI [--threads N] prints the factorization of every
+ *   number in [LO, HI], one line each, from the factor sieve
+ */
+
+typedef unsigned long long ull;
+
+/* RNG stream kinds; stream index = (kind << 32) | action sequence number */
+#define STREAM_TEST     1ULL
+#define STREAM_GENERATE 2ULL
+#define STREAM_BENCH    3ULL
+
+/* Parse a seed in decimal or 0x-prefixed hex; returns 1 if the whole string was a number */
+static int parse_seed(const char *val, ull *seed) {
+    char *endptr;
+    *seed = strtoull(val, &endptr, 0);
+    return endptr != val && *endptr == '\0';
+}
+
+/* First and last prime seen by the range sieve */
+typedef struct {
+    uint64_t first;
+    uint64_t last;
+    uint64_t seen;
+} range_ends;
+
+static void note_range_prime(void *user, uint64_t p) {
+    range_ends *ends = (range_ends *)user;
+    if (ends->seen++ == 0) ends->first = p;
+    ends->last = p;
+}
+
+/* Count the primes in [lo, hi] and print the count, the first and last prime and the time;
+ * the ends go to *out when it is not NULL */
+static int count_range(pg_ctx *ctx, ull lo, ull hi, int mode, range_ends *out) {
+    range_ends ends = { 0, 0, 0 };
+    double t0 = bench_now_ns();
+    int status = pg_sieve_range_u64(ctx, lo, hi, mode, note_range_prime, &ends, NULL);
+    double seconds = (bench_now_ns() - t0) / 1e9;
+    if (status != PG_OK) {
+        printf("Range sieve failed: %s\n", pg_strerror(status));
+        return 1;
+    }
+    printf("%llu primes in [%llu, %llu] (%s sieve, %.3f s)\n", (ull)ends.seen, lo, hi,
+           mode == PG_RANGE_PLAIN ? "plain" : "bucket", seconds);
+    if (ends.seen > 0) printf("First: %llu, last: %llu\n", (ull)ends.first, (ull)ends.last);
+    if (out != NULL) *out = ends;
+    return 0;
+}
+
+/* Sieve [lo, hi] in both modes; 1 unless they find the same primes at the ends and in number */
+static int check_range(pg_ctx *ctx, ull lo, ull hi) {
+    range_ends plain, bucket;
+    if (count_range(ctx, lo, hi, PG_RANGE_PLAIN, &plain) != 0 ||
+        count_range(ctx, lo, hi, PG_RANGE_BUCKET, &bucket) != 0) {
+        return 1;
+    }
+    if (plain.seen != bucket.seen || plain.first != bucket.first || plain.last != bucket.last) {
+        printf("MISMATCH between the plain and bucket sieves\n");
+        return 1;
+    }
+    printf("Plain and bucket sieves agree\n");
+    return 0;
+}
+
+/* Write the prime index file of all numbers below 2^32 */
+static int build_index(pg_ctx *ctx, const char *path) {
+    double t0 = bench_now_ns();
+    int status = pg_prime_index_build(ctx, path, 1ULL << 32);
+    if (status != PG_OK) {
+        printf("Failed to build %s: %s\n", path, pg_strerror(status));
+        return 1;
+    }
+    printf("Wrote %s (%.3f s)\n", path, (bench_now_ns() - t0) / 1e9);
+    return 0;
+}
+
+/* Answer pi(arg) or, with nth, the arg-th prime from the index file at path */
+static int query_index(const char *path, int nth, ull arg) {
+    pg_prime_index *idx;
+    uint64_t answer;
+    int status = pg_prime_index_open(path, &idx);
+    if (status == PG_OK) {
+        status = nth ? pg_nth_prime(idx, arg, &answer) : pg_prime_pi(idx, arg, &answer);
+        pg_prime_index_close(idx);
+    }
+    if (status != PG_OK) {
+        printf("%s: %s\n", path, pg_strerror(status));
+        return 1;
+    }
+    if (nth) printf("Prime #%llu: %llu\n", arg, (ull)answer);
+    else printf("pi(%llu) = %llu\n", arg, (ull)answer);
+    return 0;
+}
+
+/* One line "n = p^e * q" per number, written with a single call so parallel parts do not mix */
+static void print_factors(void *user, uint64_t n, const pg_factor *f, int count) {
+    char line[32 + PG_FACTOR_MAX * 32];
+    int len = sprintf(line, "%llu =", (ull)n);
+    (void)user;
+    for (int i = 0; i < count; i++) {
+        len += sprintf(line + len, i ? " * %llu" : " %llu", (ull)f[i].prime);
+        if (f[i].exponent > 1) len += sprintf(line + len, "^%u", f[i].exponent);
+    }
+    if (count == 0) len += sprintf(line + len, " %llu", (ull)n);
+    line[len++] = '\n';
+    line[len] = '\0';
+    fputs(line, stdout);
+}
+
+/* Factor every number in [lo, hi]; the timing goes to stderr to keep stdout to the factorizations */
+static int factor_range(pg_ctx *ctx, ull lo, ull hi, uint32_t threads) {
+    double t0 = bench_now_ns();
+    int status = pg_factor_range_u64(ctx, lo, hi, threads, print_factors, NULL);
+    if (status != PG_OK) {
+        printf("Factor sieve failed: %s\n", pg_strerror(status));
+        return 1;
+    }
+    fprintf(stderr, "Factored %llu numbers (%.3f s)\n", hi - lo + 1, (bench_now_ns() - t0) / 1e9);
+    return 0;
+}
+
+/* Test one number of any width up to 1024 bits on the narrowest engine that holds it;
+ * up to 64 bits also print 10 random bases and their results */
+static void check_number(pg_ctx *ctx, const char *text) {
+    pg_bigint big;
+    char hex[PG_BIGINT_BITS / 4 + 1];
+    int width, result;
+    if (pg_bigint_from_text(&big, text) != PG_OK) {
+        printf("Not a number of at most %d bits: %s\n", PG_BIGINT_BITS, text);
+        return;
+    }
+    pg_bigint_to_hex(&big, hex, sizeof(hex));
+    printf("Testing input n = 0x%s (%d bits)\n", hex, pg_bigint_bit_length(&big));
+    result = pg_is_prime_auto(ctx, &big, 10, &width);
+    if (width > PG_WIDTH_64) {
+        printf("Baillie-PSW + 10 random bases (%d-bit engine): %s\n", width, result ? "probably prime" : "composite");
+        return;
+    }
+    ull n = (ull)big.words[1] << 32 | big.words[0];
+    if (n < 2) {
+        printf("Overall result: composite\n");
+        return;
+    }
+    /* small prime check */
+    unsigned int p = pg_small_prime_divisor_u64(n);
+    if (p == n) {
+        printf("Number equals small prime %u -> prime\n", p);
+        return;
+    }
+    if (p != 0) {
+        printf("Divisible by small prime %u -> composite\n", p);
+        return;
+    }
+    uint64_t bases[10];
+    int passed[10];
+    int all_pass = pg_mr_rounds_u64(ctx, n, 10, bases, passed);
+    for (int i = 0; i < 10; ++i) {
+        printf("  base %2d: 0x%llx -> %s\n", i+1, (unsigned long long)bases[i], passed[i] ? "probably prime" : "composite");
+    }
+    if (all_pass) printf("Overall result: probably prime\n");
+    else printf("Overall result: composite\n");
+    printf("Deterministic test (%d-bit engine): %s\n", width, result ? "prime" : "composite");
+}
+
+/* Check primality for user-supplied input: hex with 0x or decimal, several
+ * separated by commas or spaces, each on the engine its width calls for */
+static void check_input_hex(pg_ctx *ctx) {
+    char buf[4096];
+    printf("Enter number(s) in hex (e.g. 0x1f,0x3b0c1abd): ");
+    if (!fgets(buf, sizeof(buf), stdin)) return;
+    for (char *tok = strtok(buf, ", \t\r\n"); tok != NULL; tok = strtok(NULL, ", \t\r\n")) {
+        check_number(ctx, tok);
+    }
+}
+
+/* Generate a 30-bit prime, display and save to file */
+static void generate_30bit_prime(pg_ctx *ctx) {
+    int bits = 30;
+    uint64_t candidate;
+    pg_stats stats;
+    time_t start = time(NULL);
+    pg_ctx_reset_stats(ctx);
+    pg_generate_prime_u64(ctx, bits, PG_DEFAULT_ROUNDS, &candidate);
+    pg_ctx_get_stats(ctx, &stats);
+    time_t end = time(NULL);
+    printf("\nFound probable %d-bit prime after %llu attempts in %.0f seconds:\n", bits,
+           (unsigned long long)stats.candidates, difftime(end, start));
+    printf("  p = 0x%llx\n", (unsigned long long)candidate);
+
+    FILE *f = NULL;
+#ifdef _MSC_VER
+    if (fopen_s(&f, "prime.txt", "w") == 0 && f != NULL) {
+#else
+    f = fopen("prime.txt", "w");
+    if (f != NULL) {
+#endif
+        fprintf(f, "0x%llx\n", (unsigned long long)candidate);
+        fclose(f);
+        printf("Saved prime in hex to prime.txt\n");
+    } else {
+        printf("Failed to open prime.txt for writing.\n");
+    }
+}
+
+/* Generate 'count' 30-bit primes, each from its own RNG stream, and report throughput as JSON.
+ * With use_perf, per-stage hardware counters are added to the report;
+ * metrics (may be NULL) is updated after every prime. */
+static void bench_generation(pg_ctx *ctx, ull seed, int count, int use_perf, metrics_exporter *metrics, FILE *out) {
+    int bits = 30, rounds = PG_DEFAULT_ROUNDS;
+    pg_stats stats;
+    pg_perf_report perf;
+    uint64_t prime;
+    double *times = (double *)malloc(sizeof(double) * (size_t)count);
+    if (times == NULL) {
+        printf("Out of memory\n");
+        return;
+    }
+    /* fraction of random odd numbers divisible by an odd prime up to the trial-division bound */
+    double survive = pg_trial_survival(pg_trial_bound_u64(bits));
+
+    if (use_perf && !pg_ctx_enable_perf(ctx)) {
+        fprintf(stderr, "perf_event_open unavailable; reporting without hardware counters\n");
+    }
+
+    pg_ctx_reset_stats(ctx);
+    double start = bench_now_ns();
+    TRACE_BATCH_START(0, count);
+    for (int i = 0; i < count; ++i) {
+        pg_ctx_set_stream(ctx, seed, (STREAM_BENCH << 32) | (ull)i);
+        double t0 = bench_now_ns();
+        pg_generate_prime_u64(ctx, bits, rounds, &prime);
+        times[i] = bench_now_ns() - t0;
+        if (metrics) {
+            pg_ctx_get_stats(ctx, &stats);
+            metrics->queue_pending = (ull)(count - i - 1);
+            metrics_observe_prime(metrics, times[i] / 1e9);
+            metrics_maybe_write(metrics, &stats);
+        }
+    }
+    pg_ctx_get_stats(ctx, &stats);
+    if (metrics && !metrics_write(metrics, &stats)) {
+        fprintf(stderr, "Failed to write metrics file %s\n", metrics->path);
+    }
+    double total = bench_now_ns() - start;
+    TRACE_BATCH_END(0, stats.primes, stats.candidates);
+    pg_ctx_get_perf(ctx, &perf);
+    bench_write_gen_report(out, "generate_30bit_prime", bits, seed, rounds, times, count, &stats, total, 1.0 - survive,
+                           use_perf ? &perf : NULL);
+    free(times);
+}
+
+/* Kernel microbenchmarks (--bench-kernels). Each iteration processes
+ * BENCH_BATCH numbers, so scalar loops and the interleaved batch kernels
+ * are compared per number. */
+#define BENCH_BATCH 64
+
+typedef struct {
+    int bits;
+    uint64_t n[BENCH_BATCH], a[BENCH_BATCH], e[BENCH_BATCH], out[BENCH_BATCH];
+    int passed[BENCH_BATCH];
+    unsigned int sink;
+} bench_operands;
+
+static void bench_mulmod(void *state, long iters) {
+    bench_operands *o = (bench_operands *)state;
+    for (long i = 0; i < iters; ++i) {
+        for (int j = 0; j < BENCH_BATCH; ++j) o->a[j] = pg_mulmod_u64(o->a[j], o->e[j], o->n[j]);
+    }
+    o->sink += (unsigned int)o->a[0];
+}
+
+static void bench_powmod(void *state, long iters) {
+    bench_operands *o = (bench_operands *)state;
+    for (long i = 0; i < iters; ++i) {
+        for (int j = 0; j < BENCH_BATCH; ++j) o->out[j] = pg_powmod_u64(o->a[j], o->e[j], o->n[j]);
+        o->a[i % BENCH_BATCH] ^= o->out[0] & 1;
+    }
+    o->sink += (unsigned int)o->out[0];
+}
+
+static void bench_powmod_batch(void *state, long iters) {
+    bench_operands *o = (bench_operands *)state;
+    for (long i = 0; i < iters; ++i) {
+        pg_powmod_batch_u64(o->a, o->e, o->n, o->out, BENCH_BATCH);
+        o->a[i % BENCH_BATCH] ^= o->out[0] & 1;
+    }
+    o->sink += (unsigned int)o->out[0];
+}
+
+static void bench_witness(void *state, long iters) {
+    bench_operands *o = (bench_operands *)state;
+    for (long i = 0; i < iters; ++i) {
+        for (int j = 0; j < BENCH_BATCH; ++j) o->sink += pg_mr_witness_u64(o->n[j], o->a[j]);
+        o->a[i % BENCH_BATCH] += 1;
+    }
+}
+
+static void bench_witness_batch(void *state, long iters) {
+    bench_operands *o = (bench_operands *)state;
+    for (long i = 0; i < iters; ++i) {
+        pg_mr_witness_batch_u64(o->n, o->a, o->passed, BENCH_BATCH);
+        o->sink += o->passed[0];
+        o->a[i % BENCH_BATCH] += 1;
+    }
+}
+
+/* The 7 bases of the deterministic 64-bit test, one after another and all at once */
+static const uint64_t bench_bases7[7] = { 2, 325, 9375, 28178, 450775, 9780504, 1795265022 };
+
+static void bench_witness7(void *state, long iters) {
+    bench_operands *o = (bench_operands *)state;
+    for (long i = 0; i < iters; ++i) {
+        for (int j = 0; j < BENCH_BATCH; ++j) {
+            for (int k = 0; k < 7; ++k) o->sink += pg_mr_witness_u64(o->n[j], bench_bases7[k]);
+        }
+        o->n[i % BENCH_BATCH] += 2;
+    }
+}
+
+static void bench_witness_bases7(void *state, long iters) {
+    bench_operands *o = (bench_operands *)state;
+    for (long i = 0; i < iters; ++i) {
+        for (int j = 0; j < BENCH_BATCH; ++j) {
+            pg_mr_witness_bases_u64(o->n[j], bench_bases7, o->passed, 7);
+            o->sink += o->passed[0];
+        }
+        o->n[i % BENCH_BATCH] += 2;
+    }
+}
+
+static const struct {
+    const char *name;
+    void (*run)(void *state, long iters);
+} bench_kernels[] = {
+    { "pg_mulmod_u64", bench_mulmod },
+    { "pg_powmod_u64", bench_powmod },
+    { "pg_powmod_batch_u64", bench_powmod_batch },
+    { "pg_mr_witness_u64", bench_witness },
+    { "pg_mr_witness_batch_u64", bench_witness_batch },
+    { "pg_mr_witness_u64 x7", bench_witness7 },
+    { "pg_mr_witness_bases_u64 x7", bench_witness_bases7 },
+};
+
+/* Benchmark every kernel at 32 and 64 bits and write a JSON report */
+static void run_kernel_benchmarks(pg_ctx *ctx, ull seed, int samples, FILE *out) {
+    static const int widths[2] = { 32, 64 };
+    bench_operands o;
+    unsigned int sink = 0;
+    int first = 1;
+    bench_kernels_begin(out, "u64_kernels", seed, samples);
+    for (int w = 0; w < 2; ++w) {
+        for (size_t k = 0; k < sizeof(bench_kernels) / sizeof(bench_kernels[0]); ++k) {
+            o.bits = widths[w];
+            o.sink = 0;
+            for (int j = 0; j < BENCH_BATCH; ++j) {
+                /* random odd modulus with the top bit set; exponent n - 1 as in Miller-Rabin */
+                pg_bigint r;
+                pg_bigint_random(ctx, &r, o.bits);
+                o.n[j] = ((uint64_t)r.words[1] << 32 | r.words[0]) | 1;
+                o.e[j] = o.n[j] - 1;
+                o.a[j] = 2 + o.n[j] / 3;
+            }
+            bench_run_kernel(out, first, bench_kernels[k].name, o.bits, bench_kernels[k].run, &o, BENCH_BATCH, samples);
+            sink += o.sink;
+            first = 0;
+        }
+    }
+    bench_kernels_end(out, sink);
+}
+
+int main(int argc, char **argv) {
+    ull seed = 0;
+    int have_seed = 0;
+    int bench_count = 0;
+    int bench_kernels_mode = 0;
+    int bench_samples = 20;
+    int use_perf = 0;
+    const char *metrics_path = NULL;
+    double metrics_interval = 15.0;
+    int have_range = 0, range_mode = PG_RANGE_BUCKET, range_check = 0;
+    const char *index_path = NULL;
+    int index_query = -1;   /* 0 for --pi, 1 for --nth-prime */
+    int build_index_mode = 0;
+    ull index_arg = 0;
+    int have_factor_range = 0;
+    uint32_t threads = 0;
+    ull range_lo = 0, range_hi = 0;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc && parse_seed(argv[i+1], &seed)) {
+            have_seed = 1;
+            ++i;
+        } else if (strcmp(argv[i], "--bench-kernels") == 0) {
+            bench_kernels_mode = 1;
+        } else if (strcmp(argv[i], "--bench-samples") == 0 && i + 1 < argc) {
+            bench_samples = atoi(argv[++i]);
+            if (bench_samples < 1 || bench_samples > BENCH_MAX_SAMPLES) {
+                printf("--bench-samples must be between 1 and %d\n", BENCH_MAX_SAMPLES);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--bench-gen") == 0 && i + 1 < argc && atoi(argv[i+1]) > 0) {
+            bench_count = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--perf") == 0) {
+            use_perf = 1;
+        } else if (strcmp(argv[i], "--metrics-file") == 0 && i + 1 < argc) {
+            metrics_path = argv[++i];
+        } else if (strcmp(argv[i], "--metrics-interval") == 0 && i + 1 < argc && atof(argv[i+1]) > 0) {
+            metrics_interval = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--range") == 0 && i + 2 < argc && parse_seed(argv[i+1], &range_lo) &&
+                   parse_seed(argv[i+2], &range_hi) && range_lo <= range_hi) {
+            have_range = 1;
+            i += 2;
+        } else if (strcmp(argv[i], "--range-check") == 0 && i + 2 < argc && parse_seed(argv[i+1], &range_lo) &&
+                   parse_seed(argv[i+2], &range_hi) && range_lo <= range_hi) {
+            have_range = 1;
+            range_check = 1;
+            i += 2;
+        } else if (strcmp(argv[i], "--range-plain") == 0) {
+            range_mode = PG_RANGE_PLAIN;
+        } else if (strcmp(argv[i], "--factor-range") == 0 && i + 2 < argc && parse_seed(argv[i+1], &range_lo) &&
+                   parse_seed(argv[i+2], &range_hi) && range_lo <= range_hi) {
+            have_factor_range = 1;
+            i += 2;
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc && atoi(argv[i+1]) > 0) {
+            threads = (uint32_t)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--build-index") == 0 && i + 1 < argc) {
+            index_path = argv[++i];
+            build_index_mode = 1;
+        } else if ((strcmp(argv[i], "--pi") == 0 || strcmp(argv[i], "--nth-prime") == 0) && i + 2 < argc &&
+                   parse_seed(argv[i+2], &index_arg)) {
+            index_query = strcmp(argv[i], "--nth-prime") == 0;
+            index_path = argv[i+1];
+            i += 2;
+        } else {
+            printf("Usage: %s [--seed N] [--bench-kernels [--bench-samples N]]\n"
+                   "       [--bench-gen COUNT [--perf] [--metrics-file PATH [--metrics-interval SEC]]]\n"
+                   "       [--range LO HI [--range-plain]] [--range-check LO HI] [--build-index PATH]\n"
+                   "       [--pi PATH X] [--nth-prime PATH K] [--factor-range LO HI [--threads N]]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (!have_seed) seed = pg_default_seed();
+    pg_ctx *ctx = pg_ctx_create(seed, 0);
+    if (ctx == NULL) {
+        printf("Out of memory\n");
+        return 1;
+    }
+    if (bench_kernels_mode) {
+        pg_ctx_set_stream(ctx, seed, STREAM_BENCH << 32);
+        run_kernel_benchmarks(ctx, seed, bench_samples, stdout);
+        pg_ctx_destroy(ctx);
+        return 0;
+    }
+    if (index_query >= 0) {
+        pg_ctx_destroy(ctx);
+        return query_index(index_path, index_query, index_arg);
+    }
+    if (build_index_mode) {
+        int status = build_index(ctx, index_path);
+        pg_ctx_destroy(ctx);
+        return status;
+    }
+    if (have_factor_range) {
+        int status = factor_range(ctx, range_lo, range_hi, threads);
+        pg_ctx_destroy(ctx);
+        return status;
+    }
+    if (have_range) {
+        int status = range_check ? check_range(ctx, range_lo, range_hi)
+                                 : count_range(ctx, range_lo, range_hi, range_mode, NULL);
+        pg_ctx_destroy(ctx);
+        return status;
+    }
+    if (bench_count > 0) {
+        metrics_exporter metrics;
+        if (metrics_path) metrics_init(&metrics, metrics_path, metrics_interval, "generate_30bit_prime", 30);
+        bench_generation(ctx, seed, bench_count, use_perf, metrics_path ? &metrics : NULL, stdout);
+        pg_ctx_destroy(ctx);
+        return 0;
+    }
+    printf("Seed: 0x%llx (replay with --seed 0x%llx)\n", seed, seed);
+    ull actions = 0;
+
+    while (1) {
+    	printf("\n -------------------------------------------------------------");
+        printf("\n| Select option:                                              |\n");
+        printf("|   1) Test a number (hex input) for primality                |\n");
+        printf("|   2) Generate a random 30-bit prime and save to prime.txt   |\n");
+        printf("|   3) Exit                                                   |\n");
+        printf(" -------------------------------------------------------------\n");
+        printf("Enter choice: ");
+        int c = getchar();
+        while (getchar() != '\n' && !feof(stdin));
+        if (c == '1') {
+            pg_ctx_set_stream(ctx, seed, (STREAM_TEST << 32) | actions++);
+            check_input_hex(ctx);
+        } else if (c == '2') {
+            pg_ctx_set_stream(ctx, seed, (STREAM_GENERATE << 32) | actions++);
+            generate_30bit_prime(ctx);
+        } else if (c == '3') {
+            break;
+        } else {
+            printf("Invalid choice\n");
+        }
+    }
+    pg_ctx_destroy(ctx);
+    return 0;
+}
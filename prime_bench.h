@@ -0,0 +1,246 @@
+#ifndef PRIME_BENCH_H
+#define PRIME_BENCH_H
+
+#include <stdio.h>
+#include <math.h>
+#include <stdlib.h>
+#include <time.h>
+#include "primegen.h"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define BENCH_HAVE_TSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_HAVE_TSC 1
+#else
+#define BENCH_HAVE_TSC 0
+#endif
+
+/*
+ * Measurement helpers shared by the benchmark modes
+ * - Wall-clock time in nanoseconds (C11 timespec_get)
+ * - Cycle counts from the time-stamp counter where available (x86 only;
+ *   these are reference cycles, not core cycles under frequency scaling)
+ * - Sample summaries (min / median / mean / stddev / p99 / max) and JSON output
+ * - The kernel microbenchmark driver (--bench-kernels): warm-up, batch
+ *   size calibration and per-operation samples
+ * - Generation counters and the end-to-end throughput report (--bench-gen),
+ *   with attempts compared against the prime number theorem, plus the
+ *   per-stage hardware counters when perf instrumentation is enabled
+ * - Counters are the library's pg_stats / pg_perf_report
+ */
+
+typedef struct {
+    double min;
+    double median;
+    double mean;
+    double stddev;
+    double p99;
+    double max;
+} bench_summary;
+
+static const char *const bench_perf_stage_names[PG_PERF_STAGES] = { "other", "candidate", "sieve", "miller_rabin" };
+static const char *const bench_perf_event_names[PG_PERF_EVENTS] = {
+    "cycles", "instructions", "branch_misses", "l1d_read_misses", "llc_misses"
+};
+
+/* Current wall-clock time in nanoseconds */
+static inline double bench_now_ns(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+/* Current time-stamp counter value, 0 where unavailable */
+static inline unsigned long long bench_cycles(void) {
+#if BENCH_HAVE_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static inline int bench_compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* Summarize n samples; sorts the array in place */
+static inline void bench_summarize(double *samples, int n, bench_summary *out) {
+    int i;
+    double sum = 0.0, sq = 0.0;
+    if (n <= 0) {
+        out->min = out->median = out->mean = out->stddev = out->p99 = out->max = 0.0;
+        return;
+    }
+    qsort(samples, (size_t)n, sizeof(double), bench_compare_double);
+    for (i = 0; i < n; i++) sum += samples[i];
+    out->mean = sum / n;
+    for (i = 0; i < n; i++) sq += (samples[i] - out->mean) * (samples[i] - out->mean);
+    out->stddev = n > 1 ? sqrt(sq / (n - 1)) : 0.0;
+    out->min = samples[0];
+    out->max = samples[n - 1];
+    out->median = (n % 2) ? samples[n / 2] : 0.5 * (samples[n / 2 - 1] + samples[n / 2]);
+    /* nearest-rank percentile */
+    i = (int)((99.0 * n + 99.0) / 100.0) - 1;
+    if (i < 0) i = 0;
+    if (i >= n) i = n - 1;
+    out->p99 = samples[i];
+}
+
+/* Write a summary as a JSON object */
+static inline void bench_json_summary(FILE *f, const bench_summary *s) {
+    fprintf(f, "{\"min\": %.3f, \"median\": %.3f, \"mean\": %.3f, \"stddev\": %.3f, \"p99\": %.3f, \"max\": %.3f}",
+            s->min, s->median, s->mean, s->stddev, s->p99, s->max);
+}
+
+/* Kernel microbenchmarks (--bench-kernels) */
+#define BENCH_WARMUP_NS   50e6   /* warm up each kernel for 50 ms */
+#define BENCH_SAMPLE_NS   10e6   /* each sample runs for at least 10 ms */
+#define BENCH_MAX_SAMPLES 1000
+
+static inline void bench_kernels_begin(FILE *out, const char *benchmark, unsigned long long seed, int samples) {
+    fprintf(out, "{\n  \"benchmark\": \"%s\",\n  \"seed\": \"0x%llx\",\n", benchmark, seed);
+    fprintf(out, "  \"samples\": %d,\n  \"cycles_source\": %s,\n  \"results\": [", samples,
+            BENCH_HAVE_TSC ? "\"tsc\"" : "null");
+}
+
+static inline void bench_kernels_end(FILE *out, unsigned int sink) {
+    fprintf(out, "\n  ],\n  \"sink\": %u\n}\n", sink);
+}
+
+/* Benchmark one kernel and write its JSON result. run(state, iters) performs
+ * 'iters' iterations of 'ops' operations each; times are reported per operation. */
+static inline void bench_run_kernel(FILE *out, int first, const char *name, int bits,
+                                    void (*run)(void *state, long iters), void *state, int ops, int samples) {
+    static double ns[BENCH_MAX_SAMPLES], cyc[BENCH_MAX_SAMPLES];
+    bench_summary s;
+    long iters = 1;
+    double t0, elapsed;
+    int i;
+
+    /* Warm up, doubling the batch size until one batch fills a sample */
+    t0 = bench_now_ns();
+    do {
+        double b0 = bench_now_ns();
+        run(state, iters);
+        elapsed = bench_now_ns() - b0;
+        if (elapsed < BENCH_SAMPLE_NS) iters *= 2;
+    } while (elapsed < BENCH_SAMPLE_NS || bench_now_ns() - t0 < BENCH_WARMUP_NS);
+
+    for (i = 0; i < samples; i++) {
+        unsigned long long c0 = bench_cycles();
+        double b0 = bench_now_ns();
+        run(state, iters);
+        double b1 = bench_now_ns();
+        unsigned long long c1 = bench_cycles();
+        ns[i] = (b1 - b0) / ((double)iters * ops);
+        cyc[i] = (double)(c1 - c0) / ((double)iters * ops);
+    }
+
+    fprintf(out, "%s\n    {\"kernel\": \"%s\", \"bits\": %d, \"iterations_per_sample\": %ld,\n",
+            first ? "" : ",", name, bits, iters * ops);
+    bench_summarize(ns, samples, &s);
+    fprintf(out, "     \"ns_per_op\": ");
+    bench_json_summary(out, &s);
+    fprintf(out, ",\n     \"cycles_per_op\": ");
+    if (BENCH_HAVE_TSC) {
+        bench_summarize(cyc, samples, &s);
+        bench_json_summary(out, &s);
+    } else {
+        fprintf(out, "null");
+    }
+    fprintf(out, "}");
+    fflush(out);
+}
+
+/* Expected number of random odd 'bits'-bit candidates per prime.
+ * By the prime number theorem a random odd t is prime with probability
+ * about 2 / ln t; average that over [2^(bits-1), 2^bits). */
+static inline double bench_expected_attempts(int bits) {
+    const int steps = 4096;
+    double sum = 0.0;
+    int i;
+    for (i = 0; i < steps; i++) {
+        double u = (i + 0.5) / steps;
+        sum += 1.0 / ((bits - 1) * log(2.0) + log1p(u));
+    }
+    return 1.0 / (2.0 * sum / steps);
+}
+
+static inline double bench_ratio(uint64_t num, uint64_t den) {
+    return den ? (double)num / (double)den : 0.0;
+}
+
+/* Write per-stage counters, IPC and misses per 1000 instructions as JSON */
+static inline void bench_write_perf_json(FILE *f, const pg_perf_report *p) {
+    int s, e, first = 1;
+    fprintf(f, "{\"available\": %s, \"events\": [", p->event_mask ? "true" : "false");
+    for (e = 0; e < PG_PERF_EVENTS; e++) {
+        if (!(p->event_mask & (1U << e))) continue;
+        fprintf(f, "%s\"%s\"", first ? "" : ", ", bench_perf_event_names[e]);
+        first = 0;
+    }
+    fprintf(f, "], \"stages\": {");
+    for (s = 1; s < PG_PERF_STAGES; s++) {
+        const uint64_t *t = p->counts[s];
+        fprintf(f, "%s\n    \"%s\": {\"entries\": %llu", s > 1 ? "," : "", bench_perf_stage_names[s],
+                (unsigned long long)p->entries[s]);
+        for (e = 0; e < PG_PERF_EVENTS; e++) {
+            if (p->event_mask & (1U << e)) fprintf(f, ", \"%s\": %llu", bench_perf_event_names[e], (unsigned long long)t[e]);
+        }
+        if ((p->event_mask & (1U << PG_PERF_EV_CYCLES)) && (p->event_mask & (1U << PG_PERF_EV_INSTRUCTIONS))) {
+            fprintf(f, ", \"ipc\": %.3f", bench_ratio(t[PG_PERF_EV_INSTRUCTIONS], t[PG_PERF_EV_CYCLES]));
+        }
+        if (p->event_mask & (1U << PG_PERF_EV_INSTRUCTIONS)) {
+            for (e = PG_PERF_EV_BRANCH_MISSES; e < PG_PERF_EVENTS; e++) {
+                if (p->event_mask & (1U << e)) {
+                    fprintf(f, ", \"%s_per_kinstr\": %.4f", bench_perf_event_names[e],
+                            1000.0 * bench_ratio(t[e], t[PG_PERF_EV_INSTRUCTIONS]));
+                }
+            }
+        }
+        fprintf(f, "}");
+    }
+    fprintf(f, "\n  }}");
+}
+
+/* Write the end-to-end generation report as JSON.
+ * times_ns holds the time-to-prime of each of the 'count' primes (sorted in place),
+ * expected_sieve_reject is the fraction of random odd numbers the trial-division
+ * table is expected to reject; perf may be NULL. */
+static inline void bench_write_gen_report(FILE *f, const char *generator, int bits, unsigned long long seed,
+                                          int rounds, double *times_ns, int count, const pg_stats *t,
+                                          double total_ns, double expected_sieve_reject,
+                                          const pg_perf_report *perf) {
+    bench_summary s;
+    double secs = total_ns / 1e9;
+    double expected = bench_expected_attempts(bits);
+    double mean_attempts = count ? (double)t->candidates / count : 0.0;
+    /* attempts per prime are geometric: variance = (1 - p) / p^2 */
+    double p = 1.0 / expected;
+    double stderr_attempts = count ? sqrt((1.0 - p) / (p * p) / count) : 0.0;
+
+    bench_summarize(times_ns, count, &s);
+    fprintf(f, "{\n  \"benchmark\": \"generation\",\n  \"generator\": \"%s\",\n  \"bits\": %d,\n", generator, bits);
+    fprintf(f, "  \"seed\": \"0x%llx\",\n  \"mr_rounds_per_test\": %d,\n  \"primes\": %llu,\n", seed, rounds,
+            (unsigned long long)t->primes);
+    fprintf(f, "  \"total_seconds\": %.6f,\n  \"time_to_prime_ns\": ", secs);
+    bench_json_summary(f, &s);
+    fprintf(f, ",\n  \"primes_per_sec\": %.3f,\n", secs > 0 ? t->primes / secs : 0.0);
+    fprintf(f, "  \"candidates_per_sec\": %.3f,\n", secs > 0 ? t->candidates / secs : 0.0);
+    fprintf(f, "  \"mr_rounds_per_sec\": %.3f,\n", secs > 0 ? t->mr_rounds / secs : 0.0);
+    fprintf(f, "  \"sieve_rejection_rate\": %.6f,\n", t->candidates ? (double)t->sieve_rejects / t->candidates : 0.0);
+    fprintf(f, "  \"expected_sieve_rejection_rate\": %.6f,\n", expected_sieve_reject);
+    fprintf(f, "  \"trial_bound\": %u,\n  \"sieve_window\": %u,\n", (unsigned)t->trial_bound, (unsigned)t->sieve_window);
+    fprintf(f, "  \"attempts_per_prime\": {\"observed_mean\": %.3f, \"expected\": %.3f, \"expected_stderr\": %.3f, \"ratio\": %.4f}",
+            mean_attempts, expected, stderr_attempts, expected > 0 ? mean_attempts / expected : 0.0);
+    if (perf != NULL) {
+        fprintf(f, ",\n  \"perf\": ");
+        bench_write_perf_json(f, perf);
+    }
+    fprintf(f, "\n}\n");
+}
+
+#endif
@@ -0,0 +1,145 @@
+#ifndef PRIME_METRICS_H
+#define PRIME_METRICS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "prime_bench.h"
+
+/*
+ * Prometheus text-format metrics exporter (node exporter textfile collector)
+ * - Long-running modes feed it generation counters and time-to-prime
+ *   observations; at most every 'interval' seconds it rewrites the file
+ * - The file is written to "<path>.tmp" and renamed over <path>, so the
+ *   collector never sees a partial file
+ * - Exports counters (candidates, rejections per stage, Miller-Rabin
+ *   rounds, primes), queue depths, the chosen trial-division bound and
+ *   sieve window, a time-to-prime histogram and
+ *   p50/p90/p99 over the most recent observations
+ */
+
+#define METRICS_BUCKETS 15
+#define METRICS_RECENT  1024   /* observations kept for quantiles */
+
+static const double metrics_bucket_bounds[METRICS_BUCKETS] = {
+    1e-6, 1e-5, 1e-4, 1e-3, 0.01, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30, 60, 300
+};
+
+typedef struct {
+    const char *path;
+    const char *generator;          /* value of the "generator" label */
+    int bits;                       /* value of the "bits" label */
+    double interval_ns;
+    double last_write_ns;
+    unsigned long long buckets[METRICS_BUCKETS];  /* non-cumulative counts */
+    unsigned long long observations;
+    double sum_seconds;
+    double recent[METRICS_RECENT];
+    unsigned long long queue_pending;  /* primes still to generate in this run */
+} metrics_exporter;
+
+static inline void metrics_init(metrics_exporter *m, const char *path, double interval_seconds,
+                                const char *generator, int bits) {
+    memset(m, 0, sizeof(*m));
+    m->path = path;
+    m->generator = generator;
+    m->bits = bits;
+    m->interval_ns = interval_seconds * 1e9;
+    m->last_write_ns = bench_now_ns();
+}
+
+/* Record the time one prime took */
+static inline void metrics_observe_prime(metrics_exporter *m, double seconds) {
+    int b = 0;
+    while (b < METRICS_BUCKETS && seconds > metrics_bucket_bounds[b]) b++;
+    if (b < METRICS_BUCKETS) m->buckets[b]++;
+    m->recent[m->observations % METRICS_RECENT] = seconds;
+    m->observations++;
+    m->sum_seconds += seconds;
+}
+
+/* Write the metrics file now; returns 1 on success */
+static inline int metrics_write(metrics_exporter *m, const pg_stats *s) {
+    static const double quantiles[3] = { 0.5, 0.9, 0.99 };
+    static double sorted[METRICS_RECENT];
+    char tmp[1024];
+    char labels[256];
+    FILE *f;
+    int b, q, n;
+    unsigned long long cumulative = 0;
+
+    m->last_write_ns = bench_now_ns();
+    if (snprintf(tmp, sizeof(tmp), "%s.tmp", m->path) >= (int)sizeof(tmp)) return 0;
+    f = fopen(tmp, "w");
+    if (f == NULL) return 0;
+    snprintf(labels, sizeof(labels), "generator=\"%s\",bits=\"%d\"", m->generator, m->bits);
+
+    fprintf(f, "# HELP primegen_candidates_total Random candidates drawn.\n# TYPE primegen_candidates_total counter\n");
+    fprintf(f, "primegen_candidates_total{%s} %llu\n", labels, (unsigned long long)s->candidates);
+    fprintf(f, "# HELP primegen_rejections_total Candidates rejected, by pipeline stage.\n# TYPE primegen_rejections_total counter\n");
+    fprintf(f, "primegen_rejections_total{%s,stage=\"trial_division\"} %llu\n", labels, (unsigned long long)s->sieve_rejects);
+    fprintf(f, "primegen_rejections_total{%s,stage=\"miller_rabin\"} %llu\n", labels, (unsigned long long)s->mr_rejects);
+    fprintf(f, "# HELP primegen_mr_rounds_total Miller-Rabin rounds run.\n# TYPE primegen_mr_rounds_total counter\n");
+    fprintf(f, "primegen_mr_rounds_total{%s} %llu\n", labels, (unsigned long long)s->mr_rounds);
+    fprintf(f, "# HELP primegen_primes_total Probable primes found.\n# TYPE primegen_primes_total counter\n");
+    fprintf(f, "primegen_primes_total{%s} %llu\n", labels, (unsigned long long)s->primes);
+    fprintf(f, "# HELP primegen_trial_bound Largest small prime candidates are divided by.\n# TYPE primegen_trial_bound gauge\n");
+    fprintf(f, "primegen_trial_bound{%s} %u\n", labels, (unsigned)s->trial_bound);
+    fprintf(f, "# HELP primegen_sieve_window Odd positions per sieve window (0: no windowed sieve).\n# TYPE primegen_sieve_window gauge\n");
+    fprintf(f, "primegen_sieve_window{%s} %u\n", labels, (unsigned)s->sieve_window);
+    fprintf(f, "# HELP primegen_queue_depth Work items waiting, by queue.\n# TYPE primegen_queue_depth gauge\n");
+    fprintf(f, "primegen_queue_depth{%s,queue=\"primes_pending\"} %llu\n", labels, m->queue_pending);
+
+    fprintf(f, "# HELP primegen_time_to_prime_seconds Time to find one prime.\n# TYPE primegen_time_to_prime_seconds histogram\n");
+    for (b = 0; b < METRICS_BUCKETS; b++) {
+        cumulative += m->buckets[b];
+        fprintf(f, "primegen_time_to_prime_seconds_bucket{%s,le=\"%g\"} %llu\n", labels, metrics_bucket_bounds[b], cumulative);
+    }
+    fprintf(f, "primegen_time_to_prime_seconds_bucket{%s,le=\"+Inf\"} %llu\n", labels, m->observations);
+    fprintf(f, "primegen_time_to_prime_seconds_sum{%s} %.9f\n", labels, m->sum_seconds);
+    fprintf(f, "primegen_time_to_prime_seconds_count{%s} %llu\n", labels, m->observations);
+
+    n = m->observations < METRICS_RECENT ? (int)m->observations : METRICS_RECENT;
+    memcpy(sorted, m->recent, sizeof(double) * (size_t)n);
+    qsort(sorted, (size_t)n, sizeof(double), bench_compare_double);
+    fprintf(f, "# HELP primegen_recent_time_to_prime_seconds Time to prime over the last %d primes.\n", METRICS_RECENT);
+    fprintf(f, "# TYPE primegen_recent_time_to_prime_seconds summary\n");
+    for (q = 0; q < 3; q++) {
+        if (n > 0) {
+            int i = (int)(quantiles[q] * n + 0.999999) - 1;
+            if (i < 0) i = 0;
+            fprintf(f, "primegen_recent_time_to_prime_seconds{%s,quantile=\"%g\"} %.9f\n", labels, quantiles[q], sorted[i]);
+        } else {
+            fprintf(f, "primegen_recent_time_to_prime_seconds{%s,quantile=\"%g\"} NaN\n", labels, quantiles[q]);
+        }
+    }
+    double recent_sum = 0.0;
+    for (q = 0; q < n; q++) recent_sum += sorted[q];
+    fprintf(f, "primegen_recent_time_to_prime_seconds_sum{%s} %.9f\n", labels, recent_sum);
+    fprintf(f, "primegen_recent_time_to_prime_seconds_count{%s} %d\n", labels, n);
+    fprintf(f, "# HELP primegen_last_update_timestamp_seconds Time this file was written.\n");
+    fprintf(f, "# TYPE primegen_last_update_timestamp_seconds gauge\n");
+    fprintf(f, "primegen_last_update_timestamp_seconds{%s} %.3f\n", labels, m->last_write_ns / 1e9);
+
+    if (fclose(f) != 0) {
+        remove(tmp);
+        return 0;
+    }
+#ifdef _WIN32
+    remove(m->path);  /* rename() does not replace an existing file on Windows */
+#endif
+    if (rename(tmp, m->path) != 0) {
+        remove(tmp);
+        return 0;
+    }
+    return 1;
+}
+
+/* Write the metrics file if the interval has elapsed since the last write */
+static inline void metrics_maybe_write(metrics_exporter *m, const pg_stats *s) {
+    if (m != NULL && bench_now_ns() - m->last_write_ns >= m->interval_ns) {
+        metrics_write(m, s);
+    }
+}
+
+#endif
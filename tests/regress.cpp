@@ -0,0 +1,241 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "primegen.h"
+
+/*
+ * Regression checks for the library: every engine is compared against a
+ * slower or independent one on the same inputs
+ * - Range sieve against trial division, and both sieve modes against each
+ *   other at the top of the 64-bit range
+ * - Width dispatch against the exact 64-bit test
+ * - RNS exponentiation against the positional one
+ * - Range factorizations multiplied back together
+ * - Edge cases: n < 2, modulus 0, ECM with b2 < b1
+ * Prints each failure and exits with 1 if there was any.
+ */
+
+static int failures = 0;
+
+#define CHECK(cond, ...)                            \
+    do {                                            \
+        if (!(cond)) {                              \
+            printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+            printf(__VA_ARGS__);                    \
+            printf("\n");                           \
+            failures++;                             \
+        }                                           \
+    } while (0)
+
+static int is_prime_trial(uint64_t n) {
+    uint64_t d;
+    if (n < 2) return 0;
+    for (d = 2; d <= n / d; d++) {
+        if (n % d == 0) return 0;
+    }
+    return 1;
+}
+
+/* Primes of a range collected by the sieve callback */
+typedef struct {
+    uint64_t *p;
+    size_t count, capacity;
+    int unordered;
+} prime_list;
+
+static void collect_prime(void *user, uint64_t p) {
+    prime_list *list = (prime_list *)user;
+    if (list->count > 0 && list->p[list->count - 1] >= p) list->unordered = 1;
+    if (list->count < list->capacity) list->p[list->count] = p;
+    list->count++;
+}
+
+#define LIST_MAX 65536
+static uint64_t bucket_primes[LIST_MAX], plain_primes[LIST_MAX];
+
+static void check_range(pg_ctx *ctx) {
+    prime_list bucket = { bucket_primes, 0, LIST_MAX, 0 };
+    prime_list plain = { plain_primes, 0, LIST_MAX, 0 };
+    uint64_t lo = 0, hi = 100000, n, count = 0;
+    size_t i = 0;
+    int status;
+
+    /* Small range against trial division */
+    status = pg_sieve_range_u64(ctx, lo, hi, PG_RANGE_BUCKET, collect_prime, &bucket, &count);
+    CHECK(status == PG_OK, "sieve [%llu, %llu]: status %d", (unsigned long long)lo, (unsigned long long)hi, status);
+    CHECK(!bucket.unordered && count == bucket.count, "sieve [0, 100000]: order or count");
+    for (n = lo; n <= hi; n++) {
+        if (!is_prime_trial(n)) continue;
+        CHECK(i < bucket.count && bucket.p[i] == n, "sieve [0, 100000]: missing %llu", (unsigned long long)n);
+        while (i < bucket.count && bucket.p[i] <= n) i++;
+    }
+    CHECK(i == bucket.count, "sieve [0, 100000]: %zu extra primes", bucket.count - i);
+
+    /* Both modes at the top of the range, where the segment arithmetic can wrap */
+    lo = UINT64_MAX - (1 << 20);
+    hi = UINT64_MAX;
+    bucket.count = plain.count = 0;
+    pg_sieve_range_u64(ctx, lo, hi, PG_RANGE_BUCKET, collect_prime, &bucket, NULL);
+    pg_sieve_range_u64(ctx, lo, hi, PG_RANGE_PLAIN, collect_prime, &plain, NULL);
+    CHECK(bucket.count > 0 && bucket.count == plain.count, "top of range: %zu bucket, %zu plain primes",
+          bucket.count, plain.count);
+    CHECK(!bucket.unordered && !plain.unordered, "top of range: primes out of order");
+    for (i = 0; i < bucket.count && i < plain.count && i < LIST_MAX; i++) {
+        if (bucket.p[i] != plain.p[i] || !pg_is_prime_u64(bucket.p[i])) break;
+    }
+    CHECK(i == bucket.count, "top of range: prime %zu differs or is composite", i);
+}
+
+static void check_dispatch(pg_ctx *ctx) {
+    /* strong pseudoprimes to small bases, and Carmichael numbers */
+    static const uint64_t hard[] = { 2047, 1373653, 25326001, 3215031751ULL, 2152302898747ULL,
+                                     3474749660383ULL, 341550071728321ULL, 3825123056546413051ULL,
+                                     561, 41041, 825265, 321197185, 18446744073709551557ULL,
+                                     4294967291ULL, 4294967297ULL, 4759123141ULL };
+    pg_bigint n;
+    uint64_t v;
+    int bits, k, width;
+    size_t i;
+
+    for (v = 0; v < 5000; v++) {
+        pg_bigint_set_u64(&n, v);
+        CHECK(pg_is_prime_auto(ctx, &n, 0, NULL) == pg_is_prime_u64(v), "auto(%llu)", (unsigned long long)v);
+    }
+    for (i = 0; i < sizeof(hard) / sizeof(hard[0]); i++) {
+        pg_bigint_set_u64(&n, hard[i]);
+        CHECK(pg_is_prime_auto(ctx, &n, 0, NULL) == pg_is_prime_u64(hard[i]), "auto(%llu)",
+              (unsigned long long)hard[i]);
+    }
+    for (bits = 2; bits <= 64; bits++) {
+        for (k = 0; k < 200; k++) {
+            pg_bigint_random(ctx, &n, bits);
+            v = ((uint64_t)n.words[1] << 32) | n.words[0];
+            /* every other one odd, so primes turn up */
+            if (k & 1) v |= 1;
+            pg_bigint_set_u64(&n, v);
+            CHECK(pg_is_prime_auto(ctx, &n, 0, &width) == pg_is_prime_u64(v), "auto(%llu)", (unsigned long long)v);
+            CHECK(width <= PG_WIDTH_64, "auto(%llu): width %d", (unsigned long long)v, width);
+        }
+    }
+}
+
+static void check_rns(pg_ctx *ctx) {
+    static const int sizes[] = { 64, 160, 256, 512, 1000, 1024 };
+    pg_bigint base, exp, mod, r1, r2;
+    size_t i;
+    int k;
+
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        for (k = 0; k < 4; k++) {
+            pg_bigint_random(ctx, &mod, sizes[i]);
+            /* odd moduli take the RNS path, even ones the fallback */
+            if (k < 3) mod.words[0] |= 1;
+            else mod.words[0] &= ~1U;
+            pg_bigint_random(ctx, &base, sizes[i] - 1);
+            pg_bigint_random(ctx, &exp, sizes[i]);
+            pg_bigint_mod_exp(&r1, &base, &exp, &mod);
+            pg_bigint_mod_exp_rns(&r2, &base, &exp, &mod);
+            CHECK(pg_bigint_cmp(&r1, &r2) == 0, "mod_exp_rns differs at %d bits (modulus %s)", sizes[i],
+                  k < 3 ? "odd" : "even");
+        }
+    }
+}
+
+/* State of the factorization callback */
+typedef struct {
+    uint64_t next;
+    int bad;
+} factor_check;
+
+static void check_factors(void *user, uint64_t n, const pg_factor *factors, int count) {
+    factor_check *fc = (factor_check *)user;
+    uint64_t product = 1;
+    int i;
+    uint32_t e;
+
+    if (n != fc->next) fc->bad = 1;
+    fc->next = n + 1;
+    for (i = 0; i < count; i++) {
+        if (!pg_is_prime_u64(factors[i].prime) || factors[i].exponent == 0) fc->bad = 1;
+        if (i > 0 && factors[i - 1].prime >= factors[i].prime) fc->bad = 1;
+        for (e = 0; e < factors[i].exponent; e++) product *= factors[i].prime;
+    }
+    if (n < 2 ? count != 0 : product != n) {
+        printf("FAIL factor-range: %llu does not remultiply\n", (unsigned long long)n);
+        fc->bad = 1;
+    }
+}
+
+static void check_factor_range(pg_ctx *ctx) {
+    factor_check fc;
+    int status;
+
+    fc.next = 0;
+    fc.bad = 0;
+    status = pg_factor_range_u64(ctx, 0, 200000, 1, check_factors, &fc);
+    CHECK(status == PG_OK && !fc.bad && fc.next == 200001, "factor-range [0, 200000]");
+
+    fc.next = UINT64_MAX - 50000;
+    fc.bad = 0;
+    status = pg_factor_range_u64(ctx, fc.next, UINT64_MAX, 1, check_factors, &fc);
+    CHECK(status == PG_OK && !fc.bad && fc.next == 0, "factor-range at the top of the 64-bit range");
+}
+
+static void check_edges(pg_ctx *ctx) {
+    uint64_t n[2] = { 0, 1 }, a[2] = { 2, 3 };
+    int passed[2] = { -1, -1 };
+    pg_bigint big;
+
+    CHECK(pg_mulmod_u64(3, 4, 0) == 0 && pg_powmod_u64(3, 4, 0) == 0, "modulus 0");
+    CHECK(pg_mr_witness_u64(0, 2) == 0 && pg_mr_witness_u64(1, 2) == 0 && pg_mr_witness_u64(1, 0) == 0, "witness n < 2");
+    pg_mr_witness_batch_u64(n, a, passed, 2);
+    CHECK(passed[0] == 0 && passed[1] == 0, "batch witness n < 2");
+    CHECK(!pg_is_prime_u64(0) && !pg_is_prime_u64(1) && pg_is_prime_u64(2), "pg_is_prime_u64 at 0, 1, 2");
+    CHECK(!pg_is_probable_prime_u64(ctx, 0, 4) && !pg_is_probable_prime_u64(ctx, 1, 4), "probable prime n < 2");
+    pg_bigint_set_u64(&big, 1);
+    CHECK(pg_is_prime_auto(ctx, &big, 0, NULL) == 0, "auto(1)");
+}
+
+static void check_ecm(pg_ctx *ctx) {
+    pg_bigint p, q, n, r;
+    pg_bigint_wide wide;
+    pg_ecm_params params;
+    pg_ecm_result result;
+    int status;
+
+    pg_generate_prime_big(ctx, 40, 5, &p);
+    pg_generate_prime_big(ctx, 40, 5, &q);
+    pg_bigint_mul(&wide, &p, &q);
+    memcpy(n.words, wide.words, sizeof(n.words));
+
+    /* b2 below b1: stage 1 only, the prime bitmap still has to cover b1 */
+    params.b1 = 200000;
+    params.b2 = 1000;
+    params.curves = 8;
+    params.threads = 1;
+    status = pg_ecm_big(ctx, &n, &params, &result);
+    CHECK(status == 0 || status == 1, "ecm b2 < b1: status %d", status);
+    CHECK(status != 1 || result.stage <= 1, "ecm b2 < b1: found in stage %d", result.stage);
+    if (status == 1) {
+        pg_bigint_mod_words(&r, n.words, PG_BIGINT_WORDS, &result.factor);
+        CHECK(pg_bigint_bit_length(&r) == 0, "ecm b2 < b1: factor does not divide n");
+    }
+}
+
+int main(void) {
+    pg_ctx *ctx = pg_ctx_create(1, 0);
+    if (!ctx) return 1;
+    check_range(ctx);
+    check_dispatch(ctx);
+    check_rns(ctx);
+    check_factor_range(ctx);
+    check_edges(ctx);
+    check_ecm(ctx);
+    pg_ctx_destroy(ctx);
+    if (failures) {
+        printf("%d failures\n", failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
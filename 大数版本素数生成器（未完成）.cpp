@@ -1,456 +1,512 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <time.h>
-
-/*
- * 1024-bit prime generator using Miller-Rabin test
- * - Only uses stdio, stdlib, time (as required)
- * - Implements big integer arithmetic (1024-bit)
- * - Uses small-prime trial division for quick filtering
- * - Generates random 1024-bit prime
- * - Saves generated prime in hex to "prime1024.txt"
- */
-
-/* 1024-bit number represented as array of 32-bit words */
-/* 1024 bits = 32 words of 32 bits */
-#define WORDS_COUNT 32
-typedef struct {
-    unsigned int words[WORDS_COUNT];
-} bigint1024;
-
-/* Small primes for quick filtering */
-static const unsigned int small_primes[] = {
-    2,3,5,7,11,13,17,19,23,29,
-    31,37,41,43,47,53,59,61,67,71,
-    73,79,83,89,97,101,103,107,109,113,
-    127,131,137,139,149,151,157,163,167,173,
-    179,181,191,193,197,199
-};
-static const int small_primes_count = 46;
-
-/* Utility functions */
-static void bigint_zero(bigint1024 *a) {
-    int i;
-    for (i = 0; i < WORDS_COUNT; i++) {
-        a->words[i] = 0;
-    }
-}
-
-static void bigint_set_u32(bigint1024 *a, unsigned int val) {
-    bigint_zero(a);
-    a->words[0] = val;
-}
-
-static int bigint_is_zero(const bigint1024 *a) {
-    int i;
-    for (i = 0; i < WORDS_COUNT; i++) {
-        if (a->words[i] != 0) return 0;
-    }
-    return 1;
-}
-
-static int bigint_is_one(const bigint1024 *a) {
-    int i;
-    if (a->words[0] != 1) return 0;
-    for (i = 1; i < WORDS_COUNT; i++) {
-        if (a->words[i] != 0) return 0;
-    }
-    return 1;
-}
-
-static int bigint_is_even(const bigint1024 *a) {
-    return (a->words[0] & 1) == 0;
-}
-
-static void bigint_copy(bigint1024 *dst, const bigint1024 *src) {
-    int i;
-    for (i = 0; i < WORDS_COUNT; i++) {
-        dst->words[i] = src->words[i];
-    }
-}
-
-/* Compare two big integers: return 1 if a > b, 0 if a == b, -1 if a < b */
-static int bigint_compare(const bigint1024 *a, const bigint1024 *b) {
-    int i;
-    for (i = WORDS_COUNT - 1; i >= 0; i--) {
-        if (a->words[i] > b->words[i]) return 1;
-        if (a->words[i] < b->words[i]) return -1;
-    }
-    return 0;
-}
-
-/* Generate random 1024-bit number */
-static void bigint_rand(bigint1024 *a) {
-    int i;
-    for (i = 0; i < WORDS_COUNT; i++) {
-        /* Generate 32-bit random value */
-        a->words[i] = ((unsigned int)rand() << 16) ^ (unsigned int)rand();
-    }
-}
-
-/* Generate random 1024-bit odd number with high bit set */
-static void bigint_rand_odd_1024(bigint1024 *a) {
-    bigint_rand(a);
-    /* Set highest bit to ensure it's 1024 bits */
-    a->words[WORDS_COUNT-1] |= 0x80000000U;
-    /* Make it odd */
-    a->words[0] |= 1;
-}
-
-/* Left shift by 1 bit */
-static void bigint_shl_one(bigint1024 *a) {
-    unsigned int carry = 0;
-    int i;
-    for (i = 0; i < WORDS_COUNT; i++) {
-        unsigned int next_carry = a->words[i] >> 31;
-        a->words[i] = (a->words[i] << 1) | carry;
-        carry = next_carry;
-    }
-}
-
-/* Right shift by 1 bit */
-static void bigint_shr_one(bigint1024 *a) {
-    unsigned int carry = 0;
-    int i;
-    for (i = WORDS_COUNT - 1; i >= 0; i--) {
-        unsigned int next_carry = a->words[i] & 1;
-        a->words[i] = (a->words[i] >> 1) | (carry << 31);
-        carry = next_carry;
-    }
-}
-
-/* Add two big integers: c = a + b, returns carry */
-static unsigned int bigint_add(bigint1024 *c, const bigint1024 *a, const bigint1024 *b) {
-    unsigned long long sum = 0;
-    int i;
-    for (i = 0; i < WORDS_COUNT; i++) {
-        sum = sum + (unsigned long long)a->words[i] + (unsigned long long)b->words[i];
-        c->words[i] = (unsigned int)sum;
-        sum = sum >> 32;
-    }
-    return (unsigned int)sum;
-}
-
-/* Subtract: c = a - b, assumes a >= b */
-static void bigint_sub(bigint1024 *c, const bigint1024 *a, const bigint1024 *b) {
-    unsigned long long borrow = 0;
-    int i;
-    for (i = 0; i < WORDS_COUNT; i++) {
-        unsigned long long diff = (unsigned long long)a->words[i] - (unsigned long long)b->words[i] - borrow;
-        c->words[i] = (unsigned int)diff;
-        borrow = (diff >> 32) & 1;
-    }
-}
-
-/* Helper: check if a >= b */
-static int bigint_gte(const bigint1024 *a, const bigint1024 *b) {
-    return bigint_compare(a, b) >= 0;
-}
-
-/* Multiply: c = a * b (simple schoolbook multiplication) */
-static void bigint_mul(bigint1024 *c, const bigint1024 *a, const bigint1024 *b) {
-    bigint_zero(c);
-    unsigned long long temp[WORDS_COUNT * 2] = {0};
-    int i, j;
-    
-    for (i = 0; i < WORDS_COUNT; i++) {
-        unsigned long long carry = 0;
-        for (j = 0; j < WORDS_COUNT; j++) {
-            unsigned long long product = (unsigned long long)a->words[i] * (unsigned long long)b->words[j] + temp[i+j] + carry;
-            temp[i+j] = product & 0xFFFFFFFFULL;
-            carry = product >> 32;
-        }
-        if (i + WORDS_COUNT < WORDS_COUNT * 2) {
-            temp[i + WORDS_COUNT] = carry;
-        }
-    }
-    
-    /* Copy result to c (only lower 1024 bits) */
-    for (i = 0; i < WORDS_COUNT; i++) {
-        c->words[i] = (unsigned int)temp[i];
-    }
-}
-
-/* Modular multiplication: c = (a * b) mod n */
-static void bigint_mod_mul(bigint1024 *c, const bigint1024 *a, const bigint1024 *b, const bigint1024 *n) {
-    /* Simple implementation: multiply then reduce */
-    bigint1024 prod;
-    bigint_mul(&prod, a, b);
-    
-    /* Reduce modulo n using repeated subtraction */
-    bigint1024 rem, n_shifted, two;
-    bigint_copy(&rem, &prod);
-    bigint_copy(&n_shifted, n);
-    
-    /* Find shift count to align n with rem */
-    int shift = 0;
-    bigint_set_u32(&two, 2);
-    
-    while (bigint_compare(&n_shifted, &rem) < 0) {
-        bigint_shl_one(&n_shifted);
-        shift++;
-    }
-    
-    /* Repeated subtraction */
-    while (shift >= 0) {
-        if (bigint_compare(&rem, &n_shifted) >= 0) {
-            bigint_sub(&rem, &rem, &n_shifted);
-        }
-        bigint_shr_one(&n_shifted);
-        shift--;
-    }
-    
-    bigint_copy(c, &rem);
-}
-
-/* Modular exponentiation: c = (base^exp) mod mod */
-static void bigint_mod_exp(bigint1024 *c, const bigint1024 *base, const bigint1024 *exp, const bigint1024 *mod) {
-    bigint1024 result, b, e;
-    bigint_set_u32(&result, 1);
-    bigint_copy(&b, base);
-    bigint_copy(&e, exp);
-    
-    while (!bigint_is_zero(&e)) {
-        if (e.words[0] & 1) {
-            bigint_mod_mul(&result, &result, &b, mod);
-        }
-        bigint_mod_mul(&b, &b, &b, mod);
-        bigint_shr_one(&e);
-    }
-    
-    bigint_copy(c, &result);
-}
-
-/* Check if a is divisible by small prime p */
-static int bigint_divisible_by_small_prime(const bigint1024 *a, unsigned int p) {
-    /* Compute a mod p using Horner's method */
-    unsigned long long rem = 0;
-    int i;
-    for (i = WORDS_COUNT - 1; i >= 0; i--) {
-        rem = ((rem << 32) | a->words[i]) % p;
-    }
-    return rem == 0;
-}
-
-/* Miller-Rabin witness test */
-static int miller_rabin_witness_1024(const bigint1024 *n, const bigint1024 *a) {
-    /* Check if a >= n */
-    if (bigint_compare(a, n) >= 0) {
-        bigint1024 temp;
-        bigint_copy(&temp, a);
-        while (bigint_compare(&temp, n) >= 0) {
-            bigint_sub(&temp, &temp, n);
-        }
-        if (bigint_is_zero(&temp)) return 1;
-        bigint_copy((bigint1024*)a, &temp); /* Use the reduced value */
-    }
-    
-    /* Write n-1 = d * 2^s */
-    bigint1024 d, n_minus_1;
-    bigint_copy(&n_minus_1, n);
-    bigint1024 one;
-    bigint_set_u32(&one, 1);
-    bigint_sub(&n_minus_1, n, &one);
-    bigint_copy(&d, &n_minus_1);
-    
-    int s = 0;
-    while (bigint_is_even(&d)) {
-        bigint_shr_one(&d);
-        s++;
-    }
-    
-    /* Compute x = a^d mod n */
-    bigint1024 x;
-    bigint_mod_exp(&x, a, &d, n);
-    
-    if (bigint_is_one(&x) || bigint_compare(&x, &n_minus_1) == 0) {
-        return 1;
-    }
-    
-    int r;
-    for (r = 1; r < s; r++) {
-        bigint_mod_mul(&x, &x, &x, n);
-        if (bigint_compare(&x, &n_minus_1) == 0) {
-            return 1;
-        }
-    }
-    
-    return 0;
-}
-
-/* Generate random a in [2, n-2] */
-static void bigint_rand_range(bigint1024 *a, const bigint1024 *n) {
-    bigint1024 n_minus_3;
-    bigint_copy(&n_minus_3, n);
-    bigint1024 three;
-    bigint_set_u32(&three, 3);
-    bigint_sub(&n_minus_3, n, &three);
-    
-    /* Generate random number */
-    bigint_rand(a);
-    
-    /* Reduce modulo (n-3) */
-    bigint1024 temp;
-    bigint_copy(&temp, a);
-    while (bigint_compare(&temp, &n_minus_3) >= 0) {
-        bigint_sub(&temp, &temp, &n_minus_3);
-    }
-    
-    /* Add 2 to get range [2, n-2] */
-    bigint1024 two;
-    bigint_set_u32(&two, 2);
-    bigint_add(a, &temp, &two);
-}
-
-/* Check if number is probably prime using Miller-Rabin */
-static int is_probable_prime_1024(const bigint1024 *n, int rounds) {
-    int i;
-    
-    /* Small prime check */
-    for (i = 0; i < small_primes_count; i++) {
-        if (bigint_divisible_by_small_prime(n, small_primes[i])) {
-            /* Check if n equals the small prime */
-            bigint1024 p_val;
-            bigint_set_u32(&p_val, small_primes[i]);
-            if (bigint_compare(n, &p_val) == 0) {
-                return 1;
-            }
-            return 0;
-        }
-    }
-    
-    /* Miller-Rabin test with random bases */
-    bigint1024 a;
-    for (i = 0; i < rounds; i++) {
-        /* Generate random a in [2, n-2] */
-        bigint_rand_range(&a, n);
-        
-        if (!miller_rabin_witness_1024(n, &a)) {
-            return 0;
-        }
-    }
-    
-    return 1;
-}
-
-/* Convert bigint to hex string */
-static void bigint_to_hex(const bigint1024 *a, char *buf, int buf_size) {
-    int i;
-    int pos = 0;
-    int leading_zero = 1;
-    
-    for (i = WORDS_COUNT - 1; i >= 0; i--) {
-        if (leading_zero && a->words[i] == 0) {
-            continue;
-        }
-        
-        if (leading_zero) {
-            pos += snprintf(buf + pos, buf_size - pos, "%x", a->words[i]);
-            leading_zero = 0;
-        } else {
-            pos += snprintf(buf + pos, buf_size - pos, "%08x", a->words[i]);
-        }
-    }
-    
-    if (leading_zero) {
-        snprintf(buf, buf_size, "0");
-    }
-}
-
-/* Display progress */
-static void display_progress(int attempts, time_t start_time) {
-    double elapsed = difftime(time(NULL), start_time);
-    printf("\rAttempts: %d, Time: %.1f seconds", attempts, elapsed);
-    fflush(stdout);
-}
-
-/* Generate 1024-bit prime within time limit (2 minutes) */
-static void generate_1024bit_prime(void) {
-    time_t start_time = time(NULL);
-    time_t time_limit = 120; /* 2 minutes */
-    int attempts = 0;
-    int rounds = 10; /* Miller-Rabin rounds */
-    
-    printf("Generating 1024-bit prime ...\n");
-    
-    while (1) {
-        attempts++;
- 
-        /* Display progress every 100 attempts */
-        if (attempts % 100 == 0) {
-            display_progress(attempts, start_time);
-        }
-        
-        /* Generate random odd 1024-bit number */
-        bigint1024 candidate;
-        bigint_rand_odd_1024(&candidate);
-        
-        /* Quick divisibility test with small primes */
-        int divisible = 0;
-        int i;
-        for (i = 0; i < small_primes_count; i++) {
-            if (bigint_divisible_by_small_prime(&candidate, small_primes[i])) {
-                divisible = 1;
-                break;
-            }
-        }
-        
-        if (divisible) {
-            continue;
-        }
-        
-        /* Miller-Rabin primality test */
-        if (is_probable_prime_1024(&candidate, rounds)) {
-            time_t end_time = time(NULL);
-            double elapsed = difftime(end_time, start_time);
-            
-            printf("\n\nFound probable 1024-bit prime after %d attempts in %.1f seconds\n", 
-                   attempts, elapsed);
-            
-            /* Convert to hex and display */
-            char hex_buf[1024];
-            bigint_to_hex(&candidate, hex_buf, sizeof(hex_buf));
-            printf("Prime (hex): 0x%s\n", hex_buf);
-            
-            /* Count bits */
-            int bit_count = 0;
-            for (i = 0; hex_buf[i] != '\0'; i++) {
-                char c = hex_buf[i];
-                if (c >= '0' && c <= '9') bit_count += 4;
-                else if (c >= 'a' && c <= 'f') bit_count += 4;
-                else if (c >= 'A' && c <= 'F') bit_count += 4;
-            }
-            printf("Bit length: %d bits\n", bit_count);
-            
-            /* Save to file */
-            FILE *f = fopen("prime1024.txt", "w");
-            if (f != NULL) {
-                fprintf(f, "0x%s\n", hex_buf);
-                fclose(f);
-                printf("Saved prime in hex to prime1024.txt\n");
-            } else {
-                printf("Failed to open prime1024.txt for writing\n");
-            }
-            
-            return;
-        }
-        
-        /* Reseed occasionally to avoid getting stuck */
-        if (attempts % 1000 == 0) {
-            srand((unsigned)time(NULL) + attempts);
-        }
-    }
-}
-
-int main() {
-    srand((unsigned)time(NULL));
-    
-    printf("=============================================\n");
-    printf("   1024-bit Prime Generator (Miller-Rabin)   \n");
-    printf("=============================================\n\n");
-    
-    generate_1024bit_prime();
-    
-    printf("\nDone.\n");
-    return 0;
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "primegen.h"
+#include "prime_bench.h"
+#include "prime_trace.h"
+#include "prime_metrics.h"
+
+/*
+ * 1024-bit prime generator using Miller-Rabin test
+ * - Thin front-end over the primegen library (lib/primegen.h), which
+ *   implements the 1024-bit arithmetic, trial division and testing
+ * - Uses small-prime trial division for quick filtering
+ * - Generates random 1024-bit prime
+ * - Saves generated prime in hex to "prime1024.txt"
+ * - --strong builds a strong prime instead: p - 1, p + 1 and r - 1 for
+ *   the factor r of p - 1 all have large prime factors (Gordon)
+ * - --test HEX checks a given number instead: exact up to 64 bits, otherwise
+ *   Baillie-PSW, on the narrowest engine (32, 64, 128 bits or big integer)
+ * - --factor HEX looks for a factor of a given number with ECM, or splits
+ *   it with the self-initializing quadratic sieve when --siqs is given
+ * - Candidates and bases come from a counter-based RNG stream of the
+ *   master seed (--seed N), so a run can be replayed exactly
+ * - --bench-kernels runs microbenchmarks of the arithmetic kernels and
+ *   prints the results as JSON
+ * - --bench-gen N generates N primes and prints throughput statistics as JSON;
+ *   with --perf it adds per-stage hardware counters (Linux perf_event_open)
+ * - USDT probes (prime_trace.h) mark candidates, sieve rejections,
+ *   Miller-Rabin rounds and found primes for bpftrace
+ * - --metrics-file PATH makes --bench-gen write Prometheus text-format
+ *   metrics every --metrics-interval seconds
+ */
+
+/* RNG stream kinds; stream index = kind << 32 */
+#define STREAM_GENERATE 2ULL
+#define STREAM_BENCH    3ULL
+
+/* Parse a seed in decimal or 0x-prefixed hex; returns 1 if the whole string was a number */
+static int parse_seed(const char *val, unsigned long long *seed) {
+    char *endptr;
+    *seed = strtoull(val, &endptr, 0);
+    return endptr != val && *endptr == '\0';
+}
+
+/* Display progress every 100 attempts (pg_progress_fn) */
+static void display_progress(void *user, const pg_stats *stats) {
+    double elapsed = difftime(time(NULL), *(const time_t *)user);
+    printf("\rAttempts: %llu, Time: %.1f seconds", (unsigned long long)stats->candidates, elapsed);
+    fflush(stdout);
+}
+
+/* Generate a 1024-bit prime (a strong one with 'strong'), display and save to file */
+static void generate_1024bit_prime(pg_ctx *ctx, int strong) {
+    time_t start_time = time(NULL);
+    pg_stats stats;
+    pg_bigint candidate;
+    pg_strong_prime sp;
+    
+    printf("Generating 1024-bit %sprime ...\n", strong ? "strong " : "");
+    
+    pg_ctx_reset_stats(ctx);
+    pg_ctx_set_progress(ctx, display_progress, &start_time, 100);
+    if (strong) {
+        pg_generate_strong_prime_big(ctx, 1024, PG_DEFAULT_ROUNDS, &sp);
+        candidate = sp.p;
+    } else {
+        pg_generate_prime_big(ctx, 1024, PG_DEFAULT_ROUNDS, &candidate);
+    }
+    pg_ctx_set_progress(ctx, NULL, NULL, 0);
+    pg_ctx_get_stats(ctx, &stats);
+    
+    time_t end_time = time(NULL);
+    double elapsed = difftime(end_time, start_time);
+    
+    printf("\n\nFound probable 1024-bit prime after %llu attempts in %.1f seconds\n", 
+           (unsigned long long)stats.candidates, elapsed);
+    
+    /* Convert to hex and display */
+    char hex_buf[PG_BIGINT_BITS / 4 + 1];
+    pg_bigint_to_hex(&candidate, hex_buf, sizeof(hex_buf));
+    printf("Prime (hex): 0x%s\n", hex_buf);
+    printf("Bit length: %d bits\n", pg_bigint_bit_length(&candidate));
+    if (strong) {
+        printf("Large prime factors: %d bits of p - 1, %d bits of p + 1, %d bits of r - 1\n",
+               pg_bigint_bit_length(&sp.r), pg_bigint_bit_length(&sp.s), pg_bigint_bit_length(&sp.t));
+    }
+    
+    /* Save to file */
+    FILE *f = fopen("prime1024.txt", "w");
+    if (f != NULL) {
+        fprintf(f, "0x%s\n", hex_buf);
+        fclose(f);
+        printf("Saved prime in hex to prime1024.txt\n");
+    } else {
+        printf("Failed to open prime1024.txt for writing\n");
+    }
+}
+
+/* Test an externally supplied number on the narrowest engine that holds it:
+ * exact up to 64 bits, Baillie-PSW above */
+static int test_input_hex(pg_ctx *ctx, const char *hex) {
+    pg_bigint n;
+    char hex_buf[PG_BIGINT_BITS / 4 + 1];
+    uint32_t p;
+    int result, width;
+
+    if (pg_bigint_from_hex(&n, hex) != PG_OK) {
+        printf("Not a hex number of at most %d bits: %s\n", PG_BIGINT_BITS, hex);
+        return 1;
+    }
+    pg_bigint_to_hex(&n, hex_buf, sizeof(hex_buf));
+    printf("Testing n = 0x%s (%d bits)\n", hex_buf, pg_bigint_bit_length(&n));
+    p = pg_small_prime_divisor_big(&n);
+    if (p != 0 && pg_bigint_bit_length(&n) > 32) {
+        printf("Divisible by small prime %u -> composite\n", p);
+        return 0;
+    }
+    result = pg_is_prime_auto(ctx, &n, 0, &width);
+    if (width <= PG_WIDTH_64) {
+        printf("Deterministic test (%d-bit engine): %s\n", width, result ? "prime" : "composite");
+    } else {
+        printf("Baillie-PSW (strong base-2 + strong Lucas, %d-bit engine): %s\n", width,
+               result ? "probable prime" : "composite");
+    }
+    return 0;
+}
+
+/* Look for a factor of an externally supplied number with ECM */
+static int factor_input_hex(pg_ctx *ctx, const char *hex, const pg_ecm_params *params) {
+    pg_bigint n;
+    pg_ecm_result result;
+    char hex_buf[PG_BIGINT_BITS / 4 + 1];
+    time_t start = time(NULL);
+    int status;
+
+    if (pg_bigint_from_hex(&n, hex) != PG_OK) {
+        printf("Not a hex number of at most %d bits: %s\n", PG_BIGINT_BITS, hex);
+        return 1;
+    }
+    pg_bigint_to_hex(&n, hex_buf, sizeof(hex_buf));
+    printf("Factoring n = 0x%s (%d bits)\n", hex_buf, pg_bigint_bit_length(&n));
+    printf("ECM: B1 = %u, B2 = %llu, up to %u curves\n", params->b1,
+           (unsigned long long)(params->b2 ? params->b2 : 100ULL * params->b1), params->curves);
+    status = pg_ecm_big(ctx, &n, params, &result);
+    if (status < 0) {
+        printf("ECM failed: %s\n", pg_strerror(status));
+        return 1;
+    }
+    if (status == 0) {
+        if (pg_is_probable_prime_bpsw_big(ctx, &n, 0)) printf("n is a probable prime, nothing to factor\n");
+        else printf("No factor found after %u curves in %.0f seconds\n", result.curves, difftime(time(NULL), start));
+        return 0;
+    }
+    pg_bigint_to_hex(&result.factor, hex_buf, sizeof(hex_buf));
+    if (result.stage == 0) printf("Found factor by trial division\n");
+    else printf("Found factor in stage %d of curve sigma = %u after %u curves in %.0f seconds\n", result.stage,
+                result.sigma, result.curves, difftime(time(NULL), start));
+    printf("Factor: 0x%s (%d bits), %s\n", hex_buf, pg_bigint_bit_length(&result.factor),
+           pg_is_probable_prime_bpsw_big(ctx, &result.factor, 0) ? "probable prime" : "composite");
+    return 0;
+}
+
+/* Split an externally supplied number with the quadratic sieve */
+static int siqs_input_hex(pg_ctx *ctx, const char *hex, uint32_t threads) {
+    pg_bigint n;
+    pg_siqs_result result;
+    char hex_buf[PG_BIGINT_BITS / 4 + 1];
+    time_t start = time(NULL);
+    int status;
+
+    if (pg_bigint_from_hex(&n, hex) != PG_OK || pg_bigint_bit_length(&n) > PG_SIQS_MAX_BITS) {
+        printf("Not a hex number of at most %d bits: %s\n", PG_SIQS_MAX_BITS, hex);
+        return 1;
+    }
+    pg_bigint_to_hex(&n, hex_buf, sizeof(hex_buf));
+    printf("Factoring n = 0x%s (%d bits) with SIQS\n", hex_buf, pg_bigint_bit_length(&n));
+    status = pg_siqs_big(ctx, &n, threads, &result);
+    if (status < 0) {
+        printf("SIQS failed: %s\n", pg_strerror(status));
+        return 1;
+    }
+    if (status == 0) {
+        if (pg_is_probable_prime_bpsw_big(ctx, &n, 0)) printf("n is a probable prime, nothing to factor\n");
+        else printf("No dependency split n; rerun with another --seed\n");
+        return 0;
+    }
+    if (result.factor_base > 0) {
+        printf("Multiplier %u, %u primes in the factor base, %u relations from %llu polynomials in %.0f seconds\n",
+               result.multiplier, result.factor_base, result.relations, (unsigned long long)result.polynomials,
+               difftime(time(NULL), start));
+    }
+    pg_bigint_to_hex(&result.factor, hex_buf, sizeof(hex_buf));
+    printf("Factor: 0x%s (%d bits), %s\n", hex_buf, pg_bigint_bit_length(&result.factor),
+           pg_is_probable_prime_bpsw_big(ctx, &result.factor, 0) ? "probable prime" : "composite");
+    pg_bigint_to_hex(&result.cofactor, hex_buf, sizeof(hex_buf));
+    printf("Cofactor: 0x%s (%d bits), %s\n", hex_buf, pg_bigint_bit_length(&result.cofactor),
+           pg_is_probable_prime_bpsw_big(ctx, &result.cofactor, 0) ? "probable prime" : "composite");
+    return 0;
+}
+
+/* Generate 'count' 1024-bit primes, each from its own RNG stream, and report throughput as JSON.
+ * With use_perf, per-stage hardware counters are added to the report;
+ * metrics (may be NULL) is updated after every prime. */
+static void bench_generation(pg_ctx *ctx, unsigned long long seed, int count, int use_perf, metrics_exporter *metrics,
+                             FILE *out) {
+    int rounds = PG_DEFAULT_ROUNDS;
+    pg_stats stats;
+    pg_perf_report perf;
+    double *times = (double *)malloc(sizeof(double) * (size_t)count);
+    double survive;
+    double start, total;
+    int i;
+    
+    if (times == NULL) {
+        printf("Out of memory\n");
+        return;
+    }
+    if (use_perf && !pg_ctx_enable_perf(ctx)) {
+        fprintf(stderr, "perf_event_open unavailable; reporting without hardware counters\n");
+    }
+    
+    pg_ctx_reset_stats(ctx);
+    start = bench_now_ns();
+    TRACE_BATCH_START(0, count);
+    for (i = 0; i < count; i++) {
+        pg_bigint prime;
+        pg_ctx_set_stream(ctx, seed, (STREAM_BENCH << 32) | (unsigned long long)i);
+        double t0 = bench_now_ns();
+        pg_generate_prime_big(ctx, 1024, rounds, &prime);
+        times[i] = bench_now_ns() - t0;
+        if (metrics) {
+            pg_ctx_get_stats(ctx, &stats);
+            metrics->queue_pending = (unsigned long long)(count - i - 1);
+            metrics_observe_prime(metrics, times[i] / 1e9);
+            metrics_maybe_write(metrics, &stats);
+        }
+    }
+    pg_ctx_get_stats(ctx, &stats);
+    if (metrics && !metrics_write(metrics, &stats)) {
+        fprintf(stderr, "Failed to write metrics file %s\n", metrics->path);
+    }
+    total = bench_now_ns() - start;
+    /* fraction of odd numbers divisible by an odd prime up to the final sieve bound */
+    survive = pg_trial_survival(stats.trial_bound);
+    TRACE_BATCH_END(0, stats.primes, stats.candidates);
+    pg_ctx_get_perf(ctx, &perf);
+    bench_write_gen_report(out, "generate_1024bit_prime", 1024, seed, rounds, times, count, &stats, total, 1.0 - survive,
+                           use_perf ? &perf : NULL);
+    free(times);
+}
+
+/* Kernel microbenchmarks (--bench-kernels) */
+
+/* Operands for one benchmark width; results are chained back into the
+ * inputs so the compiler cannot hoist the kernel out of the loop */
+typedef struct {
+    int bits;
+    pg_bigint a, b, n, e;
+    pg_bigint_wide wide;
+    unsigned int sink;
+} bench_operands;
+
+typedef struct {
+    const char *name;
+    void (*run)(void *state, long iters);
+} bench_kernel;
+
+static void bench_add(void *state, long iters) {
+    bench_operands *o = (bench_operands *)state;
+    long i;
+    for (i = 0; i < iters; i++) {
+        o->sink += pg_bigint_add(&o->a, &o->a, &o->b);
+    }
+    o->sink += o->a.words[0];
+}
+
+static void bench_sub(void *state, long iters) {
+    bench_operands *o = (bench_operands *)state;
+    long i;
+    for (i = 0; i < iters; i++) {
+        pg_bigint_sub(&o->a, &o->a, &o->b);
+    }
+    o->sink += o->a.words[0];
+}
+
+static void bench_mul(void *state, long iters) {
+    bench_operands *o = (bench_operands *)state;
+    long i;
+    for (i = 0; i < iters; i++) {
+        pg_bigint_mul(&o->wide, &o->a, &o->b);
+        o->a.words[0] ^= o->wide.words[PG_BIGINT_WORDS];
+    }
+    o->sink += o->a.words[0];
+}
+
+static void bench_mod_mul(void *state, long iters) {
+    bench_operands *o = (bench_operands *)state;
+    long i;
+    for (i = 0; i < iters; i++) {
+        pg_bigint_mod_mul(&o->a, &o->a, &o->b, &o->n);
+    }
+    o->sink += o->a.words[0];
+}
+
+static void bench_mod_exp(void *state, long iters) {
+    bench_operands *o = (bench_operands *)state;
+    long i;
+    for (i = 0; i < iters; i++) {
+        pg_bigint_mod_exp(&o->a, &o->a, &o->e, &o->n);
+    }
+    o->sink += o->a.words[0];
+}
+
+static void bench_mod_exp_rns(void *state, long iters) {
+    bench_operands *o = (bench_operands *)state;
+    long i;
+    for (i = 0; i < iters; i++) {
+        pg_bigint_mod_exp_rns(&o->a, &o->a, &o->e, &o->n);
+    }
+    o->sink += o->a.words[0];
+}
+
+static void bench_mod_u32(void *state, long iters) {
+    bench_operands *o = (bench_operands *)state;
+    static const unsigned int primes[8] = { 3, 5, 7, 11, 13, 17, 19, 23 };
+    long i;
+    for (i = 0; i < iters; i++) {
+        o->sink += pg_bigint_mod_u32(&o->a, primes[i % 8]);
+        o->a.words[0] += 2;
+    }
+}
+
+static void bench_small_divisor(void *state, long iters) {
+    bench_operands *o = (bench_operands *)state;
+    long i;
+    for (i = 0; i < iters; i++) {
+        o->sink += pg_small_prime_divisor_big(&o->a);
+        o->a.words[0] += 2;
+    }
+}
+
+static void bench_witness(void *state, long iters) {
+    bench_operands *o = (bench_operands *)state;
+    long i;
+    for (i = 0; i < iters; i++) {
+        o->sink += pg_mr_witness_big(&o->n, &o->a);
+        o->a.words[0] += 1;
+    }
+}
+
+static const bench_kernel bench_kernels[] = {
+    { "pg_bigint_add", bench_add },
+    { "pg_bigint_sub", bench_sub },
+    { "pg_bigint_mul", bench_mul },
+    { "pg_bigint_mod_mul", bench_mod_mul },
+    { "pg_bigint_mod_exp", bench_mod_exp },
+    { "pg_bigint_mod_exp_rns", bench_mod_exp_rns },
+    { "pg_bigint_mod_u32", bench_mod_u32 },
+    { "pg_small_prime_divisor_big", bench_small_divisor },
+    { "pg_mr_witness_big", bench_witness },
+};
+static const int bench_kernels_count = sizeof(bench_kernels) / sizeof(bench_kernels[0]);
+
+/* Operand widths; pg_bigint holds at most 1024 bits */
+static const int bench_bits[] = { 512, 1024 };
+static const int bench_bits_count = sizeof(bench_bits) / sizeof(bench_bits[0]);
+
+static void bench_setup(pg_ctx *ctx, bench_operands *o, int bits) {
+    o->bits = bits;
+    pg_bigint_random(ctx, &o->n, bits);
+    o->n.words[0] |= 1;
+    pg_bigint_random(ctx, &o->e, bits);
+    pg_bigint_random(ctx, &o->a, bits - 1);
+    pg_bigint_random(ctx, &o->b, bits - 1);
+    o->sink = 0;
+}
+
+/* Benchmark every kernel at every width and write a JSON report */
+static void run_kernel_benchmarks(pg_ctx *ctx, unsigned long long seed, int samples, FILE *out) {
+    bench_operands o;
+    unsigned int sink = 0;
+    int k, w;
+    int first = 1;
+    
+    bench_kernels_begin(out, "bigint_kernels", seed, samples);
+    for (w = 0; w < bench_bits_count; w++) {
+        for (k = 0; k < bench_kernels_count; k++) {
+            bench_setup(ctx, &o, bench_bits[w]);
+            bench_run_kernel(out, first, bench_kernels[k].name, o.bits, bench_kernels[k].run, &o, 1, samples);
+            sink += o.sink;
+            first = 0;
+        }
+    }
+    bench_kernels_end(out, sink);
+}
+
+static void usage(const char *prog) {
+    printf("Usage: %s [--seed N] [--strong] [--test HEX] [--factor HEX [--siqs] [--ecm-b1 N] [--ecm-curves N]\n"
+           "       [--threads N]] [--bench-kernels [--bench-samples N]] [--bench-gen COUNT [--perf]]\n"
+           "       [--bench-out FILE] [--metrics-file PATH [--metrics-interval SEC]]\n", prog);
+}
+
+int main(int argc, char **argv) {
+    unsigned long long seed = 0;
+    int have_seed = 0;
+    int bench_kernels_mode = 0;
+    int bench_samples = 20;
+    int bench_gen_count = 0;
+    int use_perf = 0;
+    const char *metrics_path = NULL;
+    double metrics_interval = 15.0;
+    const char *bench_out = NULL;
+    const char *test_hex = NULL;
+    const char *factor_hex = NULL;
+    pg_ecm_params ecm = { 11000, 0, 200, 0 };
+    int use_siqs = 0;
+    int strong = 0;
+    int i;
+    
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc && parse_seed(argv[i+1], &seed)) {
+            have_seed = 1;
+            i++;
+        } else if (strcmp(argv[i], "--strong") == 0) {
+            strong = 1;
+        } else if (strcmp(argv[i], "--test") == 0 && i + 1 < argc) {
+            test_hex = argv[++i];
+        } else if (strcmp(argv[i], "--factor") == 0 && i + 1 < argc) {
+            factor_hex = argv[++i];
+        } else if (strcmp(argv[i], "--siqs") == 0) {
+            use_siqs = 1;
+        } else if (strcmp(argv[i], "--ecm-b1") == 0 && i + 1 < argc && atoi(argv[i+1]) >= 2) {
+            ecm.b1 = (uint32_t)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--ecm-curves") == 0 && i + 1 < argc && atoi(argv[i+1]) > 0) {
+            ecm.curves = (uint32_t)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc && atoi(argv[i+1]) > 0) {
+            ecm.threads = (uint32_t)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--bench-kernels") == 0) {
+            bench_kernels_mode = 1;
+        } else if (strcmp(argv[i], "--bench-samples") == 0 && i + 1 < argc) {
+            bench_samples = atoi(argv[++i]);
+            if (bench_samples < 1 || bench_samples > BENCH_MAX_SAMPLES) {
+                printf("--bench-samples must be between 1 and %d\n", BENCH_MAX_SAMPLES);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--bench-gen") == 0 && i + 1 < argc && atoi(argv[i+1]) > 0) {
+            bench_gen_count = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--perf") == 0) {
+            use_perf = 1;
+        } else if (strcmp(argv[i], "--metrics-file") == 0 && i + 1 < argc) {
+            metrics_path = argv[++i];
+        } else if (strcmp(argv[i], "--metrics-interval") == 0 && i + 1 < argc && atof(argv[i+1]) > 0) {
+            metrics_interval = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--bench-out") == 0 && i + 1 < argc) {
+            bench_out = argv[++i];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (!have_seed) seed = pg_default_seed();
+    pg_ctx *ctx = pg_ctx_create(seed, STREAM_GENERATE << 32);
+    if (ctx == NULL) {
+        printf("Out of memory\n");
+        return 1;
+    }
+    
+    if (factor_hex != NULL) {
+        int status = use_siqs ? siqs_input_hex(ctx, factor_hex, ecm.threads) : factor_input_hex(ctx, factor_hex, &ecm);
+        pg_ctx_destroy(ctx);
+        return status;
+    }
+    if (test_hex != NULL) {
+        int status = test_input_hex(ctx, test_hex);
+        pg_ctx_destroy(ctx);
+        return status;
+    }
+    if (bench_kernels_mode || bench_gen_count > 0) {
+        FILE *out = stdout;
+        if (bench_out != NULL) {
+            out = fopen(bench_out, "w");
+            if (out == NULL) {
+                printf("Failed to open %s for writing\n", bench_out);
+                pg_ctx_destroy(ctx);
+                return 1;
+            }
+        }
+        if (bench_kernels_mode) {
+            pg_ctx_set_stream(ctx, seed, STREAM_BENCH << 32);
+            run_kernel_benchmarks(ctx, seed, bench_samples, out);
+        } else {
+            metrics_exporter metrics;
+            if (metrics_path) metrics_init(&metrics, metrics_path, metrics_interval, "generate_1024bit_prime", 1024);
+            bench_generation(ctx, seed, bench_gen_count, use_perf, metrics_path ? &metrics : NULL, out);
+        }
+        if (out != stdout) fclose(out);
+        pg_ctx_destroy(ctx);
+        return 0;
+    }
+    
+    printf("=============================================\n");
+    printf("   1024-bit Prime Generator (Miller-Rabin)   \n");
+    printf("=============================================\n\n");
+    printf("Seed: 0x%llx (replay with --seed 0x%llx)\n", seed, seed);
+    
+    generate_1024bit_prime(ctx, strong);
+    pg_ctx_destroy(ctx);
+    
+    printf("\nDone.\n");
+    return 0;
 }
\ No newline at end of file